@@ -20,6 +20,44 @@ typedef enum {
 #define ADC_COUNT_MAX           1024.0
 #define ADC_COUNT_MAX_VOLTAGE   1.2
 #define ADC_PRESCALING          3.0
+#define ADC_FULL_SCALE_MV       3600                //ADC_COUNT_MAX_VOLTAGE * ADC_PRESCALING, for integer conversions
+#define ADC_QUEUE_LENGTH        4                   //Must be the power of 2.
+#define ADC_QUEUE_MASK          (ADC_QUEUE_LENGTH - 1)
+
+/**@brief Handler of a finished conversion.
+ *
+ * @note It is called from the main context through app_scheduler, never from the ADC interrupt.
+ */
+typedef void (*AdcHandler)(uint32_t uAdcValue, void *pContext);
+
+/**@brief Event which carries a result through the scheduler, SCHED_MAX_EVENT_DATA_SIZE must hold it.
+ */
+typedef struct {
+	AdcHandler handler;
+	void       *pContext;
+	uint32_t   uAdcValue;
+} AdcEvent;
+
+/**@brief Handler called when the ADC has been configured for a PPI triggered request.
+ *
+ * @note It runs with the queue locked, possibly in interrupt context. Just start the trigger source.
+ */
+typedef void (*AdcArmHandler)(void *pContext);
+
+typedef struct {
+	uint32_t      uAdcNumber;     //ADC_CONFIG_PSEL_AnalogInputX
+	uint8_t       nTriggerCount;  //0: one conversion started by the driver. N: N conversions started through PPI.
+	AdcHandler    handler;        //Called once for every conversion.
+	AdcArmHandler armHandler;     //Only used when nTriggerCount is not 0.
+	void          *pContext;
+} AdcRequest;
+
+typedef struct {
+	uint32_t uRequests;         //Requests accepted by the queue.
+	uint32_t uConversions;      //Conversions finished.
+	uint32_t uRejected;         //Requests or results dropped because a queue was full.
+	uint8_t  nMaxDepth;         //High-water mark of the request queue.
+} AdcStatistics;
 
 void InitAdc(void);
 
@@ -33,6 +71,21 @@ float GetVoltageByValue(uint32_t uAdcValue);
 
 float GetVoltage(uint32_t uAdcNumber);
 
+/**@brief Queue a conversion and return at once. The result is passed to pRequest->handler.
+ *
+ * @return NRF_SUCCESS, or NRF_ERROR_NO_MEM if ADC_QUEUE_LENGTH requests are pending.
+ */
+uint32_t QueueAdcRequest(const AdcRequest *pRequest);
+
+uint32_t StartAdc(uint32_t uAdcNumber, AdcHandler handler, void *pContext);
+
+bool IsAdcBusy(void);
+
+void GetAdcStatistics(AdcStatistics *pStatistics);
+
+/**@brief Forward the SoC events to the ADC, which waits for NRF_EVT_HFCLKSTARTED. */
+void AdcOnSysEvt(uint32_t uSysEvt);
+
 
 #ifdef __cplusplus
 }
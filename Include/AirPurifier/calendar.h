@@ -0,0 +1,47 @@
+#ifndef CALENDAR_H
+#define CALENDAR_H
+
+#include <rtc.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CALENDAR_TIMER_INTERVAL         60          //uint(s) Must be shorter than the 512s wrap of RTC1
+#define CALENDAR_RESYNC_INTERVAL        3600        //uint(s) Read the DS1302 again after this time
+#define CALENDAR_RESYNC_THRESHOLD       2           //uint(s) Smaller offsets are the 1s resolution of the DS1302
+#define CALENDAR_SECONDS_PER_DAY        86400UL
+#define CALENDAR_DAYS_PER_4_YEARS       1461
+
+typedef struct {
+	uint32_t uResyncs;
+	uint32_t uCorrections;      //Resyncs which moved the clock
+	uint32_t uRtcErrors;        //DS1302 readings out of range
+	int32_t  nLastDrift;        //uint(s) DS1302 minus our clock at the last resync
+	int32_t  nTotalDrift;       //uint(s) Sum of the corrections
+	int32_t  nDriftPpm;         //nTotalDrift over the uptime of the first sync
+} CalendarStatistics;
+
+void InitCalendar(void);                                         //After InitRtc() and the app_timer
+
+uint32_t GetCalendarUptime(void);                               //uint(s) since boot, monotonic
+
+uint32_t GetCalendarSeconds(void);                              //uint(s) since 2000-01-01 00:00:00
+
+void GetCalenderTime(CalenderTime *ct);                         //No bus traffic
+
+int SetCalenderTime(CalenderTime *ct);                          //Sets the DS1302 too, 0 or -1 if a field is out of range
+
+void ResyncCalendar(void);                                      //Read the DS1302 now
+
+void GetCalendarStatistics(CalendarStatistics *pStatistics);
+
+uint32_t CalenderTimeToSeconds(const CalenderTime *ct);
+
+void SecondsToCalenderTime(uint32_t uSeconds, CalenderTime *ct);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -10,7 +10,9 @@
 #include "led.h"
 #include "lcd.h"
 #include "rtc.h"
+#include "calendar.h"
 #include "sensor.h"
+#include "sensor_log.h"
 #include "fan.h"
 
 
@@ -29,8 +31,18 @@ typedef uint16_t							ble_length_t;
 #define CHECK_BIT(byte, bit)				(((byte)>>bit)&(1U))
 #define SET_BIT(byte, bit)					((byte)=((byte)|((1U)<<bit)))
 
+// Time spent awake and asleep by the main loop. At 32768 ticks a second a uint32_t total would wrap
+// after 36 hours, the totals are 64 bits.
+typedef struct
+{
+	uint64_t	awake_ticks;	// RTC1 ticks spent running events.
+	uint64_t	sleep_ticks;	// RTC1 ticks spent in sd_app_evt_wait().
+	uint32_t	wakeups;		// Returns from sd_app_evt_wait().
+} power_statistics_t;
+
 void InitAirPurifier(void);										//Initialing the AirPurifier.
 void SmartAdapt(SensorData sensor);						//According to the sensor data, intelligently modify the LEDs and duty-cycle of the motor.	
+void power_get_statistics(power_statistics_t* p_statistics);	//Time awake and asleep, counted by power_manage() in main.c.
 
 #ifdef __cplusplus
 } /* extern "C" */
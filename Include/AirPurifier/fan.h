@@ -13,4 +13,6 @@ void SetFanSpeed(uint8_t duty_cycle);	 		//Changing the duty-cycle of motor when
 
 uint16_t ReadFanSpeed(void);	 						//Reading the speed of fan. 
 
+uint8_t GetFanDutyCycle(void);						//The duty-cycle set last, 0 when the fan is closed
+
 #endif
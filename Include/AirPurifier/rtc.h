@@ -14,6 +14,7 @@ extern "C" {
 #define GET_RTC_TIME_8BIT_FORMAT(n)     (n % 10) + ((n / 10) << 4)
 #define CALENDER_TIME_STR_LEN           13  // 涨ʱַΪ"YYMMDDhhmmss\0"
 #define CALENDER_TIME_FORMAT_LEN        2   // "YY"
+#define RTC_CLOCK_BURST_LENGTH          8   // second, minute, hour, date, month, day, year, WP
 #define CALENDER_TIME_COUNT             6   // ʱ룬һ6
 
 typedef enum {
@@ -25,6 +26,7 @@ typedef enum {
 	RTC_READ_DAY      = 0x8B,
 	RTC_READ_YEAR     = 0x8D,
 	RTC_READ_WP       = 0x8F,  //WP(write protection): д
+	RTC_READ_CLOCK_BURST = 0xBF,  //All RTC_CLOCK_BURST_LENGTH clock registers
 	RTC_READ_CHARGE   = 0x91   //CHARGE: 
 } RTC_READ_COMMAND_TYPE;
 
@@ -37,6 +39,7 @@ typedef enum {
 	RTC_WRITE_DAY     = 0x8A,
 	RTC_WRITE_YEAR    = 0x8C,
 	RTC_WRITE_WP      = 0x8E,  //WP(write protection): д
+	RTC_WRITE_CLOCK_BURST = 0xBE,  //All RTC_CLOCK_BURST_LENGTH clock registers, WP must be 0
 	RTC_WRITE_CHARGE  = 0x90   //CHARGE: 
 } RTC_WRITE_COMMAND_TYPE;
 
@@ -89,11 +92,11 @@ void InitRtc(void);
 
 RTC_STATUS CheckRtcStatus(void);
 
-void SetCalenderTime(CalenderTime *ct);
+int SetRtcCalenderTime(CalenderTime *ct);               //0, or -1 if a field is out of range
 
-void GetCalenderTime(CalenderTime *ct);
+void GetRtcCalenderTime(CalenderTime *ct);              //Reads the DS1302, see GetCalenderTime() in calendar.h
 
-int GetCalenderTimeStr(char *pBuf, int nLen);
+int GetCalenderTimeStr(char *pBuf, int nLen);          //From the software calendar
 
 int GetSecond(void);
 
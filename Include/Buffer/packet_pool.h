@@ -0,0 +1,130 @@
+/** @file
+ *
+ * @defgroup Packet buffer pool
+ * @{
+ * @details The packet buffers of the link, shared by the RX buffer queue, the AL, the TCL and the notification queue.
+ *          A buffer holds one write or notification. It is taken with some headroom, so that a layer can prepend
+ *          its header in place, and handed down the stack with its reference. A layer which still needs the
+ *          buffer, like the TCL for a retransmission, takes another reference with packet_buf_retain().
+ *          The buffer goes back to the pool when the last reference is released.
+ *          A packet longer than a buffer, like an AL packet, is built in a chain of buffers, one notification each.
+ *
+ * @note    The pool may be used from the BLE event and from the main loop, it is protected by a critical region.
+ */
+
+#ifndef PACKET_POOL_H__
+#define PACKET_POOL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrf.h"
+#include "ble_config.h"
+
+#ifndef PACKET_POOL_SIZE
+#define PACKET_POOL_SIZE        (uint8_t)24                //The buffers of the pool, 255 at most. More than PACKET_POOL_RESERVE.
+#endif
+#ifndef PACKET_POOL_RESERVE
+#define PACKET_POOL_RESERVE     (uint8_t)10                //Left by packet_chain_alloc(), for the RX buffer queue and the ACKs.
+#endif
+#define PACKET_BUF_SIZE         BLE_UART_CHAR_BUFFER_SIZE  //One write or notification of the BLE UART Service.
+
+/**@brief Packet buffer structure.
+ *
+ * @note The data comes first, so that a packet starting at the beginning of the buffer is aligned for the headers.
+ */
+typedef struct packet_buf_s
+{
+    uint8_t           data[PACKET_BUF_SIZE];                       /**< The headroom, then the packet. */
+    struct packet_buf_s * p_next;                                  /**< The next buffer of a chain, NULL if none. */
+    uint16_t          length;                                      /**< Length of the packet. */
+    uint8_t           offset;                                      /**< Position of the packet in data, the headroom left. */
+    uint8_t           ref_count;                                   /**< References taken, 0 if the buffer is free. */
+} packet_buf_t;
+
+/**@brief Packet buffer pool statistics structure.
+ */
+typedef struct
+{
+    uint32_t          alloc_failed;                                /**< Buffers asked for while the pool was empty. */
+    uint8_t           free;                                        /**< Buffers in the pool now. */
+    uint8_t           min_free;                                    /**< Fewest buffers in the pool at once. */
+} packet_pool_statistics_t;
+
+
+/**@brief The func for initializing the packet buffer pool, all the buffers are free.
+ */
+void packet_pool_init(void);
+
+/**@brief The func for taking a buffer from the pool, with one reference.
+ *
+ * @param[in]   headroom  Bytes kept in front of the packet for the headers prepended later.
+ *
+ * @return The buffer with an empty packet, NULL if the pool is empty.
+ */
+packet_buf_t * packet_buf_alloc(uint8_t headroom);
+
+/**@brief The func for taking one more reference to a buffer.
+ */
+void packet_buf_retain(packet_buf_t * p_buf);
+
+/**@brief The func for releasing a reference, the last one gives the buffer back to the pool.
+ *
+ * @note NULL is ignored.
+ */
+void packet_buf_release(packet_buf_t * p_buf);
+
+/**@brief The func for prepending bytes to the packet, from the headroom.
+ *
+ * @return Pointer to the bytes prepended, now the beginning of the packet, NULL if the headroom is too short.
+ */
+uint8_t * packet_buf_push(packet_buf_t * p_buf, uint16_t length);
+
+/**@brief The func for appending bytes to the packet.
+ *
+ * @return Pointer to the bytes appended, NULL if the buffer is too short.
+ */
+uint8_t * packet_buf_put(packet_buf_t * p_buf, uint16_t length);
+
+/**@brief The func for taking the buffers of a long packet from the pool, chained by p_next, each with one reference.
+ *
+ * @note All the buffers or none. PACKET_POOL_RESERVE buffers stay in the pool, so that the RX buffer queue
+ *       and the ACKs are not starved by the packets waiting to be sent.
+ *
+ * @param[in]   count     Buffers of the chain, 1 at least.
+ * @param[in]   headroom  Bytes kept in front of the packet in every buffer.
+ *
+ * @return The first buffer of the chain, NULL if the pool is short.
+ */
+packet_buf_t * packet_chain_alloc(uint8_t count, uint8_t headroom);
+
+/**@brief The func for releasing a reference to every buffer of a chain.
+ *
+ * @note NULL is ignored.
+ */
+void packet_chain_release(packet_buf_t * p_buf);
+
+/**@brief The func for appending bytes to a chained packet, on to the next buffer when one is full.
+ *
+ * @param[in/out] pp_buf  The buffer being filled, the one filled by the last byte on return.
+ * @param[in]     p_data  The bytes.
+ * @param[in]     length  The number of bytes.
+ *
+ * @return The number of bytes appended, less than length if the chain is full.
+ */
+uint16_t packet_chain_put(packet_buf_t ** pp_buf, const uint8_t * p_data, uint16_t length);
+
+/**@brief The func for getting the statistics of the packet buffer pool.
+ */
+void get_packet_pool_statistics(packet_pool_statistics_t * p_statistics);
+
+/**@brief The func for getting the beginning of the packet.
+ */
+static __INLINE uint8_t * packet_buf_data(packet_buf_t * p_buf)
+{
+    return &p_buf->data[p_buf->offset];
+}
+
+
+#endif // PACKET_POOL_H__
+
+/** @} */
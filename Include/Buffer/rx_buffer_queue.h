@@ -4,7 +4,8 @@
  * @{
  * @details The RX buffer queue handler receives the packet of "Write" from Android  
  *          add_rx_buffer_to_queue() when the Android send a packet to the board.
- *					rx_buffer_queue_evt_schedule()was used in the main() forever loop!!
+ *					add_rx_buffer_to_queue() puts rx_buffer_queue_evt_schedule() to the scheduler, one event at a time.
+ *          The packets are kept in buffers of the packet pool, the TCL parses them in place.
  */
 
 #ifndef RX_BUFFER_QUEUE_H__
@@ -15,45 +16,65 @@
 #include "nrf.h"
 #include "app_error.h"
 #include "ble_config.h"
+#include "packet_pool.h"
 
-#define RX_BUFFER_QUEUE_LENGTH  (uint8_t)8                 //Must be the power of 2.   
-#define ROTATION_MASK        (RX_BUFFER_QUEUE_LENGTH)-1			//As the mask of index to build A rotation queue.
+#ifndef RX_BUFFER_QUEUE_LENGTH
+#define RX_BUFFER_QUEUE_LENGTH  (uint8_t)8                 //Must be the power of 2, 128 at most.   
+#endif
+#define ROTATION_MASK        ((RX_BUFFER_QUEUE_LENGTH)-1)			//As the mask of index to build A rotation queue.
+#define RX_BUFFER_QUEUE_BATCH   RX_BUFFER_QUEUE_LENGTH     //Packets passed to the TCL at most in one rx_buffer_queue_evt_schedule().
 
-/**@brief RX buffer element instance structure. 
- */
-typedef struct 
-{
-    uint8_t  rx_buffer[BLE_UART_CHAR_BUFFER_SIZE];                   /**< RX buffer element memory array. */
-		uint16_t length;																								 /**< RX buffer length of array. */
-} rx_buffer_elem_t;
+typedef char rx_buffer_queue_length_check_t[((RX_BUFFER_QUEUE_LENGTH & ROTATION_MASK) == 0 && RX_BUFFER_QUEUE_LENGTH <= 128) ? 1 : -1];
 
 /**@brief RX buffer queue element instance structure. 
+ *
+ * @note The indexes run free and are masked on access, so all the elements are used. Only the BLE event writes
+ *       write_index and only the main loop writes read_index.
  */
 typedef struct 
 {
-    rx_buffer_elem_t * p_buffer;                                    /**< Pointer to RX buffer element. */
-    uint8_t           write_index;                                 /**< Write position index. */                                     
-    uint8_t           read_index;                                  /**< Read position index. */                                                                                                                                                                                         
+    packet_buf_t *    p_buffer[RX_BUFFER_QUEUE_LENGTH];            /**< The packets, in buffers of the packet pool. */
+    volatile uint8_t  write_index;                                 /**< Write position index. */                                     
+    volatile uint8_t  read_index;                                  /**< Read position index. */                                                                                                                                                                                         
 } rx_buffer_queue_t;
 
+/**@brief RX buffer queue statistics structure. 
+ */
+typedef struct
+{
+    uint32_t          received;                                    /**< Packets added to the queue. */
+    uint32_t          dropped;                                     /**< Packets lost, the queue or the pool was full or the packet too long. */
+    uint8_t           depth;                                       /**< Packets in the queue now. */
+    uint8_t           high_water;                                  /**< Most packets in the queue at once. */
+} rx_buffer_queue_statistics_t;
+
 
 /**@brief The func for initializing RX buffer queue and add the Rx buffer queue Event to the Schedule. 
  */
-void init_rx_buffer_queue_evt(rx_buffer_elem_t * p_buffer);
+void init_rx_buffer_queue_evt(void);
+
+/**@brief The schedule func of checking RX buffer queue, passes the packets queued to the TCL. 
+ */
+void rx_buffer_queue_evt_schedule(void * p_event_data, uint16_t event_size);
 
-/**@brief The schedule func of checking RX buffer queue. 
+/**@brief The func for passing again the packets the TCL returned TCL_WAIT for, call it after tcl_recv_resume() returns true. 
  */
-//void rx_buffer_queue_evt_schedule(void * p_event_data, uint16_t event_size);
-void rx_buffer_queue_evt_schedule(void);
+void rx_buffer_queue_resume(void);
 
 /**@brief The func for adding One RX buffer to the buffer queue. 
+ *
+ * @return NRF_SUCCESS, NRF_ERROR_NO_MEM if the queue or the pool is full or NRF_ERROR_INVALID_LENGTH if the packet is too long.
  */
-void add_rx_buffer_to_queue(uint8_t* p_data,uint16_t length);
+uint32_t add_rx_buffer_to_queue(uint8_t* p_data,uint16_t length);
 
-/**@brief The func for flushing the RX buffer queue. 
+/**@brief The func for flushing the RX buffer queue and releasing the buffers, from the main loop only. 
  */
 void flush_rx_buffer_queue(void);
 
+/**@brief The func for getting the statistics of the RX buffer queue. 
+ */
+void get_rx_buffer_queue_statistics(rx_buffer_queue_statistics_t * p_statistics);
+
 
 #endif // RX_BUFFER_QUEUE_H__
 
@@ -16,23 +16,36 @@
 #include <stdint.h>
 #include <ble_config.h>
 #include <car_air_purifier.h>
-
-#define PACKET_HEADER_VERSION							(uint8_t)10 				// The value of 10 means 1.0
-#define PACKET_HEADER_MAGIC_NUMBER				(uint8_t)0xAA
-#define PACKET_HEADER_LENGTH							(uint32_t)8 				// Length of Packet header
+#include <transport.h>
 
 // Definitions of the AL
-#define AL_MTU										(uint16_t)12 // Note that the MTU of AL is maximum size of TCL payload.
-#define AL_HEADER_LENGTH					(uint32_t)2 // Length of AL header
+#define AL_MTU										(uint16_t)TCL_PAYLOAD_MTU // Note that the MTU of AL is maximum size of TCL payload.
+#define AL_HEADER_LENGTH					(uint32_t)4 // Length of AL header
 #define AL_PAYLOAD_MTU						(uint32_t)(AL_MTU-AL_HEADER_LENGTH) // Maximum size of AL payload
 #define AL_KEY_HEADER_LENGTH				(uint32_t)2 // Note that the key header is total size of 'key_id' and 'key_length'.
-#define AL_RESEND_MAX_COUNT					(uint8_t)3
+#define AL_RESEND_MAX_COUNT					(uint8_t)3 // A packet the TCL failed to send is sent again this many times.
+
+// Transmit queue of AL, one per priority class. The packets are built when queued, in chains of buffers of the
+// packet pool with one sub-packet of the TCL in each, and the TCL frames them in place.
+#define AL_TX_QUEUE_LENGTH					(uint8_t)4 // Packets waiting in each priority class, must be a power of 2.
+#define AL_TX_QUEUE_MASK					(AL_TX_QUEUE_LENGTH - 1)
+#define AL_TX_POOL_PAYLOAD_MTU				(uint32_t)((PACKET_POOL_SIZE - PACKET_POOL_RESERVE) * BLE_UART_PAYLOAD_MTU - AL_HEADER_LENGTH)
+#define AL_TX_PAYLOAD_MTU					(uint16_t)((AL_TX_POOL_PAYLOAD_MTU < AL_PAYLOAD_MTU) ? AL_TX_POOL_PAYLOAD_MTU : AL_PAYLOAD_MTU)
+													// Largest payload the pool can hold, 164 bytes by default. AL_KEY_RT_DATA_ALL takes 39.
+
+// Correlation of requests and replies. The phone numbers its requests in the header, every reply echoes the
+// number, so it may send the next requests without waiting. A packet not asked for, like a push, carries 0.
+#define AL_CORRELATION_ID_NONE				(uint8_t)0 // Not a reply, or the request was not numbered.
+// Every key-value of a request is answered by one packet, a failed execute status if it was rejected. The
+// replies of all the outstanding requests may be queued at once, in either class, and the low class keeps a
+// slot for the one real-time push. So the limit counts key-values, not requests.
+#define AL_REQUESTS_OUTSTANDING_MAX			(AL_TX_QUEUE_LENGTH - 1) // Key-values a phone may have waiting for their replies.
 
 /* @note The status codes are kept same with the TCL, so the status can transfer without translating which 
 		may be a good way to reduce implement codes.
 */
 #define AL_SUCCESS							(uint32_t)0 // Success.
-#define AL_WAIT								(uint32_t)1 // The previous packet is sending. Just wait and send again.
+#define AL_WAIT								(uint32_t)1 // The transmit queue is full. Just wait and send again.
 #define AL_AGAIN							(uint32_t)2 // The BLE is busy or has no enough available buffer, should send again.
 #define AL_ERROR							(uint32_t)3 // Common failed.
 #define AL_ERROR_MEM						(uint32_t)4 // Memory error.
@@ -62,6 +75,7 @@
 // Status of executing of command.
 #define AL_KEY_EXE_STAT_FAILED			(uint8_t)0 // [Phone <- Purifier]: Failed to execute command.
 #define AL_KEY_EXE_STAT_SUCCUSS			(uint8_t)1 // [Phone <- Purifier]: Successfully to execute command.
+#define AL_EXE_STAT_KEY_NONE			(uint8_t)0xFF // The key in the comment of a failed packet, not of one key-value.
 
 // Firmware Update.
 #define AL_KEY_DFU_REQUEST				(uint8_t)0 // [Phone -> Purifier]: Request to execute OTA DFU
@@ -82,13 +96,32 @@
 #define AL_KEY_RT_DATA_TVOC				(uint8_t)1 // [Phone <- Purifier]: Real-time value of TVOC.
 #define AL_KEY_RT_DATA_TEMP				(uint8_t)2 // [Phone <- Purifier]: Real-time value of Temperature.
 #define AL_KEY_RT_DATA_HUMI				(uint8_t)3 // [Phone <- Purifier]: Real-time value of Humidity.
+#define AL_KEY_RT_DATA_FAN				(uint8_t)4 // [Phone <- Purifier]: Duty-cycle of the fan(u8), 0 when closed.
+#define AL_KEY_RT_DATA_PURIFY			(uint8_t)5 // [Phone <- Purifier]: Purify status(u8), AL_KEY_CONTROL_PURIFY_CLOSE or _OPEN.
+#define AL_KEY_RT_DATA_BATT				(uint8_t)6 // [Phone <- Purifier]: Battery capacity(u8, %).
+#define AL_KEY_RT_DATA_ALL				(uint8_t)7 // [Phone <-> Purifier]: Request all above, answered by one packet with the keys 0 to 6 and AL_KEY_RT_DATA_TIME.
+#define AL_KEY_RT_DATA_SUBSCRIBE		(uint8_t)8 // [Phone -> Purifier]: Push AL_KEY_RT_DATA_ALL on change, value: heartbeat(u16, s), optional.
+#define AL_KEY_RT_DATA_UNSUBSCRIBE		(uint8_t)9 // [Phone -> Purifier]: Stop pushing. Also done on disconnection.
+#define AL_KEY_RT_DATA_TIME				(uint8_t)10 // [Phone <- Purifier]: Sample time of the values(u32, s since 2000-01-01), only in AL_KEY_RT_DATA_ALL.
+
+// Subscription of real-time data.
+// {
+#define AL_RT_PUSH_HEARTBEAT			(uint16_t)60 // uint(s) Push at least this often, even if nothing changed.
+#define AL_RT_PUSH_HEARTBEAT_MIN		(uint16_t)5 // uint(s) Shortest heartbeat accepted.
+#define AL_RT_DEADBAND_PM25				5.0f // uint(ug/m3) Push when PM2.5 moved more than this.
+#define AL_RT_DEADBAND_TVOC				0.05f // uint(mg/m3)
+#define AL_RT_DEADBAND_TEMP				0.5f // uint(degree)
+#define AL_RT_DEADBAND_HUMI				2.0f // uint(%RH)
+// }
 
  // Get off-line data.
 #define AL_KEY_OL_DATA_TIME				(uint8_t)0 // [Phone <- Purifier]: Time stamp of recording.
-#define AL_KEY_OL_DATA_PM25				(uint8_t)0 // [Phone <- Purifier]: Off-line value of PM2.5.
-#define AL_KEY_OL_DATA_TVOC				(uint8_t)1 // [Phone <- Purifier]: Off-line value of TVOC.
-#define AL_KEY_OL_DATA_TEMP				(uint8_t)2 // [Phone <- Purifier]: Off-line value of Temperature.
-#define AL_KEY_OL_DATA_HUMI				(uint8_t)3 // [Phone <- Purifier]: Off-line value of Humidity.
+#define AL_KEY_OL_DATA_PM25				(uint8_t)1 // [Phone <- Purifier]: Off-line value of PM2.5.
+#define AL_KEY_OL_DATA_TVOC				(uint8_t)2 // [Phone <- Purifier]: Off-line value of TVOC.
+#define AL_KEY_OL_DATA_TEMP				(uint8_t)3 // [Phone <- Purifier]: Off-line value of Temperature.
+#define AL_KEY_OL_DATA_HUMI				(uint8_t)4 // [Phone <- Purifier]: Off-line value of Humidity.
+#define AL_KEY_OL_DATA_COUNT			(uint8_t)5 // [Phone <-> Purifier]: Number of records(u16) and sequence of the oldest(u32).
+#define AL_KEY_OL_DATA_RECORD			(uint8_t)6 // [Phone <-> Purifier]: Request: index(u16). Reply: one packet of TIME{index,time(u32)} and RECORD{index,pm25(0.1ug),tvoc(ug),temp(i8),humi(u8)}.
 
 // Get status of purifier.
 #define AL_KEY_STATUS_BATT_CAP			(uint8_t)0 // [Phone <-> Purifier]: Battery capacity.
@@ -107,15 +140,6 @@
 
 // }
 
-/**@brief Function for sending packet to the BLE Profile Layer.
- *
- * @param[in]   p_data  		Pointer to the data buffer.
- * @param[in]   length  		Length of the data.
- *
- * @return err_code return from BLE Profile Layer for sending data.
- */
-typedef uint32_t (*ble_send_handler_t) (uint8_t* p_data, uint16_t length);
-
 /**@brief Function for processing Test packet.
  *
  * @param[in]   p_data  		Pointer to the data received.
@@ -150,35 +174,27 @@ uint32_t al_process_dfu_packet(uint8_t* p_data, uint16_t length)
  
 typedef struct al_init_s
 {
-	ble_send_handler_t   ble_send_hander;    //Function for sending packet to Android
+	tcl_send_handler_t   tcl_send_handler;    //Function for sending packet to Android through the TCL
 	al_process_handler_t dfu_handler; // Function for processing DFU packet.
 	al_process_handler_t settting_handler; // Function for processing Setting packet.
 	al_process_handler_t control_handler; // Function for processing Control packet.
 	al_process_handler_t real_time_monitor_handler; // Function for sending the real-time monitor data.
+	al_process_handler_t ol_data_handler; // Function for reading the off-line data.
 	al_process_handler_t status_handler; // Function for processing Status packet.
 	al_process_handler_t test_handler; // Function for processing Test packet.
 	al_process_handler_t log_handler; // Function for processing Log packet.	
 } al_init_t;
 
-typedef struct packet_header_s
-{
-	uint8_t		magic_number;
-	uint8_t		version; // The version of this "BLE Communication Protocol of Car Air Purifier". For example 15 means 1.5
-	uint16_t	payload_length; // The length(number of bytes) of the TCL Payload.
-	uint8_t		sequence_id; // The sequence ID of this packet.
-	uint8_t		flag;
-	uint16_t	check_sum;
-} packet_header_t;
-
 typedef struct al_header_s
 {
 	uint8_t		command_id; // Command ID.
-	uint8_t		payload_length; // Length of Payload;
+	uint8_t		correlation_id; // Number of the request, echoed in its replies. Was reserved as 0.
+	uint16_t	payload_length; // Length of Payload, the key-values back to back.
 } al_header_t;
 
+// The AL packet is the payload of a TCL packet, which frames, checks and splits it.
 typedef struct al_packet_s
 {
-	packet_header_t packet_header;
 	al_header_t			al_header;
 	uint8_t					payload[AL_PAYLOAD_MTU];
 } al_packet_t;
@@ -199,6 +215,22 @@ typedef enum
 		AL_SEND_STATUS_FAILED	// Failed to send.
 } al_send_status_t;
 
+// Priority classes of the transmit queue. A packet on the way is not preempted, the next one is taken from
+// the highest class which has one.
+typedef enum
+{
+	AL_PRIORITY_HIGH,		// Replies to control and status requests, the execute status.
+	AL_PRIORITY_LOW,		// Bulk and streaming data, the real-time and off-line data.
+	AL_PRIORITY_COUNT
+} al_priority_t;
+
+/**@brief Function for noticing the sender when a queued packet is done.
+ *
+ * @param[in]   p_context  		Context given with the packet.
+ * @param[in]   status  		AL_SEND_STATUS_SUCCESS, or AL_SEND_STATUS_FAILED after the resends or on disconnection.
+ */
+typedef void (*al_send_complete_handler_t)(void* p_context, al_send_status_t status);
+
 // Note that if time out, the executing status should be set as AL_EXECUTE_STATUS_FAILED.
 typedef enum
 {
@@ -226,26 +258,73 @@ al_send_status_t al_send_status(void);
  */
 al_execute_status_t al_execute_status(void);
 
-/**@brief Function for sending packet through the Application Layer.
+/**@brief Function for queuing packet to send through the Application Layer.
+ *
+ * @note The AL will copy the data pointing by pointer of every key-value in the array.
+ * @note Queued while a request is processed, the packet is a reply and echoes the correlation id of the request.
+ * @note The handler is called once the TCL sent the packet, or failed it AL_RESEND_MAX_COUNT more times.
+ * @note The packet takes a buffer of the packet pool for each BLE_UART_PAYLOAD_MTU bytes, till it is done.
+ *
+ * @param[in]   command_id  		Command ID.
+ * @param[in]   p_kv  				Pointer to the array of key-value.
+ * @param[in]   kv_number  			Array number, the key-values are packed back to back.
+ * @param[in]   priority  			Priority class of the packet.
+ * @param[in]   complete_handler	Function called when the packet is done, may be NULL.
+ * @param[in]   p_context  			Passed to the handler.
+ *
+ * @return @ref AL_SUCCESS				Successfully queued the packet.
+ * @return @ref AL_WAIT					The queue of the priority class, or the packet pool, is full. Just wait and send again.
+ * @return @ref AL_ERROR_DATA_SIZE		Exceed AL_TX_PAYLOAD_MTU.
+ */
+uint32_t al_queue_packet(uint8_t command_id, al_data_t* p_kv, uint8_t kv_number, al_priority_t priority,
+						 al_send_complete_handler_t complete_handler, void* p_context);
+
+/**@brief Function for sending packet through the Application Layer, with low priority and no handler.
  *
  * @note The AL will copy the data pointing by pointer of every key-value in the array.
  *
  * @param[in]   command_id  	Command ID.
  * @param[in]   p_kv  			Pointer to the array of key-value.
+ * @param[in]   kv_number  		Array number, the key-values are packed back to back.
  *
- * @return @ref AL_SUCCESS		Successfully sent the packet.
- * @return @ref AL_ERROR		Common failed.
+ * @return @ref AL_SUCCESS				Successfully queued the packet.
+ * @return @ref AL_WAIT					The queue is full. Just wait and send again.
+ * @return @ref AL_ERROR_DATA_SIZE		Exceed the limit of data size.
  */
-uint32_t al_send_packet(uint8_t command_id, al_data_t* p_kv);
+uint32_t al_send_packet(uint8_t command_id, al_data_t* p_kv, uint8_t kv_number);
+
+/**@brief Function for failing the queued packets, when the link is gone.
+ *
+ * @note Call it before tcl_reset(), which fails the packet on the way. No packet is sent again.
+ */
+void al_reset(void);
+
+/**@brief Function for sending again a packet the TCL refused on the spot.
+ *
+ * @note Call it on every TCL tick. A packet the TCL fails before returning, the notification queue being
+ *		 full, is not sent again till then, which gives the queue time to drain.
+ */
+void al_tx_resume(void);
+
+/**@brief Function for checking whether a packet waits for al_tx_resume().
+ *
+ * @return true if the TCL refused the head packet and it waits for the next TCL tick.
+ */
+bool al_tx_is_deferred(void);
 
 /**@brief Function for sending packet through the Application Layer.
  *
  * @note The Application layer should keep the data buffer until sending finishes.
+ * @note A rejected packet or key-value is answered with a failed execute status of
+ *       {command, key, reason}, the reason being the AL status code.
+ * @note A key-value is executed only when its reply can be queued. After AL_WAIT the same packet must be
+ *       passed again, before any other, and goes on from the key-value which waited.
  *
  * @param[in]   p_data  		Pointer to the data received.
  * @param[in]   length  		Length of the data.
  *
  * @return @ref AL_SUCCESS		Successfully sent the packet.
+ * @return @ref AL_WAIT			The transmit queue is full, pass the packet again later.
  * @return @ref AL_ERROR		Common failed.
  */
 uint32_t al_recv_packet(uint8_t* p_data, uint16_t length);
@@ -266,6 +345,16 @@ void al_send_success(void);
  */
 void pass_to_al_sensor_data(SensorData sensor);
 
+/*@brief Function for stopping the push of real-time data, when the phone is gone.
+ */
+void al_rt_data_unsubscribe(void);
+
+/*@brief Function for getting the battery capacity reported to the phone.
+ *
+ * @return The battery capacity, uint(%).
+ */
+uint8_t al_get_battery_capacity(void);
+
 /*@brief Function for processing Control packet.
  *<Add by Mida>
  * @param[in]   p_data  		Pointer to the data received.
@@ -282,9 +371,10 @@ uint32_t al_process_control_packet(uint8_t* p_data, uint16_t length);
  * @param[in]   p_data  		Pointer to the data received.
  * @param[in]   length  		Length of the data.
  *
- * @return @ref AL_SUCCESS		Successfully sent the packet.
- * @return @ref AL_ERROR		Common failed.
- * @return @ref AL_ERROR_KEY	The Key id is wrong.
+ * @return @ref AL_SUCCESS				Successfully sent the packet.
+ * @return @ref AL_ERROR				Common failed, the RTC refused the time.
+ * @return @ref AL_ERROR_DATA_SIZE		The value is shorter than the setting.
+ * @return @ref AL_ERROR_KEY			The Key id is wrong.
  */
 uint32_t al_process_setting_packet(uint8_t* p_data, uint16_t length);
 
@@ -299,6 +389,17 @@ uint32_t al_process_setting_packet(uint8_t* p_data, uint16_t length);
  */
 uint32_t al_process_rt_monitor_packet(uint8_t* p_data, uint16_t length);
 
+/*@brief Function for reading the off-line data recorded in flash.
+ *
+ * @param[in]   p_data  		Pointer to the data received.
+ * @param[in]   length  		Length of the data.
+ *
+ * @return @ref AL_SUCCESS		Successfully sent the packet.
+ * @return @ref AL_ERROR		Common failed.
+ * @return @ref AL_ERROR_KEY	The Key id is wrong.
+ */
+uint32_t al_process_ol_data_packet(uint8_t* p_data, uint16_t length);
+
 /*@brief Function for notify the hardware status to the Android.
  *<Add by @Mida 2015-7-24>
  * @param[in]   p_data  		Pointer to the data received.
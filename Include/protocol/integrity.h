@@ -0,0 +1,55 @@
+/* Copyright (c) 2014 Before Technology. All Rights Reserved.
+ */
+
+/** @file
+ *
+ * @details This module implements the CRC-16 shared by the TCL and the sensor log. It is CRC-16/CCITT-FALSE
+ *			(polynomial 0x1021, initial value 0xFFFF), the same as crc16_compute() of the SDK.
+ *
+ * @note	crc16_compute() is used by default. With INTEGRITY_CRC16_NIBBLE_TABLE a table of 16 entries
+ *			(32 bytes of flash) does 4 bits per step instead. On the host, test/test_integrity measured the
+ *			table slower than the shifts, 15.6 against 8.5 cycles per byte. It has not been measured on the
+ *			nRF51, time both with a TIMER there before choosing the table.
+ *
+ */
+#ifndef INTEGRITY_H__
+#define INTEGRITY_H__
+
+#include <stdint.h>
+
+#ifndef INTEGRITY_CRC16_NIBBLE_TABLE
+#define INTEGRITY_CRC16_NIBBLE_TABLE		0
+#endif
+#define INTEGRITY_CRC16_INIT				(uint16_t)0xFFFF // Value to start a CRC with.
+
+/**@brief Function for continuing a CRC over more data.
+ *
+ * @param[in]   crc				CRC of the data before, INTEGRITY_CRC16_INIT to start.
+ * @param[in]   p_data			Pointer to the data.
+ * @param[in]   length			Length of the data.
+ *
+ * @return The CRC including the data.
+ */
+uint16_t integrity_crc16_update(uint16_t crc, const uint8_t* p_data, uint16_t length);
+
+/**@brief Function for copying data and continuing a CRC over it in the same pass.
+ *
+ * @param[in]   crc				CRC of the data before, INTEGRITY_CRC16_INIT to start.
+ * @param[out]  p_dest			Pointer to the destination.
+ * @param[in]   p_src			Pointer to the data.
+ * @param[in]   length			Length of the data.
+ *
+ * @return The CRC including the data.
+ */
+uint16_t integrity_crc16_copy(uint16_t crc, uint8_t* p_dest, const uint8_t* p_src, uint16_t length);
+
+/**@brief Function for calculating the CRC of a buffer.
+ *
+ * @param[in]   p_data			Pointer to the data.
+ * @param[in]   length			Length of the data.
+ *
+ * @return The CRC of the data.
+ */
+uint16_t integrity_crc16_compute(const uint8_t* p_data, uint16_t length);
+
+#endif
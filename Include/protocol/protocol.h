@@ -19,9 +19,23 @@
 // Header of BLE Service which is based on the specific BLE Stack.
 #include <ble_uart.h>
 // Header of Communication Protocol
+#include <transport.h>
 #include <application.h>
 
 
+#define PROTOCOL_TX_QUEUE_LENGTH			16 // Notifications waiting for a TX buffer of the SoftDevice, must be a power of 2.
+#define PROTOCOL_TX_QUEUE_MASK				(PROTOCOL_TX_QUEUE_LENGTH - 1)
+
+typedef struct protocol_tx_statistics_s
+{
+	uint32_t	queued; // Notifications accepted by the queue.
+	uint32_t	sent; // Notifications taken by the SoftDevice.
+	uint32_t	dropped; // Notifications lost, the queue was full or the link went down.
+	uint32_t	tx_complete; // Notifications acknowledged by TX_COMPLETE.
+	uint8_t		depth; // Notifications in the queue now.
+	uint8_t		max_depth;
+} protocol_tx_statistics_t;
+
 typedef struct protocol_init_s
 {
 	ble_uart_t*		p_uart; 		// p_uart holds the pointer to the BLE UART Service.
@@ -33,6 +47,36 @@ typedef struct protocol_init_s
  */
 void purifier_protocol_init(protocol_init_t* protocol_init);
 
+/**@brief Function for handling the BLE events of the Protocol module.
+ *
+ * @note The notification queue is refilled on BLE_EVT_TX_COMPLETE and flushed on disconnection.
+ *
+ * @param[in]   p_ble_evt	Event received from the BLE stack.
+ */
+void protocol_on_ble_evt(ble_evt_t* p_ble_evt);
+
+/**@brief Function for getting the statistics of the notification queue.
+ *
+ * @param[out]  p_statistics	Pointer to the statistics.
+ */
+void protocol_get_tx_statistics(protocol_tx_statistics_t* p_statistics);
+
+/**@brief Function for checking whether the Protocol has data on the way.
+ *
+ * @note Used by the connection parameters policy to choose the bulk profile.
+ *
+ * @return true if notifications are queued, or the TCL is sending or receiving a packet.
+ */
+bool protocol_is_busy(void);
+
+/**@brief Function for starting or stopping the TCL timer before the main loop sleeps.
+ *
+ * @note Call it from the main loop, after the scheduler ran. The timer runs only while a packet
+ *		 is sent or received, or waits in the AL for the TCL.
+ * @note It also runs the reset of a disconnection which did not fit the scheduler queue.
+ */
+void protocol_prepare_sleep(void);
+
 #endif
 
 
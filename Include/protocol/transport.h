@@ -16,8 +16,9 @@
 #include <stdint.h>
 #include <ble_config.h>
 #include <ble_uart.h>
+#include <packet_pool.h>
 
-#define TCL_PROTOCOL_VERSION				(uint8_t)10 // The value of 10 means 1.0
+#define TCL_PROTOCOL_VERSION				(uint8_t)11 // The value of 11 means 1.1, the check_sum is a CRC-16 since 1.1.
 
 // Definitions of the TCL
 #define BLE_UART_MTU						(uint32_t)BLE_UART_CHAR_BUFFER_SIZE
@@ -26,15 +27,35 @@
 #define TCL_PAYLOAD_MTU						(uint32_t)504
 
 #define TCL_HEADER_LENGTH					(uint32_t)8
+#define TCL_HEADER_CRC_LENGTH				(uint32_t)6 // The CRC covers the header up to check_sum, then the payload.
 #define TCL_HEADER_MAGIC_NUMBER				(uint8_t)0xAA
 
 #define TCL_HEADER_FLAG_ACK_BIT_POS			(uint8_t)0 //  the bit position of 'acknowledgement' on the Flag of TCL Header.
 #define TCL_HEADER_FLAG_ERR_BIT_POS			(uint8_t)1 //  the bit position of 'error' on the Flag of TCL Header.
 #define TCL_HEADER_FLAG_RESERVED_BIT_POS	(uint8_t)2 //  the bit position of 'error' on the Flag of TCL Header.
+#define TCL_HEADER_FLAG_SACK_BIT_POS		(uint8_t)6 //  the bit position of 'selective acknowledgement', set by a peer which speaks the windowed mode.
+#define TCL_HEADER_FLAG_TOGGLE_BIT_POS		(uint8_t)7 //  the bit position of 'toggle', alternates between the packets of a windowed peer.
 
-#define TCL_SEND_TIMER_INTERVAL				(uint32_t)500 // The unit is ms.
-#define TCL_RESEND_MAX_TIMES				(uint8_t)3
-#define TCL_RECV_WAIT_MAX_TIMES				(uint8_t)3
+// Windowed mode. The ACK of a windowed peer carries its window and a bitmap of the received sub-packets,
+// the sequence id of the ACK is the last sub-packet received in order. A peer without the SACK flag gets window 1.
+#define TCL_WINDOW_SIZE						(uint8_t)8 // Sub-packets which may be in flight, advertised in every SACK. A power of 2.
+#define TCL_SUB_PACKET_MAX					TCL_CALC_SUB_PACKET_NUMBER(TCL_PAYLOAD_MTU)
+#define TCL_SACK_BITMAP_LENGTH				((TCL_SUB_PACKET_MAX+7)/8)
+#define TCL_SACK_WINDOW_POS					0 // Position of the window in the payload of ACK.
+#define TCL_SACK_BITMAP_POS					1 // Position of the bitmap in the payload of ACK, bit i of byte j is sub-packet 8*j+i.
+#define TCL_SACK_NONE						(uint8_t)0xFF // Sequence id of an ACK when the first sub-packet is missing.
+
+#define TCL_SEND_TIMER_INTERVAL				(uint32_t)100 // The unit is ms. Granularity of the time-outs.
+#define TCL_RESEND_MAX_TIMES				(uint8_t)3 // Time-outs in a row without progress before giving up.
+
+// Retransmission time-out as RFC 6298, from the round-trip time of the ACKs. Only sub-packets sent once are timed,
+// the RTO doubles on each time-out until the next sample.
+#define TCL_RTO_INITIAL						(uint32_t)1000 // The unit is ms. Until the first sample.
+#define TCL_RTO_MIN							(uint32_t)200 // The unit is ms. Lower than the 1s of RFC 6298, a BLE link has no delayed ACK.
+#define TCL_RTO_MAX							(uint32_t)3000 // The unit is ms.
+// The unit is ms. Wait for the next sub-packet at most. Longer than the sender may retry, as the sub-packets dropped 
+// here may be acknowledged already.
+#define TCL_RECV_WAIT_TIME					((TCL_RESEND_MAX_TIMES + 1) * TCL_RTO_MAX)
 
 #define TCL_SUCCESS							(uint32_t)0 // Success.
 #define TCL_WAIT							(uint32_t)1 // Notice the upper layer to wait and send again.
@@ -56,9 +77,13 @@
 #define TCL_UNSET_FLAG(flag)				((flag)=0)
 #define TCL_CHECK_ACK_FLAG(flag)			(CHECK_BIT((flag),TCL_HEADER_FLAG_ACK_BIT_POS))
 #define TCL_CHECK_ERR_FLAG(flag)			(CHECK_BIT((flag),TCL_HEADER_FLAG_ERR_BIT_POS))
+#define TCL_SET_SACK_FLAG(flag)				(SET_BIT((flag),TCL_HEADER_FLAG_SACK_BIT_POS))
+#define TCL_CHECK_SACK_FLAG(flag)			(CHECK_BIT((flag),TCL_HEADER_FLAG_SACK_BIT_POS))
+#define TCL_CHECK_TOGGLE_FLAG(flag)			(CHECK_BIT((flag),TCL_HEADER_FLAG_TOGGLE_BIT_POS))
+#define TCL_BITMAP_SET(map,id)				((map)[(id)>>3] |= (uint8_t)(1U<<((id)&7)))
+#define TCL_BITMAP_CHECK(map,id)			(((map)[(id)>>3]>>((id)&7))&(1U))
 
 #define TCL_CALC_SUB_PACKET_NUMBER(length)	(((uint32_t)(length)+(BLE_UART_PAYLOAD_MTU-1))/BLE_UART_PAYLOAD_MTU)
-#define TCL_GET_ADDR_BY_SEQ_ID(base,id)		(uint8_t*)((uint8_t*)(base)+((uint32_t)(id)*BLE_UART_PAYLOAD_MTU))
 
 /**@brief Function for handling the received packet from AL.
  *
@@ -70,14 +95,30 @@
 
 typedef uint32_t (*al_recv_handler_t) (uint8_t* p_data, uint16_t length);
 
-/**@brief Function for sending packet to the BLE Profile Layer.
+/**@brief Function for sending packet through the Transport Control Layer.
  *
- * @param[in]   p_data  		Pointer to the data buffer.
- * @param[in]   length  		Length of the data.
+ * @param[in]   p_packet  		The packet, in a chain of buffers of the packet pool, see tcl_send_packet().
+ * @param[in]   length  		Length of the packet.
+ *
+ * @return err_code return from the Transport Control Layer for sending the packet.
+ */
+typedef uint32_t (*tcl_send_handler_t) (packet_buf_t* p_packet, uint16_t length);
+
+/**@brief Function for sending a sub-packet to the BLE Profile Layer.
+ *
+ * @note The reference to the buffer is passed with it, and released by the BLE Profile Layer even on failure.
+ *
+ * @param[in]   p_buf  			Buffer of the packet pool holding the sub-packet.
  *
  * @return err_code return from BLE Profile Layer for sending data.
  */
-typedef uint32_t (*ble_send_handler_t) (uint8_t* p_data, uint16_t length);
+typedef uint32_t (*ble_send_buf_handler_t) (packet_buf_t* p_buf);
+
+/**@brief Function for getting the time for the round-trip measurement.
+ *
+ * @return Time in ms, free running.
+ */
+typedef uint32_t (*tcl_time_handler_t)(void);
 
 /**@brief Function for noticing AL when failed to sending the packet from it.
  *
@@ -91,10 +132,11 @@ typedef void (*al_send_success_handler_t)(void);
 
 typedef struct tcl_init_s
 {
-	ble_send_handler_t			ble_send_handler;
+	ble_send_buf_handler_t		ble_send_handler;
 	al_recv_handler_t			al_recv_handler;
 	al_send_failed_handler_t	al_send_failed_handler;
 	al_send_success_handler_t	al_send_success_handler;
+	tcl_time_handler_t			time_handler;
 } tcl_init_t;
 
 typedef struct tcl_header_s
@@ -137,8 +179,18 @@ typedef struct tcl_timer_s
 {
 	tcl_timer_status_t	status; // Status of this timer.
 	uint8_t count;
+	uint32_t start; // Time of the start, uint(ms).
 } tcl_timer_t;
 
+typedef struct tcl_rtt_s
+{
+	uint32_t	srtt; // Smoothed round-trip time, uint(ms), 0 before the first sample.
+	uint32_t	rttvar; // Round-trip time variation, uint(ms).
+	uint32_t	rto; // Retransmission time-out, uint(ms), the back-off included.
+	uint32_t	samples; // Round-trip times measured.
+	uint32_t	timeouts; // Retransmission time-outs.
+} tcl_rtt_t;
+
 /**@brief Function for initializing the Transport Control Layer.
  *
  * @param[in]   p_init  Pointer to the TCL initiate Module.
@@ -151,18 +203,36 @@ void tcl_init(tcl_init_t* p_init);
  */
 tcl_send_status_t tcl_send_status(void);
 
+/**@brief Function for checking whether a packet is being received.
+ *
+ * @return true from the first sub-packet until the packet is taken by the AL or timed out.
+ */
+bool tcl_recv_busy(void);
+
+/**@brief Function for passing again to the AL the packet it could not take.
+ *
+ * @note The AL returns TCL_WAIT when its transmit queue has no room for the replies. The TCL keeps the
+ *		 packet and returns TCL_WAIT for the next data sub-packets, which stay in the RX buffer queue.
+ *		 Call it on every TCL tick, then let the RX buffer queue pass the sub-packets again.
+ *
+ * @return true if no packet waits for the AL any more.
+ */
+bool tcl_recv_resume(void);
+
 /**@brief Function for sending packet from the Application Layer to BLE Profile Layer.
  *
- * @note The Application layer should keep the data buffer until sending finishes.
+ * @note The packet is built in a chain of buffers taken with TCL_HEADER_LENGTH headroom, BLE_UART_PAYLOAD_MTU
+ *		 bytes in each but the last one. The sub-packets are framed in place, the header prepended in the headroom,
+ *		 and the TCL keeps a reference to those in flight. The Application layer keeps its own until sending finishes.
  *
- * @param[in]   p_data  		Pointer to the data buffer.
- * @param[in]   length  		Length of the data.
+ * @param[in]   p_packet  		The first buffer of the chain.
+ * @param[in]   length  		Length of the packet.
  *
  * @return @ref TCL_SUCCESS		Successfully sent the packet.
  * @return @ref TCL_ERROR		Common failed.
  * @return @ref TCL_WAIT		Wait and send again.
  */
-uint32_t tcl_send_packet(uint8_t* p_data, uint16_t length);
+uint32_t tcl_send_packet(packet_buf_t* p_packet, uint16_t length);
 
 /**@brief Function for received packet from the BLE Profile Layer.
  *
@@ -170,6 +240,7 @@ uint32_t tcl_send_packet(uint8_t* p_data, uint16_t length);
  * @param[in]   length  		Length of the data.
  *
  * @return @ref TCL_SUCCESS		Successfully sent the packet.
+ * @return @ref TCL_WAIT		The AL has not taken the packet before, pass this one again after tcl_recv_resume().
  * @return @ref TCL_ERROR		Common failed.
  */
 uint32_t tcl_recv_packet(uint8_t* p_data, uint16_t length);
@@ -177,13 +248,25 @@ uint32_t tcl_recv_packet(uint8_t* p_data, uint16_t length);
 /**@brief Function for processing the time-out situation.
  *
  * @note This function should be called by Chip Timer Handler, which should has 
-		 granularity of TCL_RESEND_MAX_TIMES ms.
- * @note If time-out when sending the sub-packet, resend the previous sub-packet.
+		 granularity of TCL_SEND_TIMER_INTERVAL ms.
+ * @note If no ACK came within the RTO, resend the sub-packets in flight and double the RTO.
  * @note If resend TCL_RESEND_MAX_TIMES times but failed to receive the ACk packet,
  *		 it means failed to send the packet from Application Layer(AL). Notice AL.
  *
  */
  void tcl_timer_time_out(void);
+
+/**@brief Function for dropping the packets on the way, the RTT estimate and the window of the peer, when the link is gone.
+ *
+ * @note A packet being sent is failed to the AL.
+ */
+void tcl_reset(void);
+
+/**@brief Function for getting the round-trip time estimate.
+ *
+ * @param[out]  p_rtt			Pointer to the estimate.
+ */
+void tcl_get_rtt(tcl_rtt_t* p_rtt);
  
 #endif
 
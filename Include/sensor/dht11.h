@@ -3,20 +3,87 @@
 
 #include <gpio.h>
 #include <pin.h>
+#include <pm25.h>
+#include <filter.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #define DHT11_QUEUE_LENGTH            10                          //As the Length for calculate the average
+#define DHT11_FILTER                  FILTER_MEAN
+#define DHT11_SCALE                   10                          //Readings are filtered in 0.1 degree and 0.1%RH
 #define DHT11_INIT_TIME               100													//100ms  	
+#define DHT11_CACHE_INTERVAL          2                           //uint(s) Read the DHT11 at most once in this time
+#define DHT11_START_TIME              20                          //uint(ms) Start signal, the line is held low
+#define DHT11_FRAME_TIME              10                          //uint(ms) Response and 40 bits take about 5ms
+#define DHT11_FRAME_LENGTH            5                           //RH, RH decimal, T, T decimal, checksum
+#define DHT11_FRAME_EDGES             83                          //Response falling, rising, falling, then 2 per bit
+#define DHT11_EDGE_COUNT              84                          //Room for the rising edge that ends the frame
+#define DHT11_BIT_THRESHOLD           45                          //uint(us) High 26-28us is 0, 70us is 1
+#define DHT11_BIT_MAX_WIDTH           100                         //uint(us) Longer means an edge was missed
+#define DHT11_LOW_MIN_WIDTH           35                          //uint(us) The low of every bit is 50us, outside of
+#define DHT11_LOW_MAX_WIDTH           65                          //these widths the edges are out of step
+
+//The capture shares TIMER1 and a PPI channel with the PM2.5 sequencer, the two never run together.
+#define DHT11_TIMER                   PM25_TIMER
+#define DHT11_TIMER_CC                1
+#define DHT11_PPI_CAPTURE             PM25_PPI_PULSE_OFF
+#define DHT11_GPIOTE_CHANNEL          3                           //0 and 1 drive the fan PWM, 2 the PM2.5 LED
+
+typedef struct {
+	float    temperature;
+	float    humidity;
+	uint32_t uUptime;                   //uint(s) of GetCalendarUptime() at the reading, never wraps
+	bool     bValid;                    //false until the first reading
+} Dht11Cache;
+
+typedef void (*Dht11Handler)(bool bValid, float temperature, float humidity);
+
+typedef struct {
+	uint32_t uReads;
+	uint32_t uChecksumErrors;
+	uint32_t uFrameErrors;              //No response, missing edges or a bit too long
+	uint32_t uLateEdges;                //Frames dropped because an edge was read after the next one, counted in uFrameErrors too
+	uint32_t uBusy;                     //StartDht11() refused
+} Dht11Statistics;
 
 void InitDht11(void);                                             //Initializing the DHT11
 
-void GetDht11(float *temperature, float *humidity);
+/**@brief Read the DHT11 in the background.
+ *
+ * @details The start signal is timed by an app_timer, the edges of the answer are captured by
+ *          TIMER1 through a GPIOTE IN channel in toggle mode and the PPI, and the frame is decoded when it is over.
+ *          The GPIOTE interrupt only copies the captured times, it never re-arms anything.
+ *          The handler, if any, runs from the app_timer, about 30ms later.
+ */
+uint32_t StartDht11(Dht11Handler handler);
+
+void StopDht11(void);                                             //Abandon the running read, its handler is not called.
+
+bool IsDht11Busy(void);
+
+void GetDht11Statistics(Dht11Statistics *pStatistics);
+
+/**@brief Decode a frame from the captured edge times (us), the first one being the falling edge of the response.
+ *
+ * @return NRF_SUCCESS, NRF_ERROR_INVALID_LENGTH or NRF_ERROR_INVALID_DATA if edges are missing,
+ *         NRF_ERROR_INVALID_STATE if the checksum is wrong.
+ */
+uint32_t Dht11DecodeFrame(const uint16_t *pEdges, uint8_t nEdges, uint8_t *pFrame);
+
+void GetDht11(float *temperature, float *humidity);             //The latest reading, does not wait
+
+bool GetCachedDht11(float *temperature, float *humidity);       //Starts a read when the cache is older than DHT11_CACHE_INTERVAL, returns true if it did
+
+void GetDht11Cache(Dht11Cache *pCache);                           //Never reads the sensor
+
+bool IsDht11CacheFresh(void);                                     //Read less than DHT11_CACHE_INTERVAL ago
 
 void GetAverageDht11(float *temperature, float *humidity);				//Get the average of DHT11
 
+void GetDht11QueueAverage(float *temperature, float *humidity);		//The same without starting a read
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,53 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+//INCLUDE
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+	FILTER_MEAN = 0,            //Moving average of the last N samples, running sum
+	FILTER_MEDIAN = 1,          //Median of the last N samples, a single outlier never shows
+	FILTER_EMA = 2              //Exponential moving average, weight 1/N, N a power of 2
+} FILTER_TYPE;
+
+#define FILTER_EMA_Q                 8            //Fraction bits of the EMA state, so |sample| < 2^23
+
+//Length of the buffer given to InitFilter().
+#define FILTER_BUFFER_LENGTH(type, length)  ((FILTER_MEDIAN == (type)) ? 2 * (length) : (FILTER_MEAN == (type)) ? (length) : 1)
+
+typedef struct {
+	FILTER_TYPE type;
+	uint8_t     nLength;
+	uint8_t     nIndex;         //Next slot of the window
+	uint8_t     nCount;         //Samples in the window, up to nLength
+	int32_t     *pWindow;       //Samples in arrival order
+	int32_t     *pSorted;       //FILTER_MEDIAN: the same samples in order of value
+	int32_t     nSum;           //FILTER_MEAN: sum of the window
+	int32_t     nEma;           //FILTER_EMA: Q FILTER_EMA_Q
+	uint8_t     nEmaShift;
+} Filter;
+
+/**@brief Set up a filter on a buffer of FILTER_BUFFER_LENGTH(type, nLength) words.
+ */
+void InitFilter(Filter *pFilter, FILTER_TYPE type, int32_t *pBuffer, uint8_t nLength);
+
+int32_t FilterInsert(Filter *pFilter, int32_t nSample);     //Add a sample and return the new output
+
+void FilterFill(Filter *pFilter, int32_t nSample);          //As if every sample so far had been this one
+
+int32_t FilterOutput(const Filter *pFilter);                //0 while the filter is empty
+
+bool IsFilterEmpty(const Filter *pFilter);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
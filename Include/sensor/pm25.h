@@ -3,6 +3,7 @@
 
 //INCLUDE
 #include <adc.h>
+#include <filter.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -12,22 +13,64 @@ extern "C" {
 #define PM25_PULSE_OFF               0
 #define PM25_ADC_NUMBER              ADC_CONFIG_PSEL_AnalogInput2  //P0.01
 #define PM25_INIT_TIME               1000                 //uint(ms) 1000ms
-#define PM25_SAMPLE_TIME             280
-#define PM25_SAMPLE_LEFT             40
-#define PM25_LOW_TIME                9680
-#define PM25_VOLTAGE_WITH_NO_DUST    0.40
-#define PM25_K                       153.85
+#define PM25_SAMPLE_TIME             280                  //uint(us) LED on to ADC start
+#define PM25_PULSE_WIDTH             320                  //uint(us) LED on time
+#define PM25_PERIOD                  10000                //uint(us) one pulse every 10ms
+#define PM25_PULSE_START             10                   //uint(us) LED on after the timer starts
+#define PM25_NO_DUST_MV              400                  //uint(mV) output with no dust
+#define PM25_K_X100                  15385                //153.85 ug/m3 per V
 #define PM25_MAX                     500
 #define PM25_MIN                     0
+#define PM25_SCALE                   10                   //Samples are filtered in 0.1ug/m3
 #define PM25_QUEUE_LENGTH            10
+#define PM25_FILTER                  FILTER_MEDIAN        //Rejects a single dust grain in the window
 #define PM25_BUF_SIZE                3  //xxxμg/m³
 
+//Hardware used by the pulse sequencer, TIMER0 belongs to the SoftDevice and TIMER2 to the fan PWM.
+#define PM25_TIMER                   NRF_TIMER1
+#define PM25_TIMER_IRQn              TIMER1_IRQn
+#define PM25_TIMER_IRQHandler        TIMER1_IRQHandler
+#define PM25_GPIOTE_CHANNEL          2
+#define PM25_PPI_PULSE_ON            2
+#define PM25_PPI_SAMPLE              3
+#define PM25_PPI_PULSE_OFF           7
+#define PM25_PPI_MASK                ((1 << PM25_PPI_PULSE_ON) | (1 << PM25_PPI_SAMPLE) | (1 << PM25_PPI_PULSE_OFF))
+
+typedef void (*Pm25BurstHandler)(float fPm25Value);       //The filter output after the last sample
+
+typedef struct {
+	uint32_t uSamples;
+	uint32_t uBursts;
+	uint32_t uBusy;             //StartPm25Burst() refused because a burst was running.
+	uint32_t uStopped;          //Bursts given up by StopPm25Burst() before the last sample
+} Pm25Statistics;
+
 void InitPm25(void);
 
-float GetPm25(void);
+/**@brief Sample PM2.5 nCount times, one pulse every PM25_PERIOD, timed by PM25_TIMER and the PPI.
+ *
+ * @details Every sample joins the PM25_FILTER from the scheduler. The handler, if any, gets the
+ *          filter output after the last one.
+ */
+uint32_t StartPm25Burst(uint8_t nCount, Pm25BurstHandler handler);
+
+/**@brief Give up the running burst, its handler is not called.
+ *
+ * @details For a burst whose last sample never came back. The pulses stop by themselves after nCount
+ *          periods, samples of the old burst still join the filter but are not counted for the next one.
+ */
+void StopPm25Burst(void);
+
+bool IsPm25Busy(void);
+
+void GetPm25Statistics(Pm25Statistics *pStatistics);
+
+float GetPm25(void);                  //The latest sample, does not wait.
 
 float GetAveragePM25(void);
 
+float GetAveragePM25Filter(void);     //The same without starting a pulse
+
 
 #ifdef __cplusplus
 }
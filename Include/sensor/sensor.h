@@ -16,11 +16,31 @@ typedef struct {
 	CalenderTime local_rtc;
 } SensorData;
 
+typedef void (*SensorHandler)(const SensorData *pSensorData);
+
+#define SENSOR_PM25_BURST            10           //PM2.5 pulses per acquisition, 10ms each
+#define SENSOR_STAGE_TIMEOUT         500          //uint(ms) a stage which has not ended by then is skipped
+
 void InitSensor(void);
 
 void CloseSensor(void);
 
-void GetSensorData(SensorData *SRet);
+/**@brief Start an acquisition of all the sensors and return at once.
+ *
+ * @details The stages advance on timer and ADC events. At the end the new SensorData is published in
+ *          one piece and passed to the handler, from the scheduler.
+ *
+ * @return NRF_SUCCESS, or NRF_ERROR_BUSY if an acquisition is running.
+ */
+uint32_t StartSensorAcquisition(SensorHandler handler);
+
+bool IsSensorBusy(void);
+
+uint32_t GetSensorSnapshotCount(void);
+
+uint32_t GetSensorTimeoutCount(void);           //Stages skipped by the stage watchdog
+
+void GetSensorData(SensorData *SRet);           //The last published snapshot, does not wait
 
 void LcdDisplaySensorData(SensorData sensor ,unsigned char LcdShowFlag);
 
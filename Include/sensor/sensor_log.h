@@ -0,0 +1,71 @@
+#ifndef SENSOR_LOG_H
+#define SENSOR_LOG_H
+
+//INCLUDE
+#include <stdbool.h>
+#include <stdint.h>
+#include <sensor.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SENSOR_LOG_INTERVAL          60           //uint(s) One record per interval, connected or not
+#define SENSOR_LOG_PAGE_COUNT        6            //Flash pages of the ring, one pstorage module each, see PSTORAGE_MAX_APPLICATIONS
+#define SENSOR_LOG_PAGE_SIZE         1024         //nRF51 flash page
+#define SENSOR_LOG_RECORD_SIZE       16
+#define SENSOR_LOG_PAGE_RECORDS      (SENSOR_LOG_PAGE_SIZE / SENSOR_LOG_RECORD_SIZE)
+#define SENSOR_LOG_CAPACITY          (SENSOR_LOG_PAGE_COUNT * SENSOR_LOG_PAGE_RECORDS)
+#define SENSOR_LOG_PENDING           4            //Records waiting for the flash
+#define SENSOR_LOG_EMPTY             0xFFFFFFFF   //Erased flash
+
+typedef struct {
+	uint32_t uSequence;         //Counts up from 0 over the life of the log
+	uint32_t uTime;             //uint(s) since 2000-01-01, see GetCalendarSeconds()
+	uint16_t uPm25;             //uint(0.1ug/m3)
+	uint16_t uTvoc;             //uint(ug/m3)
+	int8_t   nTemperature;      //uint(degree)
+	uint8_t  uHumidity;         //uint(%RH)
+	uint16_t uCrc;              //CRC-16 of the bytes above
+} SensorLogRecord;
+
+typedef struct {
+	uint32_t uAppended;
+	uint32_t uStored;
+	uint32_t uDropped;          //No room for one more pending record
+	uint32_t uFlashErrors;
+	uint32_t uErased;           //Pages erased to make room
+	uint32_t uCrcErrors;        //Seen by ReadSensorLog()
+} SensorLogStatistics;
+
+/**@brief Find the oldest and the newest record. pstorage_init() must have been called.
+ *
+ * @return NRF_SUCCESS, or the error of pstorage_register(). Then nothing is logged, AppendSensorLog() returns NRF_ERROR_INVALID_STATE.
+ */
+uint32_t InitSensorLog(void);
+
+/**@brief Append a record if SENSOR_LOG_INTERVAL is over since the last one.
+ */
+uint32_t LogSensorData(const SensorData *pSensorData);
+
+uint32_t AppendSensorLog(const SensorData *pSensorData);
+
+uint16_t GetSensorLogCount(void);
+
+uint32_t GetSensorLogFirstSequence(void);
+
+/**@brief Read the record nIndex, 0 is the oldest.
+ *
+ * @return NRF_SUCCESS, NRF_ERROR_INVALID_PARAM past the newest one, NRF_ERROR_INVALID_DATA if the CRC is wrong.
+ */
+uint32_t ReadSensorLog(uint16_t nIndex, SensorLogRecord *pRecord);
+
+void GetSensorLogStatistics(SensorLogStatistics *pStatistics);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
@@ -3,6 +3,7 @@
 
 //INCLUDE
 #include <adc.h>
+#include <filter.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -10,14 +11,26 @@ extern "C" {
 
 #define TVOC_ADC_NUMBER              ADC_CONFIG_PSEL_AnalogInput3
 #define TVOC_QUEUE_LENGTH            10
+#define TVOC_FILTER                  FILTER_MEAN                  //Samples are filtered in ug/m3
 #define TVOC_Formaldehyde_M          30
 #define TVOC_Toluene_M               92
 #define TVOC_BUF_SIZE                4
+#define TVOC_VOLTAGE_DIVIDER         0.72                         //Built into tvoc_lut.h, run tvoc_lut.py after a change
+#define TVOC_DEFAULT_TEMPERATURE     25                           //Used before the first DHT11 reading
+#define TVOC_TEMPERATURE_MIN         (-40)
+#define TVOC_TEMPERATURE_MAX         85
+#define TVOC_UG_PER_MG               1000.0f
+
+typedef void (*TvocHandler)(float fTvocValue);         //The filter output, the new sample included
 
 void InitTvoc(void);
 
 float GetTvoc(void);
 
+uint32_t StartTvoc(TvocHandler handler);                    //Start a conversion without waiting for it.
+
+void StopTvoc(void);                                        //Forget the handler of the running conversion.
+
 float GetAverageTvoc(void);
 
 
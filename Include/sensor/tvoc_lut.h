@@ -0,0 +1,49 @@
+/* Copyright (c) 2014 Before Technology. All Rights Reserved. */
+/* Generated by Source/sensor/tvoc_lut.py, do not edit. */
+#ifndef TVOC_LUT_H
+#define TVOC_LUT_H
+
+#include <stdint.h>
+
+#define TVOC_LUT_STEP          4                    //ADC codes between two entries
+#define TVOC_LUT_SHIFT         2
+#define TVOC_LUT_UG_DIVISOR    20384                //1e-5ppm * (273 + T) / this = ug/m3
+
+//Formaldehyde in 1e-5 ppm for the ADC codes 0, 4, ... 1024
+static const uint32_t sTvocLut[257] = {
+	234, 250, 268, 287, 307, 329, 352, 376,
+	402, 430, 460, 491, 525, 561, 599, 640,
+	683, 729, 778, 830, 885, 943, 1006, 1072,
+	1142, 1217, 1296, 1380, 1470, 1564, 1665, 1771,
+	1884, 2004, 2131, 2265, 2408, 2558, 2718, 2887,
+	3065, 3254, 3454, 3665, 3889, 4125, 4374, 4638,
+	4916, 5210, 5520, 5848, 6194, 6558, 6943, 7348,
+	7775, 8226, 8700, 9200, 9727, 10281, 10865, 11479,
+	12125, 12805, 13520, 14272, 15062, 15893, 16765, 17682,
+	18645, 19656, 20717, 21830, 22999, 24224, 25510, 26857,
+	28270, 29750, 31301, 32926, 34627, 36409, 38273, 40224,
+	42266, 44401, 46634, 48968, 51408, 53958, 56621, 59403,
+	62308, 65341, 68507, 71810, 75255, 78849, 82596, 86503,
+	90574, 94816, 99235, 103837, 108628, 113616, 118806, 124207,
+	129824, 135666, 141739, 148052, 154612, 161427, 168506, 175856,
+	183487, 191406, 199624, 208149, 216990, 226157, 235660, 245508,
+	255711, 266280, 277225, 288557, 300285, 312422, 324978, 337964,
+	351392, 365273, 379620, 394443, 409755, 425568, 441894, 458746,
+	476135, 494076, 512580, 531660, 551329, 571600, 592487, 614002,
+	636159, 658970, 682449, 706610, 731466, 757030, 783315, 810334,
+	838102, 866631, 895934, 926025, 956916, 988620, 1021151, 1054521,
+	1088742, 1123826, 1159787, 1196635, 1234383, 1273042, 1312624, 1353139,
+	1394599, 1437013, 1480392, 1524745, 1570083, 1616414, 1663746, 1712089,
+	1761449, 1811835, 1863252, 1915708, 1969209, 2023759, 2079363, 2136026,
+	2193752, 2252543, 2312401, 2373329, 2435328, 2498397, 2562537, 2627746,
+	2694023, 2761366, 2829770, 2899232, 2969747, 3041309, 3113912, 3187548,
+	3262209, 3337885, 3414567, 3492244, 3570903, 3650533, 3731119, 3812646,
+	3895099, 3978462, 4062717, 4147845, 4233827, 4320643, 4408271, 4496688,
+	4585871, 4675797, 4766439, 4857771, 4949767, 5042397, 5135632, 5229444,
+	5323799, 5418667, 5514015, 5609809, 5706013, 5802593, 5899512, 5996733,
+	6094218, 6191927, 6289822, 6387862, 6486005, 6584211, 6682435, 6780636,
+	6878769, 6976791, 7074655, 7172317, 7269730, 7366849, 7463626, 7560015,
+	7655966,
+};
+
+#endif
@@ -0,0 +1,96 @@
+/* Copyright (c) 2014 Before Technology. All Rights Reserved.
+ *
+ */
+
+/** @file
+ *
+ * @brief Connection Parameters Policy module.
+ *
+ * @details This module switches the connection between two profiles on top of the Connection Parameters
+ *          module. The bulk profile (short interval) is requested while the busy handler reports traffic,
+ *          the idle profile (long interval with slave latency, the one of ble_config.h) when it has been quiet
+ *          for BLE_CONN_POLICY_IDLE_TICKS. BLE_CONN_POLICY_DWELL_TICKS keeps the requests apart, so that a
+ *          request-response exchange does not renegotiate on every packet.
+ *
+ * @note    Needs one app_timer.
+ */
+
+#ifndef BLE_CONN_POLICY_H__
+#define BLE_CONN_POLICY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+#include "ble_conn_params.h"
+
+#define BLE_CONN_POLICY_TICK_INTERVAL		500 // uint(ms) The busy handler is polled in this interval.
+#define BLE_CONN_POLICY_IDLE_TICKS			10 // Quiet ticks before going back to the idle profile.
+#define BLE_CONN_POLICY_DWELL_TICKS			4 // Ticks at least between two requests.
+
+#define BLE_CONN_POLICY_BULK_MIN_INTERVAL	MSEC_TO_UNITS(7.5, UNIT_1_25_MS) // Minimum interval of the bulk profile (7.5 ms).
+#define BLE_CONN_POLICY_BULK_MAX_INTERVAL	MSEC_TO_UNITS(20, UNIT_1_25_MS) // Maximum interval of the bulk profile (20 ms).
+#define BLE_CONN_POLICY_BULK_SLAVE_LATENCY	0
+#define BLE_CONN_POLICY_BULK_SUP_TIMEOUT	MSEC_TO_UNITS(4000, UNIT_10_MS) // Supervisory timeout of the bulk profile (4 seconds).
+
+typedef enum
+{
+	BLE_CONN_POLICY_IDLE,	// Long interval with slave latency.
+	BLE_CONN_POLICY_BULK	// Short interval.
+} ble_conn_policy_mode_t;
+
+/**@brief Function for telling the policy whether data is waiting to be transferred.
+ *
+ * @return true if the bulk profile is wanted.
+ */
+typedef bool (*ble_conn_policy_busy_handler_t)(void);
+
+typedef struct
+{
+	ble_conn_policy_busy_handler_t	busy_handler;
+	ble_gap_conn_params_t			idle_params;	// Parameters of the idle profile.
+} ble_conn_policy_init_t;
+
+typedef struct
+{
+	uint16_t	requested; // Renegotiations started by the policy.
+	uint16_t	accepted; // The central switched to the requested profile.
+	uint16_t	rejected; // The central chose parameters outside of it, or the request failed.
+	uint16_t	conn_interval; // Interval in use, uint(1.25ms).
+	uint16_t	slave_latency; // Slave latency in use.
+	ble_conn_policy_mode_t	mode; // Profile requested last.
+} ble_conn_policy_statistics_t;
+
+/**@brief Function for initializing the Connection Parameters Policy module.
+ *
+ * @param[in]   p_init     Busy handler and parameters of the idle profile.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code of app_timer.
+ */
+uint32_t ble_conn_policy_init(const ble_conn_policy_init_t * p_init);
+
+/**@brief Function for handling the Application's BLE Stack events.
+ *
+ * @details Starts polling on connection, stops it on disconnection and counts the answers of the central.
+ *
+ * @param[in]   p_ble_evt  Event received from the BLE stack.
+ */
+void ble_conn_policy_on_ble_evt(ble_evt_t * p_ble_evt);
+
+/**@brief Function for handling the events of the Connection Parameters module.
+ *
+ * @param[in]   p_evt      Event received from the Connection Parameters module.
+ *
+ * @return      true if the event concerns the bulk profile and is handled here, false if the
+ *              application should handle it as before.
+ */
+bool ble_conn_policy_on_conn_params_evt(ble_conn_params_evt_t * p_evt);
+
+/**@brief Function for getting the counters of the policy.
+ *
+ * @param[out]  p_statistics   Pointer to the statistics.
+ */
+void ble_conn_policy_get_statistics(ble_conn_policy_statistics_t * p_statistics);
+
+#endif // BLE_CONN_POLICY_H__
+
+/** @} */
@@ -33,6 +33,24 @@
 #define IAQ_RESERVED1_CHAR_USER_DESC	(uint8_t*)"Instant Reserved1 Characteristic"
 #define IAQ_RESERVED2_CHAR_USER_DESC	(uint8_t*)"Instant Reserved2 Characteristic"
 
+#define IAQ_NOTIFY_MIN_INTERVAL			(uint32_t)5 // uint(s) A characteristic notifies at most once in this time.
+
+// Change from the value notified last which is notified, the same as the real-time push of the AL.
+#define IAQ_NOTIFY_DEADBAND_PM25		5.0f // uint(ug/m3)
+#define IAQ_NOTIFY_DEADBAND_TVOC		0.05f // uint(mg/m3)
+#define IAQ_NOTIFY_DEADBAND_TEMP		0.5f // uint(degree)
+#define IAQ_NOTIFY_DEADBAND_HUMI		2.0f // uint(%RH)
+
+// Index of the characteristics which notify on change.
+typedef enum
+{
+	IAQ_CHAR_PM25,
+	IAQ_CHAR_TVOC,
+	IAQ_CHAR_TEMP,
+	IAQ_CHAR_HUMI,
+	IAQ_CHAR_COUNT
+} ble_iaq_char_t;
+
 // Forward declaration of the ble_instant_air_quality_t type. 
 typedef struct ble_instant_air_quality_s ble_iaq_t;
 
@@ -55,6 +73,9 @@ typedef struct ble_instant_air_quality_s
     ble_gatts_char_handles_t	reserved1_handles;	/**< Handles related to the Instant Reserved1 characteristic. */
     ble_gatts_char_handles_t	reserved2_handles;	/**< Handles related to the Instant Reserved2 characteristic. */
     uint16_t					conn_handle;		/**< Handle of the current connection (as provided by the BLE stack, is BLE_CONN_HANDLE_INVALID if not in a connection). */
+    float						notified_value[IAQ_CHAR_COUNT];	/**< Value notified last of each characteristic. */
+    uint32_t					notified_time[IAQ_CHAR_COUNT];	/**< Time of it, uint(s) of GetCalendarUptime(). */
+    bool						is_notified[IAQ_CHAR_COUNT];	/**< Something notified since the connection. */
 } ble_iaq_t;
 
 /**@brief Function for initializing the Instant Air Quality Service.
@@ -79,22 +100,29 @@ uint32_t ble_iaq_init(ble_iaq_t * p_iaq, const ble_iaq_init_t * p_iaq_init);
 void ble_iaq_on_ble_evt(ble_iaq_t * p_iaq, ble_evt_t * p_ble_evt);
 
 
-uint32_t ble_iaq_on_pm25_change(ble_iaq_t *p_iaq, uint8_t button_state);
-
-
-uint32_t ble_iaq_on_tvoc_change(ble_iaq_t *p_iaq, uint8_t button_state);
-
-
-uint32_t ble_iaq_on_temp_change(ble_iaq_t *p_iaq, uint8_t button_state);
-
-
-uint32_t ble_iaq_on_humi_change(ble_iaq_t *p_iaq, uint8_t button_state);
-
+/**@brief Function for updating the PM2.5 characteristic.
+ *
+ * @details The value is always stored for reading. It is notified when it moved more than its
+ *          IAQ_NOTIFY_DEADBAND_* from the value notified last, and IAQ_NOTIFY_MIN_INTERVAL has passed since.
+ *
+ * @param[in]   p_iaq      Instant Air Quality Service structure.
+ * @param[in]   pm25       PM2.5, uint(ug/m3).
+ *
+ * @return      NRF_SUCCESS if stored, notified or held back, otherwise an error code.
+ */
+uint32_t ble_iaq_on_pm25_change(ble_iaq_t *p_iaq, float pm25);
 
-uint32_t ble_iaq_on_reserved1_change(ble_iaq_t *p_iaq, uint8_t button_state);
+/**@brief Function for updating the TVOC characteristic, uint(mg/m3). See ble_iaq_on_pm25_change().
+ */
+uint32_t ble_iaq_on_tvoc_change(ble_iaq_t *p_iaq, float tvoc);
 
+/**@brief Function for updating the Temperature characteristic, uint(degree). See ble_iaq_on_pm25_change().
+ */
+uint32_t ble_iaq_on_temp_change(ble_iaq_t *p_iaq, float temperature);
 
-uint32_t ble_iaq_on_reserved2_change(ble_iaq_t *p_iaq, uint8_t button_state);
+/**@brief Function for updating the Humidity characteristic, uint(%RH). See ble_iaq_on_pm25_change().
+ */
+uint32_t ble_iaq_on_humi_change(ble_iaq_t *p_iaq, float humidity);
 
 #endif // BLE_ID_H__
 
@@ -1,24 +1,181 @@
 #include <adc.h>
 #include <nrf_soc.h>
+#include <app_scheduler.h>
+
+static AdcRequest        sAdcQueue[ADC_QUEUE_LENGTH];
+static volatile uint8_t  snAdcQueueRead = 0;       //Free running, masked by ADC_QUEUE_MASK on access.
+static volatile uint8_t  snAdcQueueWrite = 0;
+static volatile bool     sbAdcConverting = false;  //The request at the head of queue is on the ADC.
+static volatile bool     sbHfclkRequested = false;
+static uint8_t           snAdcHeadLeft = 0;        //Conversions left for the head request.
+static AdcStatistics     sAdcStatistics;
+
+static __INLINE uint8_t AdcQueueDepth(void)
+{
+	return (uint8_t)(snAdcQueueWrite - snAdcQueueRead);
+}
+
+static __INLINE void AdcEnterCritical(uint8_t *pNested)
+{
+	sd_nvic_critical_region_enter(pNested);
+}
+
+static __INLINE void AdcExitCritical(uint8_t nNested)
+{
+	sd_nvic_critical_region_exit(nNested);
+}
+
+static __INLINE void AdcConfig(uint32_t uAdcNumber)
+{
+	NRF_ADC->CONFIG = (ADC_CONFIG_RES_10bit << ADC_CONFIG_RES_Pos)
+	                | (ADC_CONFIG_INPSEL_AnalogInputOneThirdPrescaling << ADC_CONFIG_INPSEL_Pos)
+									| (ADC_CONFIG_REFSEL_VBG << ADC_CONFIG_REFSEL_Pos)
+									| (uAdcNumber << ADC_CONFIG_PSEL_Pos);
+}
+
+static void AdcScheduleHandler(void *p_event_data, uint16_t event_size)
+{
+	AdcEvent *pEvent = (AdcEvent *)p_event_data;
+	if (NULL != pEvent->handler)
+		pEvent->handler(pEvent->uAdcValue, pEvent->pContext);
+}
+
+/**@brief Put the conversion of the head request on the ADC.
+ *
+ * @note Must be called with the queue protected, and only when the HFCLK is running.
+ */
+static void AdcStartHead(void)
+{
+	if (sbAdcConverting || 0 == AdcQueueDepth())
+		return;
+	AdcRequest *pRequest = &sAdcQueue[snAdcQueueRead & ADC_QUEUE_MASK];
+	sbAdcConverting = true;
+	snAdcHeadLeft = (0 == pRequest->nTriggerCount) ? 1 : pRequest->nTriggerCount;
+	AdcConfig(pRequest->uAdcNumber);
+	NRF_ADC->EVENTS_END = ADC_IDLE;
+	NRF_ADC->INTENSET = ADC_INTENSET_END_Msk;
+	if (0 == pRequest->nTriggerCount)
+		NRF_ADC->TASKS_START = 1;
+	else if (NULL != pRequest->armHandler)
+		pRequest->armHandler(pRequest->pContext);   //The owner of the PPI trigger may start now.
+}
+
+/**@brief Request the HFCLK and start the head request once it runs.
+ *
+ * @note The conversion starts from AdcOnSysEvt() if the crystal is not running yet.
+ */
+static void AdcKick(void)
+{
+	uint32_t uIsRunning = 0;
+	if (!sbHfclkRequested) {
+		sbHfclkRequested = true;
+		sd_clock_hfclk_request();
+	}
+	sd_clock_hfclk_is_running(&uIsRunning);
+	if (uIsRunning)
+		AdcStartHead();
+}
 
 void InitAdc(void)
 {
 	NRF_ADC->ENABLE = 1;
 	NRF_ADC->EVENTS_END = ADC_IDLE;
+	NRF_ADC->INTENCLR = ADC_INTENCLR_END_Msk;
+	snAdcQueueRead = snAdcQueueWrite = 0;
+	sbAdcConverting = false;
+
+	sd_nvic_ClearPendingIRQ(ADC_IRQn);
+	sd_nvic_SetPriority(ADC_IRQn, NRF_APP_PRIORITY_LOW);
+	sd_nvic_EnableIRQ(ADC_IRQn);
 }
+
+uint32_t QueueAdcRequest(const AdcRequest *pRequest)
+{
+	uint8_t nNested = 0;
+	AdcEnterCritical(&nNested);
+	if (ADC_QUEUE_LENGTH == AdcQueueDepth()) {
+		sAdcStatistics.uRejected++;
+		AdcExitCritical(nNested);
+		return NRF_ERROR_NO_MEM;
+	}
+	sAdcQueue[snAdcQueueWrite & ADC_QUEUE_MASK] = *pRequest;
+	snAdcQueueWrite++;
+	sAdcStatistics.uRequests++;
+	if (AdcQueueDepth() > sAdcStatistics.nMaxDepth)
+		sAdcStatistics.nMaxDepth = AdcQueueDepth();
+	AdcKick();
+	AdcExitCritical(nNested);
+	return NRF_SUCCESS;
+}
+
+uint32_t StartAdc(uint32_t uAdcNumber, AdcHandler handler, void *pContext)
+{
+	AdcRequest request;
+	request.uAdcNumber = uAdcNumber;
+	request.nTriggerCount = 0;
+	request.handler = handler;
+	request.armHandler = NULL;
+	request.pContext = pContext;
+	return QueueAdcRequest(&request);
+}
+
+bool IsAdcBusy(void)
+{
+	return 0 != AdcQueueDepth();
+}
+
+void GetAdcStatistics(AdcStatistics *pStatistics)
+{
+	*pStatistics = sAdcStatistics;
+}
+
+void AdcOnSysEvt(uint32_t uSysEvt)
+{
+	if (NRF_EVT_HFCLKSTARTED == uSysEvt && sbHfclkRequested)
+		AdcStartHead();
+}
+
+void ADC_IRQHandler(void)
+{
+	if (ADC_IDLE == NRF_ADC->EVENTS_END)
+		return;
+	NRF_ADC->EVENTS_END = ADC_IDLE;
+
+	AdcEvent event;
+	AdcRequest *pRequest = &sAdcQueue[snAdcQueueRead & ADC_QUEUE_MASK];
+	event.handler = pRequest->handler;
+	event.pContext = pRequest->pContext;
+	event.uAdcValue = NRF_ADC->RESULT & ADC_RESULT_RESULT_Msk;
+	NRF_ADC->TASKS_STOP = 1;
+
+	sAdcStatistics.uConversions++;
+	if (NRF_SUCCESS != app_sched_event_put(&event, sizeof(event), AdcScheduleHandler))
+		sAdcStatistics.uRejected++;
+	if (0 != --snAdcHeadLeft)
+		return;                               //Wait for the next START from the PPI.
+	snAdcQueueRead++;
+	sbAdcConverting = false;
+
+	if (0 != AdcQueueDepth()) {
+		AdcStartHead();                       //The HFCLK is still running, go on with the next request.
+	} else {
+		NRF_ADC->INTENCLR = ADC_INTENCLR_END_Msk;
+		sbHfclkRequested = false;
+		sd_clock_hfclk_release();             //Release the external crystal
+	}
+}
+
 void OpenAdc(uint32_t uAdcNumber)
 {
-	uint32_t p_is_running = 0;	
+	uint32_t p_is_running = 0;
+	while (IsAdcBusy());                    //Let the queued conversions finish, the polled one owns the ADC.
 	sd_clock_hfclk_request();
 	while(! p_is_running) {  							//wait for the hfclk to be available
 		sd_clock_hfclk_is_running((&p_is_running));
-	}   
-	
+	}
+
 	while (ADC_BUSY == NRF_ADC->EVENTS_END);
-	NRF_ADC->CONFIG = (ADC_CONFIG_RES_10bit << ADC_CONFIG_RES_Pos)
-	                | (ADC_CONFIG_INPSEL_AnalogInputOneThirdPrescaling << ADC_CONFIG_INPSEL_Pos)
-									| (ADC_CONFIG_REFSEL_VBG << ADC_CONFIG_REFSEL_Pos)
-									| (uAdcNumber << ADC_CONFIG_PSEL_Pos);
+	AdcConfig(uAdcNumber);
 	NRF_ADC->TASKS_START = 1;
 }
 
@@ -34,7 +191,7 @@ uint32_t GetAdcValue(void)
 	uint32_t uRet = NRF_ADC->RESULT & ADC_RESULT_RESULT_Msk;
 	NRF_ADC->TASKS_STOP = 1;
 	NRF_ADC->EVENTS_END = 0;
-	
+
 	//Release the external crystal
 	sd_clock_hfclk_release();
 	return uRet;
@@ -54,4 +211,3 @@ float GetVoltage(uint32_t uAdcNumber)
 	return fAdcVoltage;
 }
 
-
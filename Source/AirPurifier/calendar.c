@@ -0,0 +1,158 @@
+#include <calendar.h>
+#include <app_timer.h>
+#include <nrf_soc.h>
+#include <ble_config.h>
+
+#define CALENDAR_TICKS_PER_SECOND   (32768 / (APP_TIMER_PRESCALER + 1))
+
+static const uint16_t snDaysBeforeMonth[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+
+static app_timer_id_t sCalendarTimerId;
+static uint32_t suUptime = 0;           //uint(s) at suLastTick
+static uint32_t suRemainder = 0;        //Ticks after suUptime, below CALENDAR_TICKS_PER_SECOND
+static uint32_t suLastTick = 0;
+static uint32_t suOffset = 0;           //Calendar seconds minus uptime
+static uint32_t suLastResync = 0;
+static uint32_t suFirstSync = 0;
+static bool sbSynced = false;
+static CalendarStatistics sCalendarStatistics;
+
+/**@brief Fold the ticks since suLastTick into suUptime, before the 24 bit counter wraps.
+ */
+static void CalendarAdvance(void)
+{
+	uint32_t uNow = 0, uElapsed = 0;
+	uint8_t nNested = 0;
+	sd_nvic_critical_region_enter(&nNested);
+	app_timer_cnt_get(&uNow);
+	app_timer_cnt_diff_compute(uNow, suLastTick, &uElapsed);
+	uElapsed += suRemainder;
+	suUptime += uElapsed / CALENDAR_TICKS_PER_SECOND;
+	suRemainder = uElapsed % CALENDAR_TICKS_PER_SECOND;
+	suLastTick = uNow;
+	sd_nvic_critical_region_exit(nNested);
+}
+
+static __INLINE bool IsCalenderTimeValid(const CalenderTime *ct)
+{
+	return ct->year <= 99 && ct->month >= 1 && ct->month <= 12 && ct->date >= 1 && ct->date <= 31
+	    && ct->hour <= 23 && ct->minute <= 59 && ct->second <= 59;
+}
+
+static void CalendarTimeoutHandler(void *pContext)
+{
+	CalendarAdvance();
+	if (suUptime - suLastResync >= CALENDAR_RESYNC_INTERVAL)
+		ResyncCalendar();
+}
+
+uint32_t CalenderTimeToSeconds(const CalenderTime *ct)
+{
+	uint32_t uDays = (ct->year / 4) * CALENDAR_DAYS_PER_4_YEARS + (ct->year % 4) * 365 + ((ct->year % 4) ? 1 : 0);
+	uDays += snDaysBeforeMonth[ct->month - 1] + ct->date - 1;
+	if (0 == ct->year % 4 && ct->month > 2)
+		uDays++;                                        //2000 to 2099, every 4th year is a leap year
+	return uDays * CALENDAR_SECONDS_PER_DAY + ct->hour * 3600UL + ct->minute * 60 + ct->second;
+}
+
+void SecondsToCalenderTime(uint32_t uSeconds, CalenderTime *ct)
+{
+	uint32_t uDays = uSeconds / CALENDAR_SECONDS_PER_DAY;
+	uint32_t uTime = uSeconds % CALENDAR_SECONDS_PER_DAY;
+	ct->hour = uTime / 3600;
+	ct->minute = (uTime / 60) % 60;
+	ct->second = uTime % 60;
+
+	uint32_t uYear = (uDays / CALENDAR_DAYS_PER_4_YEARS) * 4;
+	uDays %= CALENDAR_DAYS_PER_4_YEARS;
+	bool bLeap = (uDays < 366);
+	if (!bLeap) {
+		uDays -= 366;
+		uYear += 1 + uDays / 365;
+		uDays %= 365;
+	}
+	ct->year = uYear;
+
+	int nMonth = 11;
+	while (uDays < snDaysBeforeMonth[nMonth] + ((bLeap && nMonth >= 2) ? 1 : 0))
+		--nMonth;
+	uDays -= snDaysBeforeMonth[nMonth] + ((bLeap && nMonth >= 2) ? 1 : 0);
+	ct->month = nMonth + 1;
+	ct->date = uDays + 1;
+}
+
+uint32_t GetCalendarUptime(void)
+{
+	uint32_t uNow = 0, uElapsed = 0, uUptime;
+	uint8_t nNested = 0;
+	sd_nvic_critical_region_enter(&nNested);
+	app_timer_cnt_get(&uNow);
+	app_timer_cnt_diff_compute(uNow, suLastTick, &uElapsed);
+	uUptime = suUptime + (uElapsed + suRemainder) / CALENDAR_TICKS_PER_SECOND;
+	sd_nvic_critical_region_exit(nNested);
+	return uUptime;
+}
+
+uint32_t GetCalendarSeconds(void)
+{
+	return GetCalendarUptime() + suOffset;
+}
+
+void GetCalenderTime(CalenderTime *ct)
+{
+	SecondsToCalenderTime(GetCalendarSeconds(), ct);
+}
+
+int SetCalenderTime(CalenderTime *ct)
+{
+	if (0 != SetRtcCalenderTime(ct))
+		return -1;
+	suOffset = CalenderTimeToSeconds(ct) - GetCalendarUptime();
+	suLastResync = GetCalendarUptime();
+	suFirstSync = suLastResync;                         //A new time, the drift starts again
+	sCalendarStatistics.nTotalDrift = 0;
+	sbSynced = true;
+	return 0;
+}
+
+void ResyncCalendar(void)
+{
+	CalenderTime ct;
+	GetRtcCalenderTime(&ct);
+	suLastResync = GetCalendarUptime();
+	sCalendarStatistics.uResyncs++;
+	if (!IsCalenderTimeValid(&ct)) {
+		sCalendarStatistics.uRtcErrors++;
+		return;
+	}
+	uint32_t uRtcSeconds = CalenderTimeToSeconds(&ct);
+	if (!sbSynced) {
+		suOffset = uRtcSeconds - suLastResync;
+		suFirstSync = suLastResync;
+		sbSynced = true;
+		return;
+	}
+
+	int32_t nDrift = (int32_t)(uRtcSeconds - (suLastResync + suOffset));
+	sCalendarStatistics.nLastDrift = nDrift;
+	if (nDrift >= CALENDAR_RESYNC_THRESHOLD || nDrift <= -CALENDAR_RESYNC_THRESHOLD) {
+		suOffset += nDrift;
+		sCalendarStatistics.nTotalDrift += nDrift;
+		sCalendarStatistics.uCorrections++;
+	}
+	if (suLastResync != suFirstSync)
+		sCalendarStatistics.nDriftPpm = (int32_t)((int64_t)sCalendarStatistics.nTotalDrift * 1000000 / (int32_t)(suLastResync - suFirstSync));
+}
+
+void GetCalendarStatistics(CalendarStatistics *pStatistics)
+{
+	*pStatistics = sCalendarStatistics;
+}
+
+void InitCalendar(void)
+{
+	app_timer_cnt_get(&suLastTick);
+	ResyncCalendar();
+	app_timer_create(&sCalendarTimerId, APP_TIMER_MODE_REPEATED, CalendarTimeoutHandler);
+	app_timer_start(sCalendarTimerId, APP_TIMER_TICKS(CALENDAR_TIMER_INTERVAL * 1000, APP_TIMER_PRESCALER), NULL);
+}
@@ -5,6 +5,8 @@ void InitAirPurifier(void)										//Initialing the AirPurifier.
 		InitLed();
 		InitLCD();
 		InitRtc();
+		InitCalendar();			//Reads the DS1302 once, then runs on RTC1
+		(void)InitSensorLog();	//Needs pstorage_init() and the calendar. Without the log the purifier still runs.
 		InitSensor();
 		InitFan();
 }
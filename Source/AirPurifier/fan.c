@@ -13,6 +13,8 @@
 //#define FAN_POWER_CONTROL_PIN             5  	//For Fan Power Control
 //#define FAN_SPEED_MONITIOR_PIN            6  	//For Fan Speed Monitior
 
+static uint8_t suFanDutyCycle = 0;
+
 
 void InitFan(void)													//Initaling the fan
 {
@@ -45,9 +47,15 @@ void CloseFan(void)												//Close the fan
 
 void SetFanSpeed(uint8_t duty_cycle)	 		//Changing the duty-cycle of motor when the fan is openning
 {
+	suFanDutyCycle = duty_cycle;
 	nrf_pwm_set_value(0,duty_cycle);
 }
 
+uint8_t GetFanDutyCycle(void)
+{
+	return suFanDutyCycle;
+}
+
 uint16_t ReadFanSpeed(void)	 							//Reading the speed of fan. 
 {
 	uint16_t rpm;
@@ -1,4 +1,5 @@
 #include <rtc.h>
+#include <calendar.h>
 
 static __INLINE void RtcShortDelay(void)
 {
@@ -92,6 +93,44 @@ static __INLINE void RtcWriteTime(RTC_WRITE_COMMAND_TYPE command, uint8_t nTime)
 	RtcShortDelay();
 }
 
+static __INLINE void RtcReadClockBurst(uint8_t *pRegs)     //All the clock registers in one CE session
+{
+	int i;
+	DisableRtc();
+	RtcShortDelay();
+	EnableRtc();
+	RtcLongDelay();
+	RtcWriteByte(RTC_READ_CLOCK_BURST);
+	for (i = 0; i < RTC_CLOCK_BURST_LENGTH; ++i) {
+		pRegs[i] = RtcReadByte();
+	}
+	DisableRtc();
+	RtcShortDelay();
+}
+
+static __INLINE void RtcWriteClockBurst(const uint8_t *pRegs)
+{
+	int i;
+	DisableRtc();
+	RtcShortDelay();
+	EnableRtc();
+	RtcLongDelay();
+	RtcWriteByte(RTC_WRITE_CLOCK_BURST);
+	for (i = 0; i < RTC_CLOCK_BURST_LENGTH; ++i) {
+		RtcWriteByte(pRegs[i]);
+	}
+	DisableRtc();
+	RtcShortDelay();
+}
+
+static __INLINE WEEK_DAY_TYPE RtcWeekDay(int nYear, int nMonth, int nDate)  //nYear since 2000
+{
+	static const uint8_t snMonthOffset[12] = {0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4};
+	int y = 2000 + nYear - ((nMonth < 3) ? 1 : 0);
+	int nDay = (y + y / 4 - y / 100 + y / 400 + snMonthOffset[nMonth - 1] + nDate) % 7;  //0 is Sunday
+	return (WEEK_DAY_TYPE)(nDay + SUNDAY);
+}
+
 int GetSecond(void)
 {
 	uint8_t nTime = RtcReadTime(RTC_READ_SECOND);
@@ -216,25 +255,35 @@ int SetYear(int nYear)
 	return 0;
 }
 
-void SetCalenderTime(CalenderTime *ct)
+int SetRtcCalenderTime(CalenderTime *ct)
 {
-	SetYear(ct->year);
-	SetMonth(ct->month);
-	SetDate(ct->date);
-	SetHour(ct->hour);
-	SetMinute(ct->minute);
-	SetSecond(ct->second);
+	if (ct->year > 99 || ct->month < 1 || ct->month > 12 || ct->date < 1 || ct->date > 31
+	 || ct->hour > 23 || ct->minute > 59 || ct->second > 59)
+		return -1;
+	uint8_t nRegs[RTC_CLOCK_BURST_LENGTH];
+	nRegs[0] = GET_RTC_TIME_8BIT_FORMAT(ct->second);    //CH cleared, the clock runs
+	nRegs[1] = GET_RTC_TIME_8BIT_FORMAT(ct->minute);
+	nRegs[2] = GET_RTC_TIME_8BIT_FORMAT(ct->hour);      //24 hour mode
+	nRegs[3] = GET_RTC_TIME_8BIT_FORMAT(ct->date);
+	nRegs[4] = GET_RTC_TIME_8BIT_FORMAT(ct->month);
+	nRegs[5] = RtcWeekDay(ct->year, ct->month, ct->date);
+	nRegs[6] = GET_RTC_TIME_8BIT_FORMAT(ct->year);
+	nRegs[7] = RTC_ENABLE_WRITE;                        //The burst must write WP too
+	RtcWriteClockBurst(nRegs);
 //	RtcDisableWrite();
+	return 0;
 }
 
-void GetCalenderTime(CalenderTime *ct)
+void GetRtcCalenderTime(CalenderTime *ct)
 {
-	ct->second = (uint8_t)GetSecond();
-	ct->minute = (uint8_t)GetMinute();
-	ct->hour   = (uint8_t)GetHour();
-	ct->date   = (uint8_t)GetDate();
-	ct->month  = (uint8_t)GetMonth();
-	ct->year   = (uint8_t)GetYear();
+	uint8_t nRegs[RTC_CLOCK_BURST_LENGTH];
+	RtcReadClockBurst(nRegs);                           //One snapshot, it cannot tear at a rollover
+	ct->second = ((nRegs[0] >> 4) & 0x07) * 10 + (nRegs[0] & 0x0F);
+	ct->minute = ((nRegs[1] >> 4) & 0x07) * 10 + (nRegs[1] & 0x0F);
+	ct->hour   = ((nRegs[2] >> 4) & 0x03) * 10 + (nRegs[2] & 0x0F);
+	ct->date   = ((nRegs[3] >> 4) & 0x03) * 10 + (nRegs[3] & 0x0F);
+	ct->month  = ((nRegs[4] >> 4) & 0x01) * 10 + (nRegs[4] & 0x0F);
+	ct->year   = ((nRegs[6] >> 4) & 0x0F) * 10 + (nRegs[6] & 0x0F);
 }
 
 int GetCalenderTimeStr(char *pBuf, int nLen)
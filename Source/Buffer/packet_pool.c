@@ -0,0 +1,196 @@
+/* Copyright (c) 2015 [@Mida]. All Rights Reserved.
+ *
+ */
+
+#include <string.h>
+#include <nrf_soc.h>
+#include <packet_pool.h>
+
+//A chain of one buffer at least must fit beside the reserve.
+typedef char packet_pool_reserve_check_t[(PACKET_POOL_SIZE > PACKET_POOL_RESERVE) ? 1 : -1];
+
+static packet_buf_t        m_packet_pool[PACKET_POOL_SIZE];   //The buffers of the pool.
+static uint8_t             m_packet_free[PACKET_POOL_SIZE];   //Stack of the free buffers, by index.
+static uint8_t             m_packet_free_count;
+static packet_pool_statistics_t   m_packet_pool_statistics;
+
+/**@brief The func for initializing the packet buffer pool, all the buffers are free.
+*/
+void packet_pool_init(void)
+{
+	for (uint8_t i = 0; i < PACKET_POOL_SIZE; i++)
+	{
+		m_packet_pool[i].ref_count = 0;
+		m_packet_free[i] = i;
+	}
+	m_packet_free_count = PACKET_POOL_SIZE;
+	m_packet_pool_statistics.alloc_failed = 0;
+	m_packet_pool_statistics.min_free = PACKET_POOL_SIZE;
+}
+
+/**@brief The func for taking a buffer from the pool, with one reference.
+* @param[in]   uint8_t   headroom  Bytes kept in front of the packet for the headers prepended later.
+* @return The buffer with an empty packet, NULL if the pool is empty.
+*/
+packet_buf_t * packet_buf_alloc(uint8_t headroom)
+{
+	packet_buf_t * p_buf = NULL;
+	uint8_t nested = 0;
+	if (headroom > PACKET_BUF_SIZE)
+		return NULL;
+	sd_nvic_critical_region_enter(&nested);
+	if (0 == m_packet_free_count)
+		m_packet_pool_statistics.alloc_failed++;
+	else
+	{
+		p_buf = &m_packet_pool[m_packet_free[--m_packet_free_count]];
+		p_buf->ref_count = 1;
+		if (m_packet_free_count < m_packet_pool_statistics.min_free)
+			m_packet_pool_statistics.min_free = m_packet_free_count;
+	}
+	sd_nvic_critical_region_exit(nested);
+	if (NULL != p_buf)
+	{
+		p_buf->p_next = NULL;
+		p_buf->offset = headroom;
+		p_buf->length = 0;
+	}
+	return p_buf;
+}
+
+/**@brief The func for taking the buffers of a long packet from the pool, chained by p_next, each with one reference.
+* @note All the buffers or none. PACKET_POOL_RESERVE buffers stay in the pool for the RX buffer queue and the ACKs.
+* @param[in]   uint8_t   count     Buffers of the chain, 1 at least.
+* @param[in]   uint8_t   headroom  Bytes kept in front of the packet in every buffer.
+* @return The first buffer of the chain, NULL if the pool is short.
+*/
+packet_buf_t * packet_chain_alloc(uint8_t count, uint8_t headroom)
+{
+	packet_buf_t * p_first = NULL;
+	uint8_t nested = 0;
+	if (0 == count || headroom > PACKET_BUF_SIZE)
+		return NULL;
+	sd_nvic_critical_region_enter(&nested);
+	if (m_packet_free_count < PACKET_POOL_RESERVE || m_packet_free_count - PACKET_POOL_RESERVE < count)
+		m_packet_pool_statistics.alloc_failed++;
+	else
+	{
+		while (count--)                                              //Built from the last one, which ends the chain.
+		{
+			packet_buf_t * p_buf = &m_packet_pool[m_packet_free[--m_packet_free_count]];
+			p_buf->ref_count = 1;
+			p_buf->p_next = p_first;
+			p_buf->offset = headroom;
+			p_buf->length = 0;
+			p_first = p_buf;
+		}
+		if (m_packet_free_count < m_packet_pool_statistics.min_free)
+			m_packet_pool_statistics.min_free = m_packet_free_count;
+	}
+	sd_nvic_critical_region_exit(nested);
+	return p_first;
+}
+
+/**@brief The func for releasing a reference to every buffer of a chain.
+* @param[in]   packet_buf_t*   p_buf  The first buffer, NULL is ignored.
+*/
+void packet_chain_release(packet_buf_t * p_buf)
+{
+	while (NULL != p_buf)
+	{
+		packet_buf_t * p_next = p_buf->p_next;                       //Before the buffer may go back to the pool.
+		packet_buf_release(p_buf);
+		p_buf = p_next;
+	}
+}
+
+/**@brief The func for taking one more reference to a buffer.
+* @param[in]   packet_buf_t*   p_buf  The buffer, which the caller holds a reference to.
+*/
+void packet_buf_retain(packet_buf_t * p_buf)
+{
+	uint8_t nested = 0;
+	sd_nvic_critical_region_enter(&nested);
+	p_buf->ref_count++;
+	sd_nvic_critical_region_exit(nested);
+}
+
+/**@brief The func for releasing a reference, the last one gives the buffer back to the pool.
+* @param[in]   packet_buf_t*   p_buf  The buffer, NULL is ignored.
+*/
+void packet_buf_release(packet_buf_t * p_buf)
+{
+	uint8_t nested = 0;
+	if (NULL == p_buf)
+		return;
+	sd_nvic_critical_region_enter(&nested);
+	if (0 == --p_buf->ref_count)
+		m_packet_free[m_packet_free_count++] = (uint8_t)(p_buf - m_packet_pool);
+	sd_nvic_critical_region_exit(nested);
+}
+
+/**@brief The func for prepending bytes to the packet, from the headroom.
+* @param[in]   packet_buf_t*   p_buf   The buffer.
+* @param[in]   uint16_t        length  The number of bytes.
+* @return Pointer to the bytes prepended, now the beginning of the packet, NULL if the headroom is too short.
+*/
+uint8_t * packet_buf_push(packet_buf_t * p_buf, uint16_t length)
+{
+	if (length > p_buf->offset)
+		return NULL;
+	p_buf->offset -= length;
+	p_buf->length += length;
+	return &p_buf->data[p_buf->offset];
+}
+
+/**@brief The func for appending bytes to the packet.
+* @param[in]   packet_buf_t*   p_buf   The buffer.
+* @param[in]   uint16_t        length  The number of bytes.
+* @return Pointer to the bytes appended, NULL if the buffer is too short.
+*/
+uint8_t * packet_buf_put(packet_buf_t * p_buf, uint16_t length)
+{
+	uint16_t end = p_buf->offset + p_buf->length;
+	if (length > PACKET_BUF_SIZE - end)
+		return NULL;
+	p_buf->length += length;
+	return &p_buf->data[end];
+}
+
+/**@brief The func for appending bytes to a chained packet, on to the next buffer when one is full.
+* @param[in/out] packet_buf_t**  pp_buf  The buffer being filled, the one filled by the last byte on return.
+* @param[in]     uint8_t*        p_data  The bytes.
+* @param[in]     uint16_t        length  The number of bytes.
+* @return The number of bytes appended, less than length if the chain is full.
+*/
+uint16_t packet_chain_put(packet_buf_t ** pp_buf, const uint8_t * p_data, uint16_t length)
+{
+	uint16_t done = 0;
+	while (done < length && NULL != *pp_buf)
+	{
+		packet_buf_t * p_buf = *pp_buf;
+		uint16_t room = PACKET_BUF_SIZE - p_buf->offset - p_buf->length;
+		if (0 == room)
+		{
+			*pp_buf = p_buf->p_next;
+			continue;
+		}
+		if (room > length - done)
+			room = length - done;
+		memcpy(packet_buf_put(p_buf, room), &p_data[done], room);
+		done += room;
+	}
+	return done;
+}
+
+/**@brief The func for getting the statistics of the packet buffer pool.
+* @param[out]  p_statistics  The pointer to the statistics.
+*/
+void get_packet_pool_statistics(packet_pool_statistics_t * p_statistics)
+{
+	uint8_t nested = 0;
+	sd_nvic_critical_region_enter(&nested);
+	*p_statistics = m_packet_pool_statistics;
+	p_statistics->free = m_packet_free_count;
+	sd_nvic_critical_region_exit(nested);
+}
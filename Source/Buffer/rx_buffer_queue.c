@@ -2,58 +2,118 @@
  *
  */
 
+#include <string.h>
+#include <app_scheduler.h>
 #include <rx_buffer_queue.h>
-#include <application.h>
+#include <transport.h>
+
+//The packets waiting to be sent leave the reserve of the pool, the queue and an ACK must still find a buffer.
+typedef char rx_buffer_pool_size_check_t[(PACKET_POOL_RESERVE >= RX_BUFFER_QUEUE_LENGTH + 1) ? 1 : -1];
 
 static rx_buffer_queue_t   m_rx_buffer_queue;        //The record Struct of RX buffer queue.
+static rx_buffer_queue_statistics_t   m_rx_buffer_statistics;
+static volatile bool       m_rx_buffer_scheduled;    //rx_buffer_queue_evt_schedule() waits in the scheduler.
 
-static bool IsRxBufferQueueEmypt(rx_buffer_queue_t  rx_buffer_queue) 
+/**@brief The number of packets in the queue, the indexes run free so the difference works after the wrap.
+*/
+static __INLINE uint8_t RxBufferQueueDepth(void)
 {
-	if(rx_buffer_queue.read_index == rx_buffer_queue.write_index)
-		return true;
-	else
-		return false;
+	return (uint8_t)(m_rx_buffer_queue.write_index - m_rx_buffer_queue.read_index);
 }
 
 /**@brief <Created by @Mida 2015-6-2>
 * The func for initializing RX buffer queue and add the Rx buffer queue Event to the Schedule. 
-* @param[in]   rx_buffer_elem_t*   p_buffer  The pointer to the RX buffer elements.
+* @note The packet pool is initialized before.
 */
-void init_rx_buffer_queue_evt(rx_buffer_elem_t * p_buffer)
+void init_rx_buffer_queue_evt(void)
 {
-	m_rx_buffer_queue.p_buffer = p_buffer;
 	m_rx_buffer_queue.read_index = 0;
 	m_rx_buffer_queue.write_index = 0;	
+	memset(&m_rx_buffer_statistics, 0, sizeof(m_rx_buffer_statistics));
+	m_rx_buffer_scheduled = false;
+}
+
+/**@brief Put rx_buffer_queue_evt_schedule() to the scheduler, unless it waits there already.
+*/
+static void RxBufferQueueSchedule(void)
+{
+	if (!m_rx_buffer_scheduled && NRF_SUCCESS == app_sched_event_put(NULL, 0, rx_buffer_queue_evt_schedule))
+		m_rx_buffer_scheduled = true;
 }
 
 /**@brief <Created by @Mida 2015-6-2> 
 * The schedule func of checking RX buffer queue. 
+* @note Drains the packets queued when called, RX_BUFFER_QUEUE_BATCH at most, so that a burst of 
+*       sub-packets does not wait one main loop pass each.
+* @note A packet the TCL returns TCL_WAIT for stays in its slot and the ones behind it still go, the ACKs
+*       must not wait for the AL. rx_buffer_queue_resume() passes the kept ones again, in order.
+* @param[in]   p_event_data  Not used.
+* @param[in]   event_size    Not used.
 */
-void rx_buffer_queue_evt_schedule(void)
+void rx_buffer_queue_evt_schedule(void * p_event_data, uint16_t event_size)
 {
-	if(!IsRxBufferQueueEmypt(m_rx_buffer_queue))
+	m_rx_buffer_scheduled = false;                                     //Before the write index, a packet added from now on schedules again.
+	uint8_t end = m_rx_buffer_queue.write_index;
+	uint8_t index = m_rx_buffer_queue.read_index;
+	uint8_t count = RX_BUFFER_QUEUE_BATCH;
+	__DMB();                                                           //Read the packets after the write index which tells they are there.
+	for (; index != end && 0 != count; index++)
 	{		
-		m_rx_buffer_queue.read_index &= ROTATION_MASK ;         //The '&' operation to make sure that the queue is rotation.
-		uint8_t pos = m_rx_buffer_queue.read_index; 
-		uint32_t err_code = al_recv_packet(m_rx_buffer_queue.p_buffer[pos].rx_buffer, m_rx_buffer_queue.p_buffer[pos].length);
-		m_rx_buffer_queue.read_index ++;                                      //The data was taken,read index pointer to next one.	
+		packet_buf_t ** pp_buf = &m_rx_buffer_queue.p_buffer[index & ROTATION_MASK];    //The '&' operation to make sure that the queue is rotation.
+		if (NULL == *pp_buf)
+			continue;                                                  //Taken in a pass before, behind a kept one.
+		if (TCL_WAIT == tcl_recv_packet(packet_buf_data(*pp_buf), (*pp_buf)->length))    //The TCL passes the whole packet to the AL.
+			continue;                                                  //Kept, the TCL takes it after rx_buffer_queue_resume().
+		packet_buf_release(*pp_buf);
+		*pp_buf = NULL;
+		count--;
 	}		
+	__DMB();                                                           //Done with the slots before giving them back.
+	while (m_rx_buffer_queue.read_index != end && NULL == m_rx_buffer_queue.p_buffer[m_rx_buffer_queue.read_index & ROTATION_MASK])
+		m_rx_buffer_queue.read_index ++;                               //The data was taken,read index pointer to next one.	
+	if (index != end)
+		RxBufferQueueSchedule();                                       //More than a batch, let the other events run first.
+}
+
+/**@brief The func for passing again the packets the TCL could not take, on the TCL tick.
+*/
+void rx_buffer_queue_resume(void)
+{
+	if (0 != RxBufferQueueDepth())
+		RxBufferQueueSchedule();
 }
 
 /**@brief <Created by @Mida 2015-6-2>
 * The func for adding One RX buffer to the buffer queue. 
+* @note Called from the BLE event only. A packet is dropped rather than overwriting one not read yet,
+*       or when the packet pool is empty, the TCL sends it again.
 * @param[in]   uint8_t*   p_data  	The pointer to the rx buffer data.
 * @param[in]   uint16_t   length    The length of data.
+* @return NRF_SUCCESS, NRF_ERROR_NO_MEM if the queue or the pool is full or NRF_ERROR_INVALID_LENGTH if the packet is too long.
 */
-void add_rx_buffer_to_queue(uint8_t* p_data,uint16_t length)
+uint32_t add_rx_buffer_to_queue(uint8_t* p_data,uint16_t length)
 {
-	uint16_t i;
-	m_rx_buffer_queue.write_index &= ROTATION_MASK ;       //The '&' operation to make sure that the queue is rotation.
-	uint8_t pos =  m_rx_buffer_queue.write_index;
-	for(i = 0 ;i < length ; i++)
-		m_rx_buffer_queue.p_buffer[pos].rx_buffer[i] = p_data[i];
-	m_rx_buffer_queue.p_buffer[pos].length = length;
+	if (length > BLE_UART_CHAR_BUFFER_SIZE)
+	{
+		m_rx_buffer_statistics.dropped++;
+		return NRF_ERROR_INVALID_LENGTH;
+	}
+	uint8_t depth = RxBufferQueueDepth();
+	packet_buf_t * p_buf = (depth < RX_BUFFER_QUEUE_LENGTH) ? packet_buf_alloc(0) : NULL;
+	if (NULL == p_buf)
+	{
+		m_rx_buffer_statistics.dropped++;
+		return NRF_ERROR_NO_MEM;
+	}
+	memcpy(packet_buf_put(p_buf, length), p_data, length);           //The only copy, the write is gone after the BLE event.
+	m_rx_buffer_queue.p_buffer[m_rx_buffer_queue.write_index & ROTATION_MASK] = p_buf;    //The '&' operation to make sure that the queue is rotation.
+	__DMB();                                                           //The packet is stored before the main loop can see it.
 	m_rx_buffer_queue.write_index ++ ;																	//The data was stored,write index pointer to next one.		
+	m_rx_buffer_statistics.received++;
+	if (depth + 1 > m_rx_buffer_statistics.high_water)
+		m_rx_buffer_statistics.high_water = depth + 1;
+	RxBufferQueueSchedule();
+	return NRF_SUCCESS;
 }
 
 /**@brief <Created by @Mida 2015-6-2>
@@ -61,6 +121,20 @@ void add_rx_buffer_to_queue(uint8_t* p_data,uint16_t length)
 */
 void flush_rx_buffer_queue(void)
 {
-	m_rx_buffer_queue.read_index = m_rx_buffer_queue.write_index;
+	while (0 != RxBufferQueueDepth())
+	{
+		packet_buf_t * p_buf = m_rx_buffer_queue.p_buffer[m_rx_buffer_queue.read_index & ROTATION_MASK];
+		m_rx_buffer_queue.read_index ++;
+		if (NULL != p_buf)
+			packet_buf_release(p_buf);
+	}
 }
 
+/**@brief The func for getting the statistics of the RX buffer queue. 
+* @param[out]  p_statistics  The pointer to the statistics.
+*/
+void get_rx_buffer_queue_statistics(rx_buffer_queue_statistics_t * p_statistics)
+{
+	*p_statistics = m_rx_buffer_statistics;
+	p_statistics->depth = RxBufferQueueDepth();
+}
@@ -11,27 +11,65 @@
  */
 
 #include <application.h>
+#include <sensor_log.h>
+#include <calendar.h>
 #include <string.h>
 // The following environment is set and saved for one transmission.
 // {
 #define PAY_LOAD_MAX_LENGTH  8
+#define AL_BATTERY_CAPACITY  100 				// No fuel gauge on the board, reported as full.
+#define AL_RT_DATA_KV_NUMBER 8 					// Key-values answering AL_KEY_RT_DATA_ALL.
+
+// The value of AL_KEY_SETTING_TIME is read from the receive buffer as a CalenderTime.
+typedef char al_calender_time_size_check_t[(sizeof(CalenderTime) <= PAY_LOAD_MAX_LENGTH) ? 1 : -1];
 
 static al_send_status_t		m_al_send_status;
-static al_packet_t				m_al_send_packet; 					// Data packet to sent.
 static al_data_t					m_al_recv_data; 						// The recv data packet .
+static uint8_t            m_al_correlation_id = AL_CORRELATION_ID_NONE;	// Of the request being processed, echoed in the replies.
 static uint8_t            m_al_recv_value[8];					// The recv value .
 static uint8_t        		execute_status_vaule[2];   	//The value of execute status.
-static uint8_t            purify_status = 0;							//The value of purify status.
+static uint8_t            purify_status = AL_KEY_CONTROL_PURIFY_OPEN;	//The value of purify status, InitFan() opens the fan.
+static uint8_t            battery_capacity = AL_BATTERY_CAPACITY;	//The value of battery capacity.
 static SensorData 				m_al_sensor;                //The data of sensor 	        //Copy from main.c Line:88     <Modified by @Mida 2015-6-21>
+static bool               m_rt_subscribed = false;    //Push the real-time data on change.
+static uint16_t           m_rt_heartbeat = AL_RT_PUSH_HEARTBEAT;
+static SensorData         m_rt_pushed;                //The data pushed last.
+static uint8_t            m_rt_pushed_fan;
+static uint8_t            m_rt_pushed_purify;
+static uint32_t           m_rt_pushed_time;           //uint(s) of GetCalendarUptime().
+static bool               m_rt_push_pending;          //A push is queued or on the way.
 		// }
 
-static ble_send_handler_t			al_ble_send_handler;
+// The transmit queue, one ring per priority class. The packet on the way stays at the head of its ring.
+// {
+typedef struct al_tx_item_s
+{
+	packet_buf_t*				p_packet; // The AL packet, in a chain of buffers of the packet pool.
+	uint16_t					length; // Length of the AL packet.
+	uint8_t						priority;
+	uint8_t						resend; // Times sent again.
+	al_send_complete_handler_t	complete_handler;
+	void*						p_context;
+} al_tx_item_t;
+
+static al_tx_item_t			m_al_tx_queue[AL_PRIORITY_COUNT][AL_TX_QUEUE_LENGTH];
+static uint8_t				m_al_tx_read[AL_PRIORITY_COUNT]; // Free running, masked by AL_TX_QUEUE_MASK on access.
+static uint8_t				m_al_tx_write[AL_PRIORITY_COUNT];
+static al_tx_item_t*		m_p_al_tx_item; // The packet on the way, NULL if none.
+static bool					m_al_tx_running; // al_tx_kick() is on the stack, the TCL may call back into it.
+static bool					m_al_tx_deferred; // The TCL refused the head packet on the spot, sent again by al_tx_resume().
+static packet_buf_t*		m_p_al_tx_reply; // Buffer kept for the reply of the key-value being executed, NULL if none.
+static uint16_t				m_al_recv_resume; // Key-value to start from when the TCL passes again the packet which waited.
+// }
+
+static tcl_send_handler_t			al_tcl_send_handler;
 // The following handler is for processing the packet.
 // {
 static al_process_handler_t al_process_dfu_handler; // Function for processing DFU packet.
 static al_process_handler_t al_process_settting_handler; // Function for processing Setting packet.
 static al_process_handler_t al_process_control_handler; // Function for processing Control packet.
 static al_process_handler_t al_process_rt_monitor_handler; // Function for sending the real-time monitor data.
+static al_process_handler_t al_process_ol_data_handler; // Function for reading the off-line data.
 static al_process_handler_t al_process_status_handler; // Function for processing Status packet.
 static al_process_handler_t al_process_test_handler; // Function for processing Test packet.
 static al_process_handler_t al_process_log_handler; // Function for processing Log packet.
@@ -46,96 +84,119 @@ al_send_status_t al_send_status(void)
 	return m_al_send_status;
 }
 
-/**@brief Function for handling situation of failing to send packet.
+/**@brief Function for getting the number of packets in the queue of a priority class.
  *
- * @note You can do more jobs when AL is noticed when failed to send packet. For example, 
- *		 send the previous packet again and the maximum of times for resending.
+ * @param[in]   priority  	Priority class.
  */
-void al_send_failed()
+static uint8_t al_tx_depth(uint8_t priority)
 {
-	m_al_send_status = AL_SEND_STATUS_FAILED;
+	return (uint8_t)(m_al_tx_write[priority] - m_al_tx_read[priority]);
 }
 
-/**@brief Function for handling situation of successffuly sending packet.
+/**@brief Function for passing the queued packets to the TCL, the highest priority class first.
  *
+ * @note The TCL may finish a short packet before returning, which calls al_tx_kick() again through 
+ *		 al_send_success(). That call returns at once and the loop here takes the next packet.
+ * @note A packet the TCL fails before returning, the notification queue being full, is not sent again
+ *		 at once. It waits for al_tx_resume(), the next TCL tick.
  */
-void al_send_success(void)
+static void al_tx_kick(void)
 {
-	m_al_send_status = AL_SEND_STATUS_SUCCESS;
+	if (m_al_tx_running)
+		return;
+	m_al_tx_running = true;
+	while (NULL == m_p_al_tx_item && !m_al_tx_deferred) {
+		uint8_t priority = 0;
+		while (priority < AL_PRIORITY_COUNT && 0 == al_tx_depth(priority))
+			++priority;
+		if (AL_PRIORITY_COUNT == priority)
+			break; // Nothing to send.
+		al_tx_item_t* p_item = &m_al_tx_queue[priority][m_al_tx_read[priority] & AL_TX_QUEUE_MASK];
+		m_p_al_tx_item = p_item;
+		m_al_send_status = AL_SEND_STATUS_SENDING;      // Till the TCL calls al_send_success() or al_send_failed().
+		uint32_t err_code = al_tcl_send_handler(p_item->p_packet, p_item->length);
+		if (AL_SUCCESS != err_code && p_item == m_p_al_tx_item)
+			al_send_failed();      // The TCL refused the packet without noticing the AL.
+	}
+	m_al_tx_running = false;
 }
 
-/**@brief Function for calculate the checksum of the packet.
+/**@brief Function for finishing the packet on the way.
  *
- * @param[in]   p_packet		Pointer to the TCL packet.
- * @param[in]   length			Pointer to the TCL packet.
+ * @note A failed packet stays at the head of its queue and is sent again, AL_RESEND_MAX_COUNT times at most.
  *
- * @return Checksum of the packet.
+ * @param[in]   status  	AL_SEND_STATUS_SUCCESS or AL_SEND_STATUS_FAILED.
  */
-static uint16_t checksum(uint16_t* p_data, uint16_t length)
+static void al_tx_complete(al_send_status_t status)
 {
-	uint16_t ret = 0;
-	/*********<Modify by Mida>***************/
-	if((length%2)!=0)               
-		length += 1;
-	/*********<Modify by Mida>***************/
-	length /= 2;
-	for (uint16_t i = 0; i < length; ++i)
-		ret += p_data[i];
-	return ~ret;
+	al_tx_item_t* p_item = m_p_al_tx_item;
+	m_al_send_status = status;
+	if (NULL == p_item)
+		return;
+	m_p_al_tx_item = NULL;
+	if (AL_SEND_STATUS_FAILED == status && p_item->resend < AL_RESEND_MAX_COUNT) {
+		p_item->resend++;
+		m_al_tx_deferred = m_al_tx_running;      // Failed inside al_tcl_send_handler(), trying again now fails too.
+	} else {
+		al_send_complete_handler_t complete_handler = p_item->complete_handler;
+		void* p_context = p_item->p_context;
+		packet_chain_release(p_item->p_packet);      // The TCL holds its own references to the sub-packets still queued.
+		m_al_tx_read[p_item->priority]++;      // The slot may be reused by the handler.
+		if (NULL != complete_handler)
+			complete_handler(p_context, status);
+	}
+	al_tx_kick();
 }
 
-/**@brief Function for loading the checksum of sub-packet.
+/**@brief Function for sending again a packet the TCL refused on the spot.
  *
- * @param[in]   length  		Real length of the packet.
+ * @note Called on every TCL tick, the notification queue has drained since.
  */
-static void al_load_packet_checksum(uint16_t length)
+void al_tx_resume(void)
 {
-	m_al_send_packet.packet_header.check_sum = checksum((uint16_t*)&m_al_send_packet, length);
+	m_al_tx_deferred = false;
+	al_tx_kick();
 }
 
-/**@brief Function for checking the packet whether is a variable packet for this protocol.
+/**@brief Function for checking whether a packet waits for al_tx_resume().
  *
- * @note This function will check the magic number, the version and the checksum
+ * @return true if the TCL refused the head packet and it waits for the next TCL tick.
+ */
+bool al_tx_is_deferred(void)
+{
+	return m_al_tx_deferred;
+}
+
+/**@brief Function for handling situation of failing to send packet.
  *
- * @param[in]   p_data  		Pointer to the data buffer.
- * @param[in]   length  		Length of the data.
+ * @note The packet is sent again, AL_RESEND_MAX_COUNT times at most, before its handler is noticed.
+ */
+void al_send_failed()
+{
+	al_tx_complete(AL_SEND_STATUS_FAILED);
+}
+
+/**@brief Function for handling situation of successffuly sending packet.
  *
- * @return @ref AL_SUCCESS					The packet is valid.
- * @return @ref Al_ERROR_MAGIC_NUMBER		The magic number is wrong.
- * @return @ref AL_ERROR_VERSION			The version is wrong.
- * @return @ref AL_ERROR_CHECK_SUM			The checksum is wrong.
  */
-static uint32_t al_check_recv_packet(uint8_t* p_data, uint16_t length)
+void al_send_success(void)
 {
-	al_packet_t* p_packet = (al_packet_t*)p_data;
-	if (PACKET_HEADER_MAGIC_NUMBER != p_packet->packet_header.magic_number) {
-		return AL_ERROR_MAGIC_NUMBER;
-	}
-	if (PACKET_HEADER_VERSION != p_packet->packet_header.version) {
-		return AL_ERROR_VERSION;
-	}
-	if (0x0000 != checksum((uint16_t*)p_data, length)) {
-		return AL_ERROR_CHECK_SUM;
-	}
-	return AL_SUCCESS;
+	al_tx_complete(AL_SEND_STATUS_SUCCESS);
 }
 
 /**@brief Function for loading the Values to al_data_t.
  *<Modify by Mida>
  * @note The AL will copy the data pointing by pointer of every key-value in the array.
  *
+ * @param[in]   p_payload  	The buffer of the chain holding the end of the packet, the key-values are appended.
  * @param[in]   p_kv  		Pointer to the array of send key-value
  */
-static void al_load_k_value(al_data_t* p_kv)
+static void al_load_k_value(packet_buf_t* p_payload, al_data_t* p_kv, uint8_t kv_number)
 {
-	uint8_t index = 0;
-	m_al_send_packet.payload[(index)++] = p_kv->key_id;
-	m_al_send_packet.payload[(index)++] = p_kv->key_length;
-	for (uint32_t i = 0; i < p_kv->key_length; ++i) {
-		m_al_send_packet.payload[(index)++] = p_kv->p_value[i];
-	}
-	for (uint32_t i = p_kv->key_length; i < PAY_LOAD_MAX_LENGTH; ++i) {
-		m_al_send_packet.payload[(index)++] = 0;
+	for (uint8_t n = 0; n < kv_number; ++n) {
+		packet_chain_put(&p_payload, &p_kv[n].key_id, 1);
+		packet_chain_put(&p_payload, &p_kv[n].key_length, 1);
+		packet_chain_put(&p_payload, p_kv[n].p_value, p_kv[n].key_length);
 	}
 }
 
@@ -148,15 +209,19 @@ static void al_load_k_value(al_data_t* p_kv)
  *
  * @return Total length of AL payload.
  */
-static uint16_t al_calc_payload_length(al_data_t p_kv)
+static uint16_t al_calc_payload_length(al_data_t* p_kv, uint8_t kv_number)
 {
 	uint16_t length = 0;
-		length += AL_KEY_HEADER_LENGTH + p_kv.key_length;
+	for (uint8_t n = 0; n < kv_number; ++n)
+		length += AL_KEY_HEADER_LENGTH + p_kv[n].key_length;
 	return length;
 }
 
 /*@brief Function for download the key-value from received packet.
  *<Modify by Mida>
+ * @note A value longer than the receive buffer is cut, al_recv_packet() passes only the key-values
+ *		 which fit PAY_LOAD_MAX_LENGTH.
+ *
  * @param[in]   p_data  		Pointer to the data received.
  */
 static void al_download_payload(uint8_t* p_data)
@@ -165,27 +230,72 @@ static void al_download_payload(uint8_t* p_data)
 	uint8_t index = 0;
 	p_kv->key_id = p_data[(index)++];
 	p_kv->key_length = p_data[(index)++];
+	if (p_kv->key_length > PAY_LOAD_MAX_LENGTH)
+		p_kv->key_length = PAY_LOAD_MAX_LENGTH;
 	for (uint8_t i = 0; i < p_kv->key_length; ++i) 
 	{
 		p_kv->p_value[i] = p_data[(index)++];
 	}
 }
 
-/*@brief Function for download the key-value from received packet.
- *<Modify by Mida>
- * @param[in]   p_data  		Pointer to the data received.
+/**@brief Function for queuing packet to send to Phone through TCL.
+ *
+ * @note The AL will copy the data pointing by pointer of every key-value in the array.
+ * @note The handler is called once the TCL sent the packet, or failed it AL_RESEND_MAX_COUNT more times.
+ * @note Queued while a request is processed, the packet is a reply and echoes the correlation id of the request.
+ * @note The packet is built in a chain of buffers of the packet pool, one sub-packet of the TCL in each, with
+ *		 the headroom for the TCL header. The TCL sends it in place, the buffers are released when it is done.
+ *
+ * @param[in]   command_id  		Command ID.
+ * @param[in]   p_kv  				Pointer to the array of key-value.
+ * @param[in]   kv_number  			Array number.
+ * @param[in]   priority  			Priority class of the packet.
+ * @param[in]   complete_handler	Function called when the packet is done, may be NULL.
+ * @param[in]   p_context  			Passed to the handler.
+ *
+ * @return @ref AL_SUCCESS				Successfully queued the packet.
+ * @return @ref AL_WAIT					The queue of the priority class, or the packet pool, is full. Just wait and send again.
+ * @return @ref AL_ERROR_DATA_SIZE		Exceed AL_TX_PAYLOAD_MTU.
  */
-static void al_set_header(al_data_t p_kv)
+uint32_t al_queue_packet(uint8_t command_id, al_data_t* p_kv, uint8_t kv_number, al_priority_t priority,
+						 al_send_complete_handler_t complete_handler, void* p_context)
 {
-	m_al_send_packet.packet_header.magic_number 		= PACKET_HEADER_MAGIC_NUMBER;
-	m_al_send_packet.packet_header.version 					= PACKET_HEADER_VERSION	;
-	m_al_send_packet.packet_header.payload_length 	= al_calc_payload_length(p_kv) + AL_HEADER_LENGTH;
-	m_al_send_packet.packet_header.sequence_id   		= 0x00;
-	m_al_send_packet.packet_header.flag							= 0x00;
-	m_al_send_packet.packet_header.check_sum				= 0x0000;
+	uint16_t payload_length = al_calc_payload_length(p_kv, kv_number);
+	if (payload_length > AL_TX_PAYLOAD_MTU)
+		return AL_ERROR_DATA_SIZE;
+	if (priority >= AL_PRIORITY_COUNT)
+		priority = AL_PRIORITY_LOW;
+	if (AL_TX_QUEUE_LENGTH == al_tx_depth(priority))
+		return AL_WAIT;
+	uint16_t length = payload_length + AL_HEADER_LENGTH;     //The total length of packet
+	packet_buf_t* p_packet = m_p_al_tx_reply;
+	if (NULL != p_packet && length <= BLE_UART_PAYLOAD_MTU)
+		m_p_al_tx_reply = NULL;       // The reply of the key-value being executed takes the buffer kept for it.
+	else
+		p_packet = packet_chain_alloc(TCL_CALC_SUB_PACKET_NUMBER(length), TCL_HEADER_LENGTH);
+	if (NULL == p_packet)
+		return AL_WAIT;       // The packets on the way give their buffers back.
+
+	al_tx_item_t* p_item = &m_al_tx_queue[priority][m_al_tx_write[priority] & AL_TX_QUEUE_MASK];
+	al_header_t al_header;
+	al_header.command_id = command_id;
+	al_header.correlation_id = m_al_correlation_id;
+	al_header.payload_length = payload_length;
+	p_item->p_packet = p_packet;
+	packet_chain_put(&p_packet, (uint8_t*)&al_header, AL_HEADER_LENGTH);
+	al_load_k_value(p_packet, p_kv, kv_number);
+	p_item->length = length;
+	p_item->priority = priority;
+	p_item->resend = 0;
+	p_item->complete_handler = complete_handler;
+	p_item->p_context = p_context;
+	m_al_tx_write[priority]++;
+
+	al_tx_kick();
+	return AL_SUCCESS;
 }
 
-/**@brief Function for sending packet to Phone through TCL.
+/**@brief Function for sending packet to Phone through TCL, with low priority and no handler.
  *
  * @note The AL will copy the data pointing by pointer of every key-value in the array.
  *
@@ -197,25 +307,41 @@ static void al_set_header(al_data_t p_kv)
  * @return @ref AL_ERROR				Common failed.
  * @return @ref AL_ERROR_DATA_SIZE		Exceed the limit of data size..
  */
-uint32_t al_send_packet(uint8_t command_id, al_data_t* p_kv)
+uint32_t al_send_packet(uint8_t command_id, al_data_t* p_kv, uint8_t kv_number)
 {
-	if (AL_SEND_STATUS_SENDING == al_send_status())        
-		return AL_WAIT;
-	m_al_send_status = AL_SEND_STATUS_SENDING;
-	
-	al_set_header(*p_kv);
-	uint16_t payload_length = al_calc_payload_length(*p_kv);
-	if (payload_length > AL_PAYLOAD_MTU)
-		return AL_ERROR_DATA_SIZE;
-		
-	m_al_send_packet.al_header.command_id = command_id;
-	m_al_send_packet.al_header.payload_length = payload_length;
-	
-	al_load_k_value(p_kv);
+	return al_queue_packet(command_id, p_kv, kv_number, AL_PRIORITY_LOW, NULL, NULL);
+}
 
-	uint16_t length = payload_length + PACKET_HEADER_LENGTH + AL_HEADER_LENGTH;     //The total length of packet
-	al_load_packet_checksum(length);																								//Add the checksum of packet
-	return al_ble_send_handler((uint8_t*)&m_al_send_packet, length);
+/**@brief Function for failing the queued packets, when the link is gone.
+ *
+ * @note Call it before tcl_reset(), which fails the packet on the way. No packet is sent again.
+ *		 The handlers are called after the queues are emptied, they may queue packets for the next link.
+ */
+void al_reset(void)
+{
+	al_send_complete_handler_t complete_handlers[AL_PRIORITY_COUNT * AL_TX_QUEUE_LENGTH];
+	void* p_contexts[AL_PRIORITY_COUNT * AL_TX_QUEUE_LENGTH];
+	uint8_t count = 0;
+	for (uint8_t priority = 0; priority < AL_PRIORITY_COUNT; ++priority) {
+		uint8_t keep = m_al_tx_read[priority];
+		if (NULL != m_p_al_tx_item && m_p_al_tx_item->priority == priority) {
+			m_p_al_tx_item->resend = AL_RESEND_MAX_COUNT;      // Stays at the head till tcl_reset() fails it, not sent again.
+			++keep;
+		}
+		for (uint8_t index = keep; index != m_al_tx_write[priority]; ++index) {
+			al_tx_item_t* p_item = &m_al_tx_queue[priority][index & AL_TX_QUEUE_MASK];
+			packet_chain_release(p_item->p_packet);
+			complete_handlers[count] = p_item->complete_handler;
+			p_contexts[count++] = p_item->p_context;
+		}
+		m_al_tx_write[priority] = keep;
+	}
+	m_al_tx_deferred = false;      // The head packet it was for is gone.
+	m_al_recv_resume = 0;      // So is the packet waiting in the TCL.
+	for (uint8_t i = 0; i < count; ++i) {
+		if (NULL != complete_handlers[i])
+			complete_handlers[i](p_contexts[i], AL_SEND_STATUS_FAILED);
+	}
 }
 
 /**@brief Function for sending status of executing to Phone through TCL.
@@ -236,7 +362,7 @@ static uint32_t al_send_execute_status_packet(bool is_success, uint8_t* p_commen
 	comment.key_id = is_success ? AL_KEY_EXE_STAT_SUCCUSS : AL_KEY_EXE_STAT_FAILED;
 	comment.p_value = p_comment;
 	comment.key_length = comment_length;
-	return al_send_packet(AL_COMMAND_EXE_STAT, &comment);
+	return al_queue_packet(AL_COMMAND_EXE_STAT, &comment, 1, AL_PRIORITY_HIGH, NULL, NULL);
 }
 
 /**@brief Function for sending real-time of monitoring data to Phone through TCL.
@@ -257,7 +383,49 @@ static uint32_t al_send_rt_monitor_packet(uint8_t key_id, uint8_t* p_comment, ui
 	comment.key_id = key_id;
 	comment.key_length = comment_length;
 	comment.p_value = p_comment;
-	return al_send_packet(AL_COMMAND_RT_DATA, &comment);
+	return al_send_packet(AL_COMMAND_RT_DATA, &comment, 1);
+}
+
+/**@brief Function for sending one key of off-line data to Phone through TCL.
+ *
+ * @param[in]   key_id  			The key ID.
+ * @param[in]   p_comment  	  Pointer to the key-value's p_value of sending.
+ * @param[in]   comment_length  	The length of key-value's p_value.
+ *
+ */
+static uint32_t al_send_ol_data_packet(uint8_t key_id, uint8_t* p_comment, uint8_t comment_length)
+{
+	al_data_t comment;
+	comment.key_id = key_id;
+	comment.key_length = comment_length;
+	comment.p_value = p_comment;
+	return al_send_packet(AL_COMMAND_OL_DATA, &comment, 1);
+}
+
+/**@brief Function for sending all real-time data to Phone in one packet.
+ *
+ * @note Answers AL_KEY_RT_DATA_ALL with the keys AL_KEY_RT_DATA_PM25 to AL_KEY_RT_DATA_BATT, 
+ *		 which saves the phone a round trip for each, and AL_KEY_RT_DATA_TIME, when the sensors were read.
+ *
+ * @param[in]   complete_handler	Function called when the packet is done, may be NULL.
+ */
+static uint32_t al_send_rt_data_all_packet(al_send_complete_handler_t complete_handler)
+{
+	static uint8_t fan_duty_cycle;
+	static uint32_t sample_time;
+	al_data_t kv[AL_RT_DATA_KV_NUMBER] = {
+		{AL_KEY_RT_DATA_PM25,	4, (uint8_t *)&m_al_sensor.pm2_5},
+		{AL_KEY_RT_DATA_TVOC,	4, (uint8_t *)&m_al_sensor.tvoc},
+		{AL_KEY_RT_DATA_TEMP,	4, (uint8_t *)&m_al_sensor.temperature},
+		{AL_KEY_RT_DATA_HUMI,	4, (uint8_t *)&m_al_sensor.humidity},
+		{AL_KEY_RT_DATA_FAN,	1, &fan_duty_cycle},
+		{AL_KEY_RT_DATA_PURIFY,	1, &purify_status},
+		{AL_KEY_RT_DATA_BATT,	1, &battery_capacity},
+		{AL_KEY_RT_DATA_TIME,	4, (uint8_t *)&sample_time},
+	};
+	fan_duty_cycle = GetFanDutyCycle();
+	sample_time = CalenderTimeToSeconds(&m_al_sensor.local_rtc);
+	return al_queue_packet(AL_COMMAND_RT_DATA, kv, AL_RT_DATA_KV_NUMBER, AL_PRIORITY_LOW, complete_handler, NULL);
 }
 
 /**@brief Function for sending status of hardware to Phone through TCL.
@@ -278,65 +446,167 @@ static uint32_t al_send_status_packet(uint8_t key_id, uint8_t* p_comment, uint8_
 	comment.key_id = key_id;
 	comment.key_length = comment_length;
 	comment.p_value = p_comment;
-	return al_send_packet(AL_COMMAND_STATUS, &comment);
+	return al_queue_packet(AL_COMMAND_STATUS, &comment, 1, AL_PRIORITY_HIGH, NULL, NULL);
+}
+
+
+/**@brief Function for answering a packet or a key-value which could not be executed.
+ *
+ * @note Queued while the correlation id of the request is set, so the phone can match it.
+ *
+ * @param[in]   command_id  	Command ID of the request.
+ * @param[in]   key_id  		Key ID, @ref AL_EXE_STAT_KEY_NONE if the whole packet was rejected.
+ * @param[in]   reason  		The AL status code.
+ */
+static uint32_t al_send_rejected_packet(uint8_t command_id, uint8_t key_id, uint32_t reason)
+{
+	uint8_t comment[3] = {command_id, key_id, (uint8_t)reason};
+	return al_send_execute_status_packet(false, comment, sizeof(comment));
+}
+
+/**@brief Function for making sure a key-value can be answered before it is executed.
+ *
+ * @note A slot of the high priority class must be free, and a buffer is taken for the first packet queued
+ *		 from now on, the reply or the failed execute status. Only the main context queues packets, so the
+ *		 slot stays free. A key-value is not executed unless it can be answered.
+ *
+ * @return true if the reply can be queued.
+ */
+static bool al_tx_reserve_reply(void)
+{
+	if (AL_TX_QUEUE_LENGTH == al_tx_depth(AL_PRIORITY_HIGH))
+		return false;
+	if (NULL == m_p_al_tx_reply)
+		m_p_al_tx_reply = packet_chain_alloc(1, TCL_HEADER_LENGTH);
+	return NULL != m_p_al_tx_reply;
+}
+
+/**@brief Function for giving back the buffer kept for a reply, when the packet is done.
+ */
+static void al_tx_release_reply(void)
+{
+	packet_chain_release(m_p_al_tx_reply);
+	m_p_al_tx_reply = NULL;
 }
 
+/**@brief Function for getting the handler of a command.
+ *
+ * @param[in]   command_id  	Command ID.
+ *
+ * @return The handler, NULL if the command has none or is unknown.
+ */
+static al_process_handler_t al_command_handler(uint8_t command_id)
+{
+	switch(command_id) {
+	case AL_COMMAND_DFU:
+		return al_process_dfu_handler;
+	case AL_COMMAND_SETTING:
+		execute_status_vaule[0] = AL_COMMAND_SETTING;
+		return al_process_settting_handler;
+	case AL_COMMAND_CONTROL:
+		execute_status_vaule[0] = AL_COMMAND_CONTROL;
+		return al_process_control_handler;
+	case AL_COMMAND_RT_DATA:
+		execute_status_vaule[0] = AL_COMMAND_RT_DATA;
+		return al_process_rt_monitor_handler;
+	case AL_COMMAND_OL_DATA:
+		execute_status_vaule[0] = AL_COMMAND_OL_DATA;
+		return al_process_ol_data_handler;
+	case AL_COMMAND_STATUS:
+		return al_process_status_handler;
+	case AL_COMMAND_TEST:
+		return al_process_test_handler;
+	case AL_COMMAND_LOG:
+		return al_process_log_handler;
+	default:
+		return NULL;
+	}
+}
 
 /**@brief Function for receiving packet from Phone through TCL.
+ *
+ * @note The TCL has checked and reassembled the packet. Every key-value in the payload 
+ *		 is passed to the handler of the command in turn.
+ * @note The replies queued by the handlers echo the correlation id of the packet. They are queued
+ *		 before the next request is processed, so pipelined requests are answered in order.
+ * @note A rejected packet, or a key-value whose handler fails, is answered with a failed execute
+ *		 status of {command, key, reason}, which echoes the correlation id too.
+ * @note A key-value is executed only once its reply is sure to be queued, see al_tx_reserve_reply().
+ *		 Otherwise, or if a handler returns AL_WAIT, which it does before doing anything, the packet is left
+ *		 there. The TCL passes it again later and it goes on from that key-value.
  *
  * @param[in]   p_data  		Pointer to the data received.
  * @param[in]   length  		Length of the data.
  *
  * @return @ref AL_SUCCESS				Successfully sent the packet.
+ * @return @ref AL_WAIT					The transmit queue is full, pass the same packet again later.
  * @return @ref AL_ERROR				Common failed. 
+ * @return @ref AL_ERROR_DATA_SIZE		The payload does not match the length.
  * @return @ref AL_ERROR_COMMAND		The command id is wrong.
+ * @return @ref AL_ERROR_NO_HANDLER		The command has no handler.
  */
 uint32_t al_recv_packet(uint8_t* p_data, uint16_t length)
 {
-	uint32_t err_code = al_check_recv_packet(p_data, length);
-	if(AL_SUCCESS == err_code)
-	{
-		al_packet_t* p_packet =(al_packet_t*)p_data;
-		al_header_t al_header = p_packet->al_header;
-		uint32_t payload_length = al_header.payload_length;                       //The al payload_length
-		switch(al_header.command_id) {
-		case AL_COMMAND_DFU:
-			if (0 != al_process_dfu_handler)
-				return al_process_dfu_handler(p_packet->payload, payload_length);
-			break;
-		case AL_COMMAND_SETTING:
-			execute_status_vaule[0] = AL_COMMAND_SETTING;
-			if (0 != al_process_settting_handler)
-				return al_process_settting_handler(p_packet->payload, payload_length);
-			break;
-		case AL_COMMAND_CONTROL:
-			execute_status_vaule[0] = AL_COMMAND_CONTROL;
-			if (0 != al_process_control_handler)
-				return al_process_control_handler(p_packet->payload, payload_length);
-			break;
-		case AL_COMMAND_RT_DATA:
-			if (0 != al_process_rt_monitor_handler)
-				return al_process_rt_monitor_handler(p_packet->payload, payload_length);
-			break;
-		case AL_COMMAND_STATUS:
-			if (0 != al_process_status_handler)
-				return al_process_status_handler(p_packet->payload, payload_length);
+	al_packet_t* p_packet =(al_packet_t*)p_data;
+	al_header_t al_header = {0};
+	al_process_handler_t handler = NULL;
+	uint32_t ret = AL_SUCCESS;
+	uint16_t index = m_al_recv_resume;
+	m_al_recv_resume = 0;
+	if (!al_tx_reserve_reply()) {
+		m_al_recv_resume = index;
+		return AL_WAIT;
+	}
+	// The reassembly buffer of the TCL is bytes, payload_length may be unaligned. Even a short packet 
+	// may carry the command and the correlation id, to answer it with.
+	memcpy(&al_header, p_data, (length < AL_HEADER_LENGTH) ? length : AL_HEADER_LENGTH);
+	uint16_t payload_length = al_header.payload_length;                       //The al payload_length
+	m_al_correlation_id = al_header.correlation_id;
+	if (length < AL_HEADER_LENGTH || payload_length > length - AL_HEADER_LENGTH)
+		ret = AL_ERROR_DATA_SIZE;
+	else if (al_header.command_id > AL_COMMAND_LOG)
+		ret = AL_ERROR_COMMAND;
+	else if (NULL == (handler = al_command_handler(al_header.command_id)))
+		ret = AL_ERROR_NO_HANDLER;
+	if (AL_SUCCESS != ret) {
+		al_send_rejected_packet(al_header.command_id, AL_EXE_STAT_KEY_NONE, ret);
+		al_tx_release_reply();
+		m_al_correlation_id = AL_CORRELATION_ID_NONE;
+		return ret;
+	}
+
+	while (index + AL_KEY_HEADER_LENGTH <= payload_length) {
+		uint8_t key_id = p_packet->payload[index];
+		uint16_t kv_length = AL_KEY_HEADER_LENGTH + p_packet->payload[index + 1];
+		uint32_t err_code;
+		if (!al_tx_reserve_reply()) {
+			ret = AL_WAIT;
 			break;
-		case AL_COMMAND_TEST:
-			if (0 != al_process_test_handler)
-				return al_process_test_handler(p_packet->payload, payload_length);
+		}
+		if (index + kv_length > payload_length) {
+			ret = AL_ERROR_DATA_SIZE;
+			al_send_rejected_packet(al_header.command_id, key_id, ret);
 			break;
-		case AL_COMMAND_LOG:
-			if (0 != al_process_log_handler)
-				return al_process_log_handler(p_packet->payload, payload_length);
+		}
+		if (kv_length - AL_KEY_HEADER_LENGTH > PAY_LOAD_MAX_LENGTH)
+			err_code = AL_ERROR_DATA_SIZE;       // Skip it, the value does not fit the receive buffer.
+		else
+			err_code = handler(&p_packet->payload[index], kv_length);
+		if (AL_WAIT == err_code) {
+			ret = AL_WAIT;       // Nothing done, executed again when the packet is passed again.
 			break;
-		default:
-			return AL_ERROR_COMMAND;
 		}
-		return AL_ERROR_NO_HANDLER;
-	}else{
-		return AL_ERROR;
+		if (AL_SUCCESS != err_code) {
+			ret = err_code;
+			al_send_rejected_packet(al_header.command_id, key_id, err_code);
+		}
+		index += kv_length;
 	}
+	if (AL_WAIT == ret)
+		m_al_recv_resume = index;
+	al_tx_release_reply();
+	m_al_correlation_id = AL_CORRELATION_ID_NONE;       // The packets queued from now on are not replies.
+	return ret;
 }
 
 
@@ -347,11 +617,12 @@ uint32_t al_recv_packet(uint8_t* p_data, uint16_t length)
  */
 void al_init(al_init_t* p_init)
 {
-	al_ble_send_handler    = p_init->ble_send_hander; // Function for sending packet.
+	al_tcl_send_handler    = p_init->tcl_send_handler; // Function for sending packet.
 	al_process_dfu_handler = p_init->dfu_handler; // Function for processing DFU packet.
 	al_process_settting_handler = p_init->settting_handler; // Function for processing Setting packet.
 	al_process_control_handler = p_init->control_handler; // Function for processing Control packet.
 	al_process_rt_monitor_handler = p_init->real_time_monitor_handler; // Function for sending the real-time monitor data.
+	al_process_ol_data_handler = p_init->ol_data_handler; // Function for reading the off-line data.
 	al_process_status_handler = p_init->status_handler; // Function for processing Status packet.
 	al_process_test_handler = p_init->test_handler; // Function for processing Test packet.
 	al_process_log_handler = p_init->log_handler; // Function for processing Log packet.
@@ -359,6 +630,75 @@ void al_init(al_init_t* p_init)
 	GetSensorData(&m_al_sensor);                  //<Add by @Mida 2015-6-22>Get the sensor data. 
 }
 
+/*@brief Function for checking whether a value moved out of the deadband.
+ */
+static bool al_rt_out_of_deadband(float value, float pushed, float deadband)
+{
+	return value - pushed > deadband || pushed - value > deadband;
+}
+
+/*@brief Function for handling the end of a push of real-time data.
+ *
+ * @param[in]   p_context  		Not used.
+ * @param[in]   status  		The push failed unless AL_SEND_STATUS_SUCCESS.
+ */
+static void al_rt_data_pushed(void* p_context, al_send_status_t status)
+{
+	m_rt_push_pending = false;
+	if (AL_SEND_STATUS_SUCCESS != status)
+		m_rt_pushed_time = GetCalendarUptime() - m_rt_heartbeat;  // Push again with the next sample.
+}
+
+/*@brief Function for pushing the real-time data to a subscribed phone.
+ *
+ * @note Pushes when a value moved out of its deadband, the fan or purify status changed, or the 
+ *		 heartbeat expired. One push is queued at a time, if the queue is full the push is tried again
+ *		 with the next sample.
+ */
+static void al_rt_data_push(void)
+{
+	if (m_rt_push_pending)
+		return;
+	uint32_t now = GetCalendarUptime();
+	uint8_t fan = GetFanDutyCycle();
+	if (!al_rt_out_of_deadband(m_al_sensor.pm2_5, m_rt_pushed.pm2_5, AL_RT_DEADBAND_PM25)
+		&& !al_rt_out_of_deadband(m_al_sensor.tvoc, m_rt_pushed.tvoc, AL_RT_DEADBAND_TVOC)
+		&& !al_rt_out_of_deadband(m_al_sensor.temperature, m_rt_pushed.temperature, AL_RT_DEADBAND_TEMP)
+		&& !al_rt_out_of_deadband(m_al_sensor.humidity, m_rt_pushed.humidity, AL_RT_DEADBAND_HUMI)
+		&& fan == m_rt_pushed_fan && purify_status == m_rt_pushed_purify
+		&& now - m_rt_pushed_time < m_rt_heartbeat)
+		return;
+	if (AL_SUCCESS != al_send_rt_data_all_packet(al_rt_data_pushed))
+		return;
+	m_rt_push_pending = true;
+	m_rt_pushed = m_al_sensor;
+	m_rt_pushed_fan = fan;
+	m_rt_pushed_purify = purify_status;
+	m_rt_pushed_time = now;
+}
+
+/*@brief Function for subscribing the real-time data.
+ *
+ * @param[in]   p_kv  		The key-value of AL_KEY_RT_DATA_SUBSCRIBE.
+ */
+static void al_rt_data_subscribe(al_data_t* p_kv)
+{
+	uint16_t heartbeat = AL_RT_PUSH_HEARTBEAT;
+	if (p_kv->key_length >= sizeof(heartbeat))
+		memcpy(&heartbeat, p_kv->p_value, sizeof(heartbeat));
+	m_rt_heartbeat = (heartbeat < AL_RT_PUSH_HEARTBEAT_MIN) ? AL_RT_PUSH_HEARTBEAT_MIN : heartbeat;
+	m_rt_subscribed = true;
+	m_rt_pushed_time = GetCalendarUptime() - m_rt_heartbeat;  // Push the current data at once.
+	al_rt_data_push();
+}
+
+/*@brief Function for stopping the push of real-time data, when the phone is gone.
+ */
+void al_rt_data_unsubscribe(void)
+{
+	m_rt_subscribed = false;
+}
+
 /*@brief Function for passing the sensor data from main.c to application.c.
  *<Add by Mida 2015-6-21>
  * @param[in]   sensor  		The sample data of sensor.
@@ -366,10 +706,23 @@ void al_init(al_init_t* p_init)
 void pass_to_al_sensor_data(SensorData sensor)
 {
 	m_al_sensor = sensor;
+	if (m_rt_subscribed)
+		al_rt_data_push();
+}
+
+/*@brief Function for getting the battery capacity reported to the phone.
+ *
+ * @return The battery capacity, uint(%).
+ */
+uint8_t al_get_battery_capacity(void)
+{
+	return battery_capacity;
 }
 
 /*@brief Function for processing Control packet.
  *<Modify by Mida>
+ * @note The fan is set before the reply is queued, al_recv_packet() has made room for it.
+ *
  * @param[in]   p_data  		Pointer to the data received.
  * @param[in]   length  		Length of the data.
  *
@@ -387,14 +740,12 @@ uint32_t al_process_control_packet(uint8_t* p_data, uint16_t length)
 				purify_status = AL_KEY_CONTROL_PURIFY_CLOSE;
 				nrf_gpio_pin_clear(PURIFIER_LED_PIN_NO);  
 				CloseFan();
-				al_send_execute_status_packet(AL_KEY_EXE_STAT_SUCCUSS,execute_status_vaule,2);		
-				break;
+				return al_send_execute_status_packet(AL_KEY_EXE_STAT_SUCCUSS,execute_status_vaule,2);		
 		case AL_KEY_CONTROL_PURIFY_OPEN:             // [Phone -> Purifier]: Start to purify.
 				purify_status = AL_KEY_CONTROL_PURIFY_OPEN;
 				nrf_gpio_pin_set(PURIFIER_LED_PIN_NO); 
 				OpenFan(60);
-				al_send_execute_status_packet(AL_KEY_EXE_STAT_SUCCUSS,execute_status_vaule,2);		
-				break;
+				return al_send_execute_status_packet(AL_KEY_EXE_STAT_SUCCUSS,execute_status_vaule,2);		
 		case AL_KEY_CONTROL_REVOLVING:					// [Phone -> Purifier]: Set the speed of revolving speed.
 			break;
 		case AL_KEY_CONTROL_POWEROFF:					  // [Phone -> Purifier]: Power off.
@@ -402,17 +753,20 @@ uint32_t al_process_control_packet(uint8_t* p_data, uint16_t length)
 	default:
 		return AL_ERROR_KEY;
 	}
-	return AL_SUCCESS;
+	return al_send_execute_status_packet(AL_KEY_EXE_STAT_SUCCUSS,execute_status_vaule,2);		// Every request is answered.
 }
 
 /*@brief Function for processing Setting packet.
  *<Add by @Mida 2015-7-16>
+ * @note A setting done is answered with a successful execute status, one which fails by al_recv_packet().
+ *
  * @param[in]   p_data  		Pointer to the data received.
  * @param[in]   length  		Length of the data.
  *
- * @return @ref AL_SUCCESS		Successfully sent the packet.
- * @return @ref AL_ERROR		Common failed.
- * @return @ref AL_ERROR_KEY	The Key id is wrong.
+ * @return @ref AL_SUCCESS				Successfully sent the packet.
+ * @return @ref AL_ERROR				Common failed, the RTC refused the time.
+ * @return @ref AL_ERROR_DATA_SIZE		The value is shorter than the setting.
+ * @return @ref AL_ERROR_KEY			The Key id is wrong.
  */
 uint32_t al_process_setting_packet(uint8_t* p_data, uint16_t length)
 {
@@ -424,22 +778,28 @@ uint32_t al_process_setting_packet(uint8_t* p_data, uint16_t length)
 		case AL_KEY_SETTING_PERIOD:             					// [Phone -> Purifier]: Setting the sample period.
 			break;
 		case AL_KEY_SETTING_TIME:					  							// [Phone -> Purifier]: Setting time.
+			if (p_kv->key_length < sizeof(CalenderTime))
+				return AL_ERROR_DATA_SIZE;
 			rtc = (CalenderTime *)p_kv->p_value;
-			SetCalenderTime(rtc);
-//			al_send_execute_status_packet(AL_KEY_EXE_STAT_SUCCUSS,execute_status_vaule,2);		
+			if (0 != SetCalenderTime(rtc))
+				return AL_ERROR;
 			break;
 		default:
 			return AL_ERROR_KEY;
 	}
-	return AL_SUCCESS;
+	return al_send_execute_status_packet(AL_KEY_EXE_STAT_SUCCUSS,execute_status_vaule,2);		
 }
 
 /*@brief Function for monitoring the real-time data.
  *<Add by @Mida 2015-7-22>
+ * @note The data asked for is the reply, subscribing and unsubscribing are answered with a successful
+ *		 execute status.
+ *
  * @param[in]   p_data  		Pointer to the data received.
  * @param[in]   length  		Length of the data.
  *
  * @return @ref AL_SUCCESS		Successfully sent the packet.
+ * @return @ref AL_WAIT			The reply could not be queued.
  * @return @ref AL_ERROR		Common failed.
  * @return @ref AL_ERROR_KEY	The Key id is wrong.
  */
@@ -447,15 +807,25 @@ uint32_t al_process_rt_monitor_packet(uint8_t* p_data, uint16_t length)
 {
 	al_download_payload(p_data);							//Download the payload to the m_al_recv_packet<Add by @Mida 2015-7-21>
   al_data_t* p_kv = &m_al_recv_data;  
+	uint32_t err_code;
+	execute_status_vaule[1] = p_kv->key_id;
 	switch(p_kv->key_id) {
-		case  AL_KEY_RT_DATA_PM25 :	al_send_rt_monitor_packet(AL_KEY_RT_DATA_PM25,(uint8_t *)&m_al_sensor.pm2_5,4); 			break;
-		case 	AL_KEY_RT_DATA_TVOC	:	al_send_rt_monitor_packet(AL_KEY_RT_DATA_TVOC,(uint8_t *)&m_al_sensor.tvoc,4);				break;	
-		case 	AL_KEY_RT_DATA_TEMP	:	al_send_rt_monitor_packet(AL_KEY_RT_DATA_TEMP,(uint8_t *)&m_al_sensor.temperature,4);	break;				
-		case 	AL_KEY_RT_DATA_HUMI	:	al_send_rt_monitor_packet(AL_KEY_RT_DATA_HUMI,(uint8_t *)&m_al_sensor.humidity,4);		break;					
+		case  AL_KEY_RT_DATA_PM25 :	return al_send_rt_monitor_packet(AL_KEY_RT_DATA_PM25,(uint8_t *)&m_al_sensor.pm2_5,4);
+		case 	AL_KEY_RT_DATA_TVOC	:	return al_send_rt_monitor_packet(AL_KEY_RT_DATA_TVOC,(uint8_t *)&m_al_sensor.tvoc,4);
+		case 	AL_KEY_RT_DATA_TEMP	:	return al_send_rt_monitor_packet(AL_KEY_RT_DATA_TEMP,(uint8_t *)&m_al_sensor.temperature,4);
+		case 	AL_KEY_RT_DATA_HUMI	:	return al_send_rt_monitor_packet(AL_KEY_RT_DATA_HUMI,(uint8_t *)&m_al_sensor.humidity,4);
+		case 	AL_KEY_RT_DATA_ALL	:	return al_send_rt_data_all_packet(NULL);
+		case 	AL_KEY_RT_DATA_SUBSCRIBE	:
+			// The reply first, the push must not take the buffer al_recv_packet() kept for it.
+			err_code = al_send_execute_status_packet(AL_KEY_EXE_STAT_SUCCUSS,execute_status_vaule,2);
+			if (AL_SUCCESS == err_code)
+				al_rt_data_subscribe(p_kv);
+			return err_code;
+		case 	AL_KEY_RT_DATA_UNSUBSCRIBE	:	al_rt_data_unsubscribe();	break;
 		default:
 			return AL_ERROR_KEY;
 	}
-	return AL_SUCCESS;
+	return al_send_execute_status_packet(AL_KEY_EXE_STAT_SUCCUSS,execute_status_vaule,2);
 }
 
 /*@brief Function for notify the hardware status to the Android.
@@ -464,6 +834,7 @@ uint32_t al_process_rt_monitor_packet(uint8_t* p_data, uint16_t length)
  * @param[in]   length  		Length of the data.
  *
  * @return @ref AL_SUCCESS		Successfully sent the packet.
+ * @return @ref AL_WAIT			The reply could not be queued.
  * @return @ref AL_ERROR		Common failed.
  * @return @ref AL_ERROR_KEY	The Key id is wrong.
  */
@@ -472,8 +843,8 @@ uint32_t al_process_status_packet(uint8_t* p_data, uint16_t length)
 	al_download_payload(p_data);							//Download the payload to the m_al_recv_packet<Add by @Mida 2015-7-21>
   al_data_t* p_kv = &m_al_recv_data;  
 	switch(p_kv->key_id){
-		case AL_KEY_STATUS_BATT_CAP	:		al_send_status_packet(AL_KEY_STATUS_BATT_CAP,(uint8_t *)100,1);  break;
-		case AL_KEY_STATUS_PURIFY		:		al_send_status_packet(AL_KEY_STATUS_PURIFY	,&purify_status,1);	break;
+		case AL_KEY_STATUS_BATT_CAP	:		return al_send_status_packet(AL_KEY_STATUS_BATT_CAP,&battery_capacity,1);
+		case AL_KEY_STATUS_PURIFY		:		return al_send_status_packet(AL_KEY_STATUS_PURIFY	,&purify_status,1);
 		
 		default:
 			return AL_ERROR_KEY;
@@ -482,5 +853,58 @@ uint32_t al_process_status_packet(uint8_t* p_data, uint16_t length)
 	
 }
 
-
-
+/*@brief Function for reading the off-line data recorded in flash.
+ *
+ * @note The values are little-endian. A record which can not be read returns AL_ERROR,
+ *       which al_recv_packet() answers with a failed execute status.
+ *
+ * @param[in]   p_data  		Pointer to the data received.
+ * @param[in]   length  		Length of the data.
+ *
+ * @return @ref AL_SUCCESS		Successfully sent the packet.
+ * @return @ref AL_WAIT			The reply could not be queued.
+ * @return @ref AL_ERROR		Common failed.
+ * @return @ref AL_ERROR_KEY	The Key id is wrong.
+ */
+uint32_t al_process_ol_data_packet(uint8_t* p_data, uint16_t length)
+{
+	al_download_payload(p_data);
+	al_data_t* p_kv = &m_al_recv_data;
+	execute_status_vaule[1] = p_kv->key_id;
+	uint8_t value[PAY_LOAD_MAX_LENGTH], time[6];
+	al_data_t kv[2];
+	uint16_t count, index;
+	uint32_t sequence;
+	SensorLogRecord record;
+	switch(p_kv->key_id) {
+		case AL_KEY_OL_DATA_COUNT:
+			count = GetSensorLogCount();
+			sequence = GetSensorLogFirstSequence();
+			memcpy(&value[0], &count, sizeof(count));
+			memcpy(&value[2], &sequence, sizeof(sequence));
+			return al_send_ol_data_packet(AL_KEY_OL_DATA_COUNT, value, 6);
+		case AL_KEY_OL_DATA_RECORD:
+			if (p_kv->key_length < sizeof(index))
+				return AL_ERROR;
+			memcpy(&index, p_kv->p_value, sizeof(index));
+			if (NRF_SUCCESS != ReadSensorLog(index, &record))
+				return AL_ERROR;
+			memcpy(&time[0], &index, sizeof(index));
+			memcpy(&time[2], &record.uTime, sizeof(record.uTime));
+			memcpy(&value[0], &index, sizeof(index));
+			memcpy(&value[2], &record.uPm25, sizeof(record.uPm25));
+			memcpy(&value[4], &record.uTvoc, sizeof(record.uTvoc));
+			value[6] = (uint8_t)record.nTemperature;
+			value[7] = record.uHumidity;
+			kv[0].key_id = AL_KEY_OL_DATA_TIME;
+			kv[0].key_length = sizeof(time);
+			kv[0].p_value = time;
+			kv[1].key_id = AL_KEY_OL_DATA_RECORD;
+			kv[1].key_length = sizeof(value);
+			kv[1].p_value = value;
+			return al_send_packet(AL_COMMAND_OL_DATA, kv, 2);
+		default:
+			return AL_ERROR_KEY;
+	}
+	return AL_SUCCESS;
+}
@@ -0,0 +1,86 @@
+/* Copyright (c) 2014 Before Technology. All Rights Reserved.
+ */
+
+#include "nrf.h"
+#include <integrity.h>
+#if !INTEGRITY_CRC16_NIBBLE_TABLE
+#include <crc16.h>
+#endif
+
+#if INTEGRITY_CRC16_NIBBLE_TABLE
+// CRC of each nibble shifted to the top, polynomial 0x1021.
+static const uint16_t m_crc16_table[16] =
+{
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+/**@brief Function for continuing a CRC over one byte, the high nibble first.
+ *
+ * @param[in]   crc				CRC of the data before.
+ * @param[in]   byte			The byte.
+ *
+ * @return The CRC including the byte.
+ */
+static __INLINE uint16_t crc16_byte(uint16_t crc, uint8_t byte)
+{
+	crc = (uint16_t)(crc << 4) ^ m_crc16_table[(crc >> 12) ^ (byte >> 4)];
+	crc = (uint16_t)(crc << 4) ^ m_crc16_table[(crc >> 12) ^ (byte & 0x0F)];
+	return crc;
+}
+#endif
+
+/**@brief Function for continuing a CRC over more data.
+ *
+ * @param[in]   crc				CRC of the data before, INTEGRITY_CRC16_INIT to start.
+ * @param[in]   p_data			Pointer to the data.
+ * @param[in]   length			Length of the data.
+ *
+ * @return The CRC including the data.
+ */
+uint16_t integrity_crc16_update(uint16_t crc, const uint8_t* p_data, uint16_t length)
+{
+#if INTEGRITY_CRC16_NIBBLE_TABLE
+	for (uint16_t i = 0; i < length; ++i)
+		crc = crc16_byte(crc, p_data[i]);
+	return crc;
+#else
+	return crc16_compute(p_data, length, &crc);
+#endif
+}
+
+/**@brief Function for copying data and continuing a CRC over it in the same pass.
+ *
+ * @param[in]   crc				CRC of the data before, INTEGRITY_CRC16_INIT to start.
+ * @param[out]  p_dest			Pointer to the destination.
+ * @param[in]   p_src			Pointer to the data.
+ * @param[in]   length			Length of the data.
+ *
+ * @return The CRC including the data.
+ */
+uint16_t integrity_crc16_copy(uint16_t crc, uint8_t* p_dest, const uint8_t* p_src, uint16_t length)
+{
+#if INTEGRITY_CRC16_NIBBLE_TABLE
+	for (uint16_t i = 0; i < length; ++i) {
+		p_dest[i] = p_src[i];
+		crc = crc16_byte(crc, p_src[i]);
+	}
+	return crc;
+#else
+	for (uint16_t i = 0; i < length; ++i)
+		p_dest[i] = p_src[i];
+	return crc16_compute(p_src, length, &crc);
+#endif
+}
+
+/**@brief Function for calculating the CRC of a buffer.
+ *
+ * @param[in]   p_data			Pointer to the data.
+ * @param[in]   length			Length of the data.
+ *
+ * @return The CRC of the data.
+ */
+uint16_t integrity_crc16_compute(const uint8_t* p_data, uint16_t length)
+{
+	return integrity_crc16_update(INTEGRITY_CRC16_INIT, p_data, length);
+}
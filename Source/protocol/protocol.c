@@ -13,31 +13,216 @@
  *
  */
 #include <protocol.h>
+#include <string.h>
+#include <nrf_soc.h>
+#include <app_timer.h>
+#include <app_scheduler.h>
+#include <app_error.h>
+#include <rx_buffer_queue.h>
 
 static ble_uart_t*		m_p_uart;
+static app_timer_id_t	m_tcl_timer_id; // Times out the sub-packets of the TCL, runs only while they need it.
+static bool				m_tcl_timer_running; // Started and stopped by the main context only.
+static volatile bool	m_tcl_reset_pending; // The scheduler was full at the disconnection, the reset is still to run.
+
+// The notifications wait here for a TX buffer of the SoftDevice, the queue holds a reference to each.
+// {
+static packet_buf_t*			m_tx_queue[PROTOCOL_TX_QUEUE_LENGTH];
+static volatile uint8_t			m_tx_queue_read; // Free running, masked by PROTOCOL_TX_QUEUE_MASK on access.
+static volatile uint8_t			m_tx_queue_write;
+static protocol_tx_statistics_t	m_tx_statistics;
+// }
+
+/**@brief Function for getting the number of notifications in the queue.
+ */
+static __INLINE uint8_t tx_queue_depth(void)
+{
+	return (uint8_t)(m_tx_queue_write - m_tx_queue_read);
+}
+
+/**@brief Function for passing the queued notifications to the SoftDevice until it has no TX buffer left.
+ *
+ * @note Called from the main context when queuing and from the BLE event when a buffer is freed, 
+ *		 so the queue is protected by a critical region.
+ */
+static void tx_queue_drain(void)
+{
+	uint8_t nested = 0;
+	sd_nvic_critical_region_enter(&nested);
+	while (0 != tx_queue_depth()) {
+		packet_buf_t* p_buf = m_tx_queue[m_tx_queue_read & PROTOCOL_TX_QUEUE_MASK];
+		uint16_t length = p_buf->length;
+		uint32_t err_code = ble_uart_send(m_p_uart, packet_buf_data(p_buf), &length); // The SoftDevice copies it.
+		if (BLE_ERROR_NO_TX_BUFFERS == err_code || NRF_ERROR_BUSY == err_code)
+			break; // Wait for BLE_EVT_TX_COMPLETE.
+		if (NRF_SUCCESS == err_code)
+			++m_tx_statistics.sent;
+		else
+			++m_tx_statistics.dropped; // Not connected or the notification is not enabled.
+		++m_tx_queue_read;
+		packet_buf_release(p_buf);
+	}
+	sd_nvic_critical_region_exit(nested);
+}
 
 /**@brief Function for sending packet to the BLE Profile Layer.
  *
  * @note This function, which is related with the context connects BLE Profile Layer
  *		 and Transport Control Layer.
+ * @note The buffer is queued as it is, with the reference of the sender. It is released once the SoftDevice
+ *		 took the notification, or at once if it cannot be queued.
+ *
+ * @param[in]   p_buf  			Buffer of the packet pool holding the packet.
+ *
+ * @return @ref NRF_SUCCESS				Successfully queued the packet.
+ * @return @ref NRF_ERROR_DATA_SIZE		The packet does not fit one notification.
+ * @return @ref NRF_ERROR_NO_MEM		The queue is full, the packet is dropped.
+ */
+static uint32_t ble_send_handler(packet_buf_t* p_buf)
+{
+	if (p_buf->length > BLE_UART_CHAR_BUFFER_SIZE) {
+		packet_buf_release(p_buf);
+		return NRF_ERROR_DATA_SIZE;
+	}
+	uint8_t nested = 0;
+	sd_nvic_critical_region_enter(&nested);
+	if (PROTOCOL_TX_QUEUE_LENGTH == tx_queue_depth()) {
+		++m_tx_statistics.dropped;
+		sd_nvic_critical_region_exit(nested);
+		packet_buf_release(p_buf);
+		return NRF_ERROR_NO_MEM;
+	}
+	m_tx_queue[m_tx_queue_write & PROTOCOL_TX_QUEUE_MASK] = p_buf;
+	++m_tx_queue_write;
+	++m_tx_statistics.queued;
+	if (tx_queue_depth() > m_tx_statistics.max_depth)
+		m_tx_statistics.max_depth = tx_queue_depth();
+	sd_nvic_critical_region_exit(nested);
+
+	tx_queue_drain();
+	return NRF_SUCCESS;
+}
+
+/**@brief Function for getting the time of the TCL from the RTC of app_timer.
+ *
+ * @note The RTC counter has 24 bits, it must be read at least every 512s to count the overflows.
+ *		 The TCL timer reads it every tick while it runs. An idle time longer than that is counted
+ *		 short, which does no harm as nothing is timed across it.
+ *
+ * @return Time in ms, free running.
+ */
+static uint32_t tcl_time_handler(void)
+{
+	static uint32_t	last_ticks;
+	static uint32_t	time_ms;
+	static uint32_t	remainder; // Part of a ms, uint(1/4096 ms).
+	uint32_t ticks;
+	app_timer_cnt_get(&ticks);
+	// A tick is (APP_TIMER_PRESCALER + 1) * 1000 / 32768 = (APP_TIMER_PRESCALER + 1) * 125 / 4096 ms.
+	uint32_t elapsed = ((ticks - last_ticks) & 0x00FFFFFF) * (APP_TIMER_PRESCALER + 1) * 125 + remainder;
+	last_ticks = ticks;
+	time_ms += elapsed >> 12;
+	remainder = elapsed & 0x0FFF;
+	return time_ms;
+}
+
+/**@brief Function for resetting the AL and the TCL in the main context after a disconnection.
+ *
+ * @param[in]   p_event_data	Not used.
+ * @param[in]   event_size		Not used.
+ */
+static void tcl_reset_handler(void* p_event_data, uint16_t event_size)
+{
+	al_reset(); // Fails the queued packets, the one on the way is not sent again.
+	tcl_reset(); // Fails a packet on the way and forgets the RTT of this link.
+	flush_rx_buffer_queue(); // The sub-packets the TCL kept waiting belong to the old link.
+}
+
+/**@brief Function for handling the time-out of TCL timer.
  *
- * @param[in]   p_data  		Pointer to the data buffer.
- * @param[in]   length  		Length of the data.
+ * @note The AL sends again a packet the TCL refused since the last tick.
+ * @note The AL takes then a received packet it had no room to reply to, and the RX buffer queue
+ *		 passes again the sub-packets waiting behind it.
+ *
+ * @param[in]   p_context	Not used.
+ */
+static void tcl_timeout_handler(void* p_context)
+{
+	tcl_timer_time_out();
+	al_tx_resume();
+	if (tcl_recv_resume())
+		rx_buffer_queue_resume();
+}
+
+/**@brief Function for handling the BLE events of the Protocol module.
  *
- * @return @ref AL_SUCCESS		Successfully sent the packet.
- * @return @ref AL_ERROR		Common failed.
+ * @param[in]   p_ble_evt	Event received from the BLE stack.
  */
-static uint32_t ble_send_handler(uint8_t* p_data, uint16_t length)
+void protocol_on_ble_evt(ble_evt_t* p_ble_evt)
 {
-	uint32_t err_code = ble_uart_send(m_p_uart, p_data, &length);
-	// The NRF_XXX and BLE_XXX may be different in different context.
-	if (NRF_SUCCESS == err_code
-		|| NRF_ERROR_BUSY == err_code
-		|| BLE_ERROR_NO_TX_BUFFERS == err_code) {
-		al_send_success();
-		return AL_SUCCESS;
+	uint8_t nested = 0;
+	switch (p_ble_evt->header.evt_id) {
+	case BLE_EVT_TX_COMPLETE:
+		m_tx_statistics.tx_complete += p_ble_evt->evt.common_evt.params.tx_complete.count;
+		tx_queue_drain();
+		break;
+	case BLE_GAP_EVT_DISCONNECTED:
+		sd_nvic_critical_region_enter(&nested);
+		m_tx_statistics.dropped += tx_queue_depth();
+		while (0 != tx_queue_depth()) // Nobody to send to.
+			packet_buf_release(m_tx_queue[m_tx_queue_read++ & PROTOCOL_TX_QUEUE_MASK]);
+		sd_nvic_critical_region_exit(nested);
+		if (NRF_SUCCESS != app_sched_event_put(NULL, 0, tcl_reset_handler)) // The TCL runs in the main context.
+			m_tcl_reset_pending = true; // Run by protocol_prepare_sleep() then.
+		al_rt_data_unsubscribe();
+		break;
+	default:
+		break;
 	}
-	return AL_ERROR;
+}
+
+/**@brief Function for getting the statistics of the notification queue.
+ *
+ * @param[out]  p_statistics	Pointer to the statistics.
+ */
+void protocol_get_tx_statistics(protocol_tx_statistics_t* p_statistics)
+{
+	uint8_t nested = 0;
+	sd_nvic_critical_region_enter(&nested);
+	*p_statistics = m_tx_statistics;
+	p_statistics->depth = tx_queue_depth();
+	sd_nvic_critical_region_exit(nested);
+}
+
+/**@brief Function for checking whether the Protocol has data on the way.
+ *
+ * @return true if notifications are queued, or the TCL is sending or receiving a packet.
+ */
+bool protocol_is_busy(void)
+{
+	return (0 != tx_queue_depth()) || (TCL_SEND_STATUS_SENDING == tcl_send_status()) || tcl_recv_busy();
+}
+
+/**@brief Function for starting or stopping the TCL timer before the main loop sleeps.
+ *
+ * @note The timer runs while the TCL sends or receives a packet, holds one the AL could not take,
+ *		 or the AL has a packet the TCL refused. An idle link does not wake the CPU every TCL_SEND_TIMER_INTERVAL.
+ * @note First runs the reset of a disconnection the scheduler had no room for, so that no packet
+ *		 of the old link is left on the way into the next one.
+ */
+void protocol_prepare_sleep(void)
+{
+	if (m_tcl_reset_pending) {
+		m_tcl_reset_pending = false;
+		tcl_reset_handler(NULL, 0);
+	}
+	bool busy = (TCL_SEND_STATUS_SENDING == tcl_send_status()) || tcl_recv_busy() || al_tx_is_deferred();
+	if (busy == m_tcl_timer_running)
+		return;
+	uint32_t err_code = busy ? app_timer_start(m_tcl_timer_id, APP_TIMER_TICKS(TCL_SEND_TIMER_INTERVAL, APP_TIMER_PRESCALER), NULL)
+							 : app_timer_stop(m_tcl_timer_id);
+	APP_ERROR_CHECK(err_code);
+	m_tcl_timer_running = busy;
 }
 
 /**@brief Function for initializing Protocol module.
@@ -48,11 +233,24 @@ static uint32_t ble_send_handler(uint8_t* p_data, uint16_t length)
 void purifier_protocol_init(protocol_init_t* p_protocol_init)
 {
 	m_p_uart = p_protocol_init->p_uart;
-	al_init_t init_al;
-	init_al.ble_send_hander = ble_send_handler;								//add the function for sending packet 
+
+	// The TCL frames the AL packets into notifications and reassembles the writes of Android.
+	tcl_init_t init_tcl;
+	init_tcl.ble_send_handler = ble_send_handler;
+	init_tcl.al_recv_handler = al_recv_packet;
+	init_tcl.al_send_failed_handler = al_send_failed;
+	init_tcl.al_send_success_handler = al_send_success;
+	init_tcl.time_handler = tcl_time_handler;
+	tcl_init(&init_tcl);
+	uint32_t err_code = app_timer_create(&m_tcl_timer_id, APP_TIMER_MODE_REPEATED, tcl_timeout_handler);
+	APP_ERROR_CHECK(err_code);
+
+	al_init_t init_al = {0};                                    //The handlers not set here stay NULL.
+	init_al.tcl_send_handler = tcl_send_packet;								//add the function for sending packet 
 	init_al.control_handler = al_process_control_packet;      //add the function for process control application packet 
 	init_al.settting_handler = al_process_setting_packet;			//add the function for process setting application packet
 	init_al.real_time_monitor_handler = al_process_rt_monitor_packet;		//add the function for monitor the real-time data.
+	init_al.ol_data_handler = al_process_ol_data_packet;			//add the function for reading the off-line data.
 	init_al.status_handler = al_process_status_packet;				//add the function for notify the hardware status to Android.
 	p_protocol_init->p_al_init = &init_al;
 	al_init(p_protocol_init->p_al_init);
@@ -11,36 +11,58 @@
  */
 #include <stdbool.h>
 #include <string.h>
+#include "nordic_common.h"
 #include <transport.h>
+#include <integrity.h>
 #include <application.h>
 
 // The following variable holds the handler of BLE Module for sending data.
-static ble_send_handler_t			ble_send_handler;
+static ble_send_buf_handler_t		ble_send_handler;
 
 // The following variable holds the handler of Application Module for receiving packet 
 static al_recv_handler_t					al_recv_handler;
 static al_send_failed_handler_t		al_send_failed_handler;
 static al_send_success_handler_t	al_send_success_handler;
+static tcl_time_handler_t			time_handler;
 
 // The following environment is set and saved for one transmission which are derived from the Application Layer.
 // {
-static uint8_t*						m_p_send_data; // Pointer to the data will be sent.
-static uint16_t						m_send_data_length_left; // The byte number left of the data from L2.
+static packet_buf_t*				m_p_send_data; // The data will be sent, one sub-packet in each buffer of the chain.
+static uint16_t						m_send_data_length; // The byte number of the data from L2.
 
 static uint8_t						m_send_sub_packet_number; // The number of the sub-packet.
-static uint8_t						m_send_sequence_id; // The id of the sub-packet.
+static uint8_t						m_send_sequence_id; // The id of the sub-packet being loaded.
+static uint8_t						m_send_base; // The first sub-packet not acknowledged.
+static uint8_t						m_send_next; // The first sub-packet never sent.
+static uint8_t						m_send_acked[TCL_SACK_BITMAP_LENGTH]; // Sub-packets acknowledged by the peer.
+static uint8_t						m_send_resent[TCL_SACK_BITMAP_LENGTH]; // Sub-packets resent since the last time-out.
+static uint8_t						m_send_window = 1; // Window of the peer, 1 until it speaks the windowed mode.
+static uint8_t						m_send_toggle; // Toggle flag of the packet being sent.
 static tcl_send_status_t			m_send_status;
 static tcl_timer_t					m_send_sub_packet_timer;
 
-static tcl_packet_t					m_send_packet; // Data packet to sent.
-static tcl_ack_packet_t				m_send_ack_packet; // ACK packet to sent.
+static tcl_header_t					m_send_header; // Header of the sub-packets to send.
+static tcl_header_t					m_send_ack_header; // Header of the ACK to send.
+static packet_buf_t*				m_send_bufs[TCL_WINDOW_SIZE]; // Sub-packets in flight, kept for the retransmissions.
 // }
 
+#define TCL_SEND_BUF(id)					(m_send_bufs[(id) & (TCL_WINDOW_SIZE - 1)]) // Ids in flight differ by less than the window.
+
 // The following environment is saved for one transmission which are from the BLE Profile Layer.
 // {
 static uint8_t						m_recv_payload[TCL_PAYLOAD_MTU];
 static uint16_t						m_recv_data_length_count;
+static uint8_t						m_recv_bitmap[TCL_SACK_BITMAP_LENGTH]; // Sub-packets received.
+static uint8_t						m_recv_toggle; // Toggle flag of the packet being received.
+static uint8_t						m_recv_done_toggle = 0xFF; // Toggle flag of the last packet received, 0xFF if none.
+static uint8_t						m_recv_done_last_id; // Last sub-packet of it, to acknowledge a late copy again.
+static uint16_t						m_recv_wait_length; // Length of the packet received which the AL could not take yet, 0 if none.
 static tcl_timer_t				m_recv_packet_timer;
+
+// The round-trip time estimate.
+static tcl_rtt_t					m_rtt;
+static uint8_t						m_rtt_sequence_id = TCL_SACK_NONE; // Sub-packet being timed, TCL_SACK_NONE if none.
+static uint32_t						m_rtt_start; // Time it was sent, uint(ms).
 // }
 
 /**@brief Function for starting the timer.
@@ -50,6 +72,17 @@ static tcl_timer_t				m_recv_packet_timer;
 static void tcl_timer_start(tcl_timer_t* p_timer)
 {
 	p_timer->status = TCL_TIMER_START;
+	p_timer->start = time_handler();
+}
+
+/**@brief Function for checking whether the timer has run for a time.
+ *
+ * @param[in]   p_timer		Pointer to the Timer.
+ * @param[in]   timeout		The time, uint(ms).
+ */
+static bool tcl_timer_expired(tcl_timer_t* p_timer, uint32_t timeout)
+{
+	return (TCL_TIMER_START == p_timer->status) && (time_handler() - p_timer->start >= timeout);
 }
 
 /**@brief Function for stopping the timer.
@@ -64,22 +97,15 @@ static void tcl_timer_stop(tcl_timer_t* p_timer)
 
 /**@brief Function for calculate the checksum of the packet.
  *
- * @param[in]   p_packet		Pointer to the TCL packet.
- * @param[in]   length			Pointer to the TCL packet.
+ * @param[in]   p_data			Pointer to the TCL packet.
+ * @param[in]   length			Length of the TCL packet, the header included.
  *
- * @return Checksum of the packet.
+ * @return CRC-16 of the header without check_sum and of the payload.
  */
-static uint16_t checksum(uint16_t* p_data, uint16_t length)
+static uint16_t checksum(const uint8_t* p_data, uint16_t length)
 {
-	uint16_t ret = 0;
-	/*********<Modify by Mida>***************/
-	if((length%2)!=0)               
-		length += 1;
-	/*********<Modify by Mida>***************/
-	length /= 2;
-	for (uint16_t i = 0; i < length; ++i)
-		ret += p_data[i];
-	return ~ret;
+	uint16_t crc = integrity_crc16_update(INTEGRITY_CRC16_INIT, p_data, TCL_HEADER_CRC_LENGTH);
+	return integrity_crc16_update(crc, p_data + TCL_HEADER_LENGTH, length - TCL_HEADER_LENGTH);
 }
 
 /**@brief Function for checking whether is the last sub-packet will be sent.
@@ -93,15 +119,52 @@ static bool tcl_is_ack_packet(tcl_packet_t* p_packet)
 	return TCL_CHECK_ACK_FLAG(p_packet->header.flag);
 }
 
+/**@brief Function for initiating the round-trip time estimate.
+ *
+ */
+static void tcl_rtt_init(void)
+{
+	memset(&m_rtt, 0, sizeof(m_rtt));
+	m_rtt.rto = TCL_RTO_INITIAL;
+	m_rtt_sequence_id = TCL_SACK_NONE;
+}
+
+/**@brief Function for updating the round-trip time estimate with a sample, as RFC 6298.
+ *
+ * @param[in]   rtt				The round-trip time measured, uint(ms).
+ */
+static void tcl_rtt_update(uint32_t rtt)
+{
+	if (0 == m_rtt.samples++) {
+		m_rtt.srtt = rtt;
+		m_rtt.rttvar = rtt / 2;
+	} else {
+		uint32_t delta = (m_rtt.srtt > rtt) ? (m_rtt.srtt - rtt) : (rtt - m_rtt.srtt);
+		m_rtt.rttvar = (3 * m_rtt.rttvar + delta) / 4; // beta = 1/4
+		m_rtt.srtt = (7 * m_rtt.srtt + rtt) / 8; // alpha = 1/8
+	}
+	uint32_t rto = m_rtt.srtt + MAX(TCL_SEND_TIMER_INTERVAL, 4 * m_rtt.rttvar);
+	m_rtt.rto = (rto < TCL_RTO_MIN) ? TCL_RTO_MIN : ((rto > TCL_RTO_MAX) ? TCL_RTO_MAX : rto);
+}
+
 /**@brief Function for initiating the send environment.
  *
  */
 static void tcl_init_send_env(void)
 {
 	m_p_send_data = NULL;
-	m_send_data_length_left = 0;
+	m_send_data_length = 0;
 	m_send_sub_packet_number = 0;
 	m_send_sequence_id = 0;
+	m_send_base = 0;
+	m_send_next = 0;
+	memset(m_send_acked, 0, TCL_SACK_BITMAP_LENGTH);
+	memset(m_send_resent, 0, TCL_SACK_BITMAP_LENGTH);
+	m_rtt_sequence_id = TCL_SACK_NONE;
+	for (uint8_t i = 0; i < TCL_WINDOW_SIZE; ++i) {
+		packet_buf_release(m_send_bufs[i]);
+		m_send_bufs[i] = NULL;
+	}
 }
 
 /**@brief Function for handling situation of failing to send packet.
@@ -145,115 +208,168 @@ static void tcl_header_init(tcl_header_t* p_header)
 static void tcl_init_recv_env(void)
 {
 	m_recv_data_length_count = 0;
+	m_recv_wait_length = 0;
 	memset(&m_recv_payload, 0, TCL_PAYLOAD_MTU);
+	memset(m_recv_bitmap, 0, TCL_SACK_BITMAP_LENGTH);
 }
 
-/**@brief Function for checking whether is the last sub-packet will be sent.
+/**@brief Function for getting the payload length of a sub-packet.
  *
- * @return true If it is the last sub-packet, false if not.
- */
-static bool tcl_is_last_packet(void)
-{
-	return m_send_sequence_id == (m_send_sub_packet_number - 1);
-}
-
-/**@brief Function for loading the data to the header of sub-packet.
+ * @param[in]   sequence_id		Sequence ID of the sub-packet.
+ * @param[in]   total_length	Length of the whole packet.
  *
+ * @return Length of the payload, the last sub-packet may be shorter than BLE_UART_PAYLOAD_MTU.
  */
-static void tcl_load_packet_header(void)
+static uint16_t tcl_sub_packet_length(uint8_t sequence_id, uint16_t total_length)
 {
-	m_send_packet.header.sequence_id = m_send_sequence_id;
-	m_send_packet.header.check_sum = 0;
+	uint16_t offset = (uint16_t)sequence_id * BLE_UART_PAYLOAD_MTU;
+	if (offset >= total_length)
+		return 0;
+	return (total_length - offset < BLE_UART_PAYLOAD_MTU) ? (total_length - offset) : BLE_UART_PAYLOAD_MTU;
 }
 
-/**@brief Function for loading the data to the payload of sub-packet.
+/**@brief Function for loading the payload of sub-packet, the last one is padded with 0.
  *
- * @param[in]   length  		Real length of the payload.
- */
-static uint16_t tcl_load_packet_payload(void)
-{
-	uint16_t length = BLE_UART_PAYLOAD_MTU;
-	if (tcl_is_last_packet())         /*<Modify by Mida>2015-5-22*/
-	{
-		uint16_t i,left_length;
-		left_length = m_send_data_length_left;
-		for (i = 0; i < length; ++i)
-			m_send_packet.payload[i] = m_p_send_data[i];
-		for(i = left_length; i< BLE_UART_PAYLOAD_MTU ;++i)
-			m_send_packet.payload[i] = 0;
-	}
-	else
-	{
-		for (uint16_t i = 0; i < length; ++i)
-			m_send_packet.payload[i] = m_p_send_data[i];
-	}
-	return length;
-}
-
-/**@brief Function for loading the checksum of sub-packet.
+ * @note A buffer framed by an earlier attempt at the packet holds its padded payload behind the old header.
+ *
+ * @param[in]   p_buf  		Buffer of the sub-packet.
  *
- * @param[in]   length  		Real length of the packet.
+ * @return false if the buffer was not taken with TCL_HEADER_LENGTH headroom.
  */
-static void tcl_load_packet_checksum(uint16_t length)
+static bool tcl_load_packet_payload(packet_buf_t* p_buf)
 {
-	m_send_packet.header.check_sum = checksum((uint16_t*)&m_send_packet, length);
+	if (0 == p_buf->offset)
+		return true;
+	if (TCL_HEADER_LENGTH != p_buf->offset || p_buf->length > BLE_UART_PAYLOAD_MTU)
+		return false;
+	uint16_t left_length = p_buf->length;
+	memset(packet_buf_put(p_buf, BLE_UART_PAYLOAD_MTU - left_length), 0, BLE_UART_PAYLOAD_MTU - left_length);
+	packet_buf_push(p_buf, TCL_HEADER_LENGTH);
+	return true;
 }
 
 /**@brief Function for loading the flag of sub-packet.
  *<Add by @Mida 2015-6-18>
- * @param[in]   p_data  		The pointer to the sending data.
+ * @param[in]   p_data  		The pointer to the sending data, the AL packet.
  */
 static void tcl_load_packet_flag(uint8_t * p_data)
 {
 	al_packet_t * al_packet = (al_packet_t *)p_data;
-	uint8_t al_packet_commandID = al_packet->header.command_id;
-	m_send_packet.header.flag = (m_send_packet.header.flag & 0xC3)|(al_packet_commandID << 2);
+	uint8_t al_packet_commandID = al_packet->al_header.command_id;
+	m_send_header.flag = (m_send_header.flag & 0xC3)|(al_packet_commandID << 2);
+	TCL_SET_SACK_FLAG(m_send_header.flag);  // Ask a windowed peer for the SACK.
+	if (m_send_header.payload_length > BLE_UART_PAYLOAD_MTU)
+		m_send_toggle ^= 1;                         // Tell a late copy of the previous windowed packet from this one, the peer sees no other.
+	m_send_header.flag = (m_send_header.flag & 0x7F) | (m_send_toggle << TCL_HEADER_FLAG_TOGGLE_BIT_POS);
 }
 
-/**@brief Function for loading the data to the sub-packet.
+/**@brief Function for loading the sub-packet in its buffer of the chain, in place.
+ *
+ * @note The payload is padded first, then the header is prepended in the headroom and the CRC computed over both.
  *
- * @return length				Real length of the packet.
+ * @return The buffer with one more reference, NULL if the chain does not hold the sub-packet.
  */
-static uint16_t tcl_load_packet(void)
+static packet_buf_t* tcl_load_packet(void)
 {
-	tcl_load_packet_header();
-	uint16_t length = TCL_HEADER_LENGTH + tcl_load_packet_payload();
-	tcl_load_packet_checksum(length);
-	return length;
+	packet_buf_t* p_buf = m_p_send_data;
+	for (uint8_t id = 0; id < m_send_sequence_id && NULL != p_buf; ++id)
+		p_buf = p_buf->p_next;
+	if (NULL == p_buf || !tcl_load_packet_payload(p_buf))
+		return NULL;
+	tcl_packet_t* p_packet = (tcl_packet_t*)packet_buf_data(p_buf);
+	m_send_header.sequence_id = m_send_sequence_id;
+	p_packet->header = m_send_header;
+	p_packet->header.check_sum = checksum((uint8_t*)p_packet, BLE_UART_MTU);
+	packet_buf_retain(p_buf);
+	return p_buf;
 }
 
 /**@brief Function for sending sub-packet.
+ *
+ * @note A sub-packet is loaded once and kept until it is acknowledged, a retransmission sends the same buffer again.
+ *
+ * @param[in]   sequence_id		Sequence ID of the sub-packet.
  *
  * @return @ref TCL_SUCCESS		Successfully sent the sub-packet.
  * @return @ref TCL_ERROR		Common failed.
  */
-static uint32_t tcl_send_sub_packet(void)
+static uint32_t tcl_send_sub_packet(uint8_t sequence_id)
 {
-	uint16_t length = tcl_load_packet();
-	uint32_t err_code = ble_send_handler((uint8_t*)&m_send_packet, length);
+	if (NULL == TCL_SEND_BUF(sequence_id)) {
+		m_send_sequence_id = sequence_id;
+		TCL_SEND_BUF(sequence_id) = tcl_load_packet();
+		if (NULL == TCL_SEND_BUF(sequence_id)) {
+			tcl_send_failed(); // The chain is shorter than the packet.
+			return TCL_ERROR;
+		}
+	}
+	packet_buf_retain(TCL_SEND_BUF(sequence_id)); // The BLE Profile Layer releases its own reference.
+	uint32_t err_code = ble_send_handler(TCL_SEND_BUF(sequence_id));
 	if (BLE_SUCCESS != err_code) {
 		// Reaching here means BLE is busy or error.
 		tcl_send_failed(); // Failed to send packet.
 		return TCL_ERROR;
 	}
+	if (sequence_id == m_rtt_sequence_id)
+		m_rtt_sequence_id = TCL_SACK_NONE; // Sent again, its ACK would be ambiguous (Karn).
+	else if (TCL_SACK_NONE == m_rtt_sequence_id && sequence_id == m_send_next) {
+		m_rtt_sequence_id = sequence_id; // Time a new sub-packet.
+		m_rtt_start = time_handler();
+	}
 	tcl_timer_start(&m_send_sub_packet_timer);	
 	return TCL_SUCCESS;
 }
 
+/**@brief Function for sending the new sub-packets which the window of the peer allows.
+ *
+ * @return @ref TCL_SUCCESS		Successfully sent the sub-packets.
+ * @return @ref TCL_ERROR		Common failed.
+ */
+static uint32_t tcl_send_window(void)
+{
+	while (m_send_next < m_send_sub_packet_number
+		&& (uint8_t)(m_send_next - m_send_base) < m_send_window) {
+		if (TCL_SUCCESS != tcl_send_sub_packet(m_send_next))
+			return TCL_ERROR;
+		++m_send_next;
+	}
+	return TCL_SUCCESS;
+}
+
+/**@brief Function for resending the sub-packets in flight which are not acknowledged.
+ *
+ * @param[in]   below			Only the sub-packets before this one, which the peer has seen overtaken.
+ * @param[in]   once			Skip the sub-packets already resent since the last time-out.
+ *
+ * @return @ref TCL_SUCCESS		Successfully sent the sub-packets.
+ * @return @ref TCL_ERROR		Common failed.
+ */
+static uint32_t tcl_resend_lost(uint8_t below, bool once)
+{
+	for (uint8_t id = m_send_base; id < below && id < m_send_next; ++id) {
+		if (TCL_BITMAP_CHECK(m_send_acked, id) || (once && TCL_BITMAP_CHECK(m_send_resent, id)))
+			continue;
+		TCL_BITMAP_SET(m_send_resent, id);
+		if (TCL_SUCCESS != tcl_send_sub_packet(id))
+			return TCL_ERROR;
+	}
+	return TCL_SUCCESS;
+}
+
 /**@brief Function for sending sub-packet.
  *
- * @param[in]   p_data  		Pointer to the data buffer.
+ * @param[in]   p_data  		The first buffer of the chain holding the data.
  * @param[in]   length  		Length of the data.
  *
  */
-static void tcl_set_send_env(uint8_t* p_data, uint16_t length)
+static void tcl_set_send_env(packet_buf_t* p_data, uint16_t length)
 {
-	m_send_packet.header.payload_length = length;
-	tcl_load_packet_flag(p_data);               //Loading the flag of tcl header.<Add by @Mida 2015-6-18>
+	tcl_init_send_env();
+	m_send_header.payload_length = length;
+	tcl_load_packet_flag(&p_data->data[TCL_HEADER_LENGTH]);   //Loading the flag of tcl header, the data starts behind the headroom.<Add by @Mida 2015-6-18>
 	m_p_send_data = p_data;
-	m_send_data_length_left = length;
+	m_send_data_length = length;
 	m_send_sub_packet_number = TCL_CALC_SUB_PACKET_NUMBER(length);
-	m_send_sequence_id = 0;
 	m_send_status = TCL_SEND_STATUS_SENDING;
 }
 
@@ -267,32 +383,66 @@ tcl_send_status_t tcl_send_status(void)
 	return m_send_status;
 }
 
+/**@brief Function for checking whether a packet is being received.
+ *
+ * @return true from the first sub-packet until the packet is taken by the AL or timed out.
+ */
+bool tcl_recv_busy(void)
+{
+	return TCL_TIMER_START == m_recv_packet_timer.status || 0 != m_recv_wait_length;
+}
+
+/**@brief Function for passing again to the AL the packet it could not take.
+ *
+ * @note Only this function passes it again, so that a pass of the RX buffer queue keeps every data
+ *		 sub-packet waiting behind it, in order, while the ACKs go through.
+ *
+ * @return true if no packet waits for the AL any more.
+ */
+bool tcl_recv_resume(void)
+{
+	if (0 == m_recv_wait_length)
+		return true;
+	if (TCL_WAIT == al_recv_handler(m_recv_payload, m_recv_wait_length))
+		return false;
+	tcl_init_recv_env();
+	return true;
+}
+
 /**@brief Function for sending packet from Application Layer to BLE Profile Layer.
  *
- * @note The Application layer should keep the data buffer until sending finishes.
+ * @note The packet is built in a chain of buffers taken with TCL_HEADER_LENGTH headroom, BLE_UART_PAYLOAD_MTU
+ *		 bytes in each but the last one. The sub-packets are framed in place and the TCL keeps a reference to
+ *		 those in flight. The Application layer keeps its own until sending finishes.
+ * @note A chain sent again, after a failure, is framed again in place. A sub-packet of the earlier attempt
+ *		 still in the notification queue then goes out as the same sub-packet of the new one.
  *
- * @param[in]   p_data  		Pointer to the data buffer.
+ * @param[in]   p_data  		The first buffer of the chain.
  * @param[in]   length  		Length of the data.
  *
  * @return @ref TCL_SUCCESS		Successfully sent the packet.
  * @return @ref TCL_ERROR		Common failed.
  * @return @ref TCL_WAIT		Wait and send again.
  */
-uint32_t tcl_send_packet(uint8_t* p_data, uint16_t length)
+uint32_t tcl_send_packet(packet_buf_t* p_data, uint16_t length)
 {
 	if (TCL_SEND_STATUS_SENDING == tcl_send_status())
 		return TCL_WAIT;
+	if (length > TCL_PAYLOAD_MTU || NULL == p_data)
+		return TCL_ERROR_DATA_SIZE;
 	tcl_set_send_env(p_data, length);
 	if(length <= BLE_UART_PAYLOAD_MTU)         //<Add by @Mida 2015-6-22>
 	{
 		uint32_t err_code;
-		err_code = tcl_send_sub_packet();
-		if(err_code == TCL_SUCCESS)
+		err_code = tcl_send_sub_packet(0);
+		if(err_code == TCL_SUCCESS) {
+			tcl_timer_stop(&m_send_sub_packet_timer);
 			tcl_send_success();   // Notice AL 
+		}
 		return err_code;
 	}
 	else	
-		return tcl_send_sub_packet();
+		return tcl_send_window();
 }
 
 /**@brief Function for sending ACK packet through the Transport Control Layer.
@@ -304,69 +454,92 @@ uint32_t tcl_send_packet(uint8_t* p_data, uint16_t length)
  */
 static uint32_t tcl_send_ack_packet()
 {
-	TCL_SET_ACK_FLAG(m_send_ack_packet.header.flag);
-	m_send_ack_packet.header.check_sum = 0;
-	m_send_ack_packet.header.check_sum = checksum((uint16_t*)&m_send_ack_packet, TCL_HEADER_LENGTH);
-	/******************<Motify by Mida>*************************/
-	memset(&m_send_packet.payload, 0, BLE_UART_PAYLOAD_MTU);
-	uint32_t err_code = ble_send_handler((uint8_t*)&m_send_ack_packet, BLE_UART_MTU);
+	packet_buf_t* p_buf = packet_buf_alloc(TCL_HEADER_LENGTH);
+	if (NULL == p_buf)
+		return TCL_ERROR; // The packet pool is empty, the peer sends again.
+	TCL_SET_ACK_FLAG(m_send_ack_header.flag);
 	/******************<Motify by Mida>*************************/
-	if (BLE_SUCCESS != err_code) {
-		// Reaching here means BLE is busy or error.
-		tcl_send_failed(); // Failed to send packet.
-		return TCL_ERROR;
+	uint8_t* p_payload = packet_buf_put(p_buf, BLE_UART_PAYLOAD_MTU);
+	memset(p_payload, 0, BLE_UART_PAYLOAD_MTU);
+	if (TCL_CHECK_SACK_FLAG(m_send_ack_header.flag)) {
+		p_payload[TCL_SACK_WINDOW_POS] = TCL_WINDOW_SIZE;
+		memcpy(&p_payload[TCL_SACK_BITMAP_POS], m_recv_bitmap, TCL_SACK_BITMAP_LENGTH);
 	}
+	tcl_packet_t* p_packet = (tcl_packet_t*)packet_buf_push(p_buf, TCL_HEADER_LENGTH);
+	p_packet->header = m_send_ack_header;
+	p_packet->header.check_sum = checksum((uint8_t*)p_packet, BLE_UART_MTU);
+	uint32_t err_code = ble_send_handler(p_buf);
+	/******************<Motify by Mida>*************************/
+	if (BLE_SUCCESS != err_code)
+		return TCL_ERROR; // Reaching here means BLE is busy or error, the peer sends again.
 	return TCL_SUCCESS;
 }
 
 /**@brief Function for process received ACK.
  *
- * @param[in]   flag  			Flag of the ACK packet.
+ * @param[in]   p_packet		Pointer to the ACK packet.
  *
  * @note When receive the ACK packet we should check the flag firstly.
- * @note If the flag indicate that there is something wrong we should send the same packet again.
+ * @note If the flag indicate that there is something wrong we should send the sub-packets in flight again.
+ * @note The sequence id acknowledges every sub-packet up to it. The ACK of a windowed peer also carries 
+ *		 its window and the bitmap of sub-packets received out of order, only the holes are resent.
 
  * @return @ref TCL_SUCCESS		Successfully sent the sub-packet.
  * @return @ref TCL_ERROR		Common failed.
  */
-static uint32_t tcl_process_recv_ack(tcl_packet_t p_packet)
+static uint32_t tcl_process_recv_ack(tcl_packet_t* p_packet)
 {
-	uint8_t flag = p_packet.header.flag;
-	uint8_t sequence_id = p_packet.header.sequence_id;
-	m_send_sequence_id = sequence_id + 1;
-	tcl_timer_stop(&m_send_sub_packet_timer);
-	if (true == TCL_CHECK_ERR_FLAG(flag)) {
-		return tcl_send_sub_packet(); // Just send again the previous sub-packet.
-	} else {
-		if (m_send_sequence_id < m_send_sub_packet_number) { // Check whether is ACK for the last sub-packet.
-			m_p_send_data += BLE_UART_PAYLOAD_MTU;
-			m_send_data_length_left -= BLE_UART_PAYLOAD_MTU;
-			return tcl_send_sub_packet();
-		} 
-		if (m_send_sequence_id == m_send_sub_packet_number) { // ACK for the last sub-packet.
-			tcl_send_success(); // Notice AL.	
-			nrf_gpio_pin_toggle(SEND_PACKET_FINISH_LED_PIN_NO);    // <Modify by Mida>2015-6-15
-		} else {
-			return TCL_ERROR;
-		}
+	uint8_t flag = p_packet->header.flag;
+	uint8_t sequence_id = p_packet->header.sequence_id;
+	if (TCL_SEND_STATUS_SENDING != m_send_status)
+		return TCL_SUCCESS; // A late ACK.
+	if (true == TCL_CHECK_ERR_FLAG(flag))
+		return tcl_resend_lost(m_send_next, false); // Just send again the sub-packets in flight.
+	if (TCL_CHECK_SACK_FLAG(flag) && TCL_CHECK_TOGGLE_FLAG(flag) != m_send_toggle)
+		return TCL_SUCCESS; // A late SACK of the previous packet.
+
+	uint8_t highest = 0; // One after the highest sub-packet acknowledged.
+	if (TCL_SACK_NONE != sequence_id) {
+		for (uint8_t id = 0; id <= sequence_id && id < m_send_sub_packet_number; ++id)
+			TCL_BITMAP_SET(m_send_acked, id);
+		highest = sequence_id + 1;
 	}
-	/*
-	if (true == TCL_CHECK_ERR_FLAG(flag)) {
-		return tcl_send_sub_packet(); // Just send again the previous sub-packet.
-	} else {
-		if (++m_send_sequence_id < m_send_sub_packet_number) { // Check whether is ACK for the last sub-packet.
-			m_p_send_data += BLE_UART_PAYLOAD_MTU;
-			m_send_data_length_left -= BLE_UART_PAYLOAD_MTU;
-			return tcl_send_sub_packet();
-		} 
-		if (m_send_sequence_id == m_send_sub_packet_number) { // ACK for the last sub-packet.
-			tcl_send_success(); // Notice AL.	
-			nrf_gpio_pin_set(SEND_PACKET_FINISH_LED_PIN_NO);    // <Modify by Mida>2015-6-15
-		} else {
-			return TCL_ERROR;
+	if (TCL_CHECK_SACK_FLAG(flag)) {
+		uint8_t window = p_packet->payload[TCL_SACK_WINDOW_POS];
+		m_send_window = (0 == window) ? 1 : ((window > TCL_WINDOW_SIZE) ? TCL_WINDOW_SIZE : window);
+		const uint8_t* p_bitmap = &p_packet->payload[TCL_SACK_BITMAP_POS];
+		for (uint8_t id = 0; id < m_send_next; ++id) {
+			if (TCL_BITMAP_CHECK(p_bitmap, id)) {
+				TCL_BITMAP_SET(m_send_acked, id);
+				highest = id + 1;
+			}
 		}
-	}*/
-	return TCL_SUCCESS;
+	} else {
+		m_send_window = 1; // A legacy peer is stop-and-wait.
+	}
+
+	if (TCL_SACK_NONE != m_rtt_sequence_id && TCL_BITMAP_CHECK(m_send_acked, m_rtt_sequence_id)) {
+		tcl_rtt_update(time_handler() - m_rtt_start);
+		m_rtt_sequence_id = TCL_SACK_NONE;
+	}
+
+	uint8_t base = m_send_base;
+	while (m_send_base < m_send_sub_packet_number && TCL_BITMAP_CHECK(m_send_acked, m_send_base)) {
+		packet_buf_release(TCL_SEND_BUF(m_send_base)); // Not sent again.
+		TCL_SEND_BUF(m_send_base) = NULL;
+		++m_send_base;
+	}
+	if (m_send_base == m_send_sub_packet_number) { // ACK for the last sub-packet.
+		tcl_timer_stop(&m_send_sub_packet_timer);
+		tcl_send_success(); // Notice AL.	
+		nrf_gpio_pin_toggle(SEND_PACKET_FINISH_LED_PIN_NO);    // <Modify by Mida>2015-6-15
+		return TCL_SUCCESS;
+	}
+	if (m_send_base != base)
+		m_send_sub_packet_timer.count = 0; // Making progress, restart counting the time-outs.
+	if (TCL_SUCCESS != tcl_resend_lost(highest, true)) // Sub-packets overtaken by a later one are lost.
+		return TCL_ERROR;
+	return tcl_send_window();
 }
 
 /**@brief Function for downloading the payload to buffer.
@@ -378,13 +551,35 @@ static uint32_t tcl_process_recv_ack(tcl_packet_t p_packet)
  */
 static void tcl_download_recv_packet_payload(uint8_t sequence_id, uint8_t* p_payload, uint16_t length)
 {
+	if (TCL_BITMAP_CHECK(m_recv_bitmap, sequence_id))
+		return; // A duplicate, the ACK was lost.
+	TCL_BITMAP_SET(m_recv_bitmap, sequence_id);
 	uint8_t* p_buffer = m_recv_payload + ((sequence_id) * BLE_UART_PAYLOAD_MTU);
-	for (uint16_t i = 0; i < length; ++i) {
-		if (0 == p_buffer[i]) {
-			++m_recv_data_length_count;
-			p_buffer[i] = p_payload[i];
-		}
-	}
+	for (uint16_t i = 0; i < length; ++i)
+		p_buffer[i] = p_payload[i];
+	m_recv_data_length_count += length;
+}
+
+/**@brief Function for getting the last sub-packet received in order.
+ *
+ * @return Sequence id of the sub-packet, @ref TCL_SACK_NONE if the first one is missing.
+ */
+static uint8_t tcl_recv_in_order(void)
+{
+	uint8_t id = 0;
+	while (id < TCL_SUB_PACKET_MAX && TCL_BITMAP_CHECK(m_recv_bitmap, id))
+		++id;
+	return id - 1;
+}
+
+/**@brief Function for loading the flag of a SACK, which echoes the toggle of the packet acknowledged.
+ *
+ * @param[in]   toggle			Toggle flag of the packet.
+ */
+static void tcl_load_sack_flag(uint8_t toggle)
+{
+	TCL_SET_SACK_FLAG(m_send_ack_header.flag);
+	m_send_ack_header.flag |= (uint8_t)(toggle << TCL_HEADER_FLAG_TOGGLE_BIT_POS);
 }
 
 /**@brief Function for processing received packet from the BLE Profile Layer.
@@ -393,28 +588,57 @@ static void tcl_download_recv_packet_payload(uint8_t sequence_id, uint8_t* p_pay
  * @param[in]   length  			Length of the data.
  *
  * @return @ref TCL_SUCCESS				Successfully sent the packet.
+ * @return @ref TCL_WAIT				The AL has not taken the packet before, pass this one again later.
  * @return @ref TCL_ERROR				Common failed.
  * @return @ref TCL_ERROR_DATA_SIZE		Exceed the limit of data size.
  */
 static uint32_t tcl_process_recv_packet(tcl_packet_t* p_packet, uint16_t length)
 {
+	if (0 != m_recv_wait_length)
+		return TCL_WAIT; // The reassembly buffer is taken, the sub-packet waits in the RX buffer queue.
 	uint16_t total_length = p_packet->header.payload_length; 
 	if (total_length > TCL_PAYLOAD_MTU)
 		return TCL_ERROR_DATA_SIZE;
-	uint16_t payload_length = length - TCL_HEADER_LENGTH;
-	tcl_download_recv_packet_payload(p_packet->header.sequence_id, p_packet->payload, payload_length);
+	uint8_t sequence_id = p_packet->header.sequence_id;
+	uint16_t payload_length = tcl_sub_packet_length(sequence_id, total_length);
+	if (0 == payload_length || length < TCL_HEADER_LENGTH + payload_length)
+		return TCL_ERROR_DATA_SIZE;
+	bool is_windowed = TCL_CHECK_SACK_FLAG(p_packet->header.flag) && total_length > BLE_UART_PAYLOAD_MTU;
+	if (is_windowed) {
+		uint8_t toggle = TCL_CHECK_TOGGLE_FLAG(p_packet->header.flag);
+		if (0 == m_recv_data_length_count && toggle == m_recv_done_toggle) {
+			// A late copy of the packet just received, the peer lost the last ACK.
+			m_send_ack_header.sequence_id = m_recv_done_last_id;
+			tcl_load_sack_flag(toggle);
+			return tcl_send_ack_packet();
+		}
+		if (0 != m_recv_data_length_count && toggle != m_recv_toggle)
+			tcl_init_recv_env(); // The peer gave up the previous packet.
+		m_recv_toggle = toggle;
+		m_recv_done_toggle = 0xFF;
+	}
+	tcl_download_recv_packet_payload(sequence_id, p_packet->payload, payload_length);
 	if (m_recv_data_length_count > total_length) { // Error
 		tcl_init_recv_env();
 		return TCL_ERROR;
 	}
+	if (is_windowed) {
+		// A windowed peer waits for the SACK of every sub-packet, a legacy one gets none.
+		m_send_ack_header.sequence_id = tcl_recv_in_order();
+		tcl_load_sack_flag(m_recv_toggle);
+		tcl_send_ack_packet();
+	}
 	if (m_recv_data_length_count == total_length) { // Successfully received the whole application packet
 		// call the application packet handler of Application Layer.
-		uint32_t err_code = al_recv_handler(m_recv_payload, total_length);
-		// Process the error from Application Layer. Initiate the received environment only when succeed.
-		tcl_init_recv_env();
+		if (is_windowed) {
+			m_recv_done_toggle = m_recv_toggle;
+			m_recv_done_last_id = TCL_CALC_SUB_PACKET_NUMBER(total_length) - 1;
+		}
 		tcl_timer_stop(&m_recv_packet_timer);
+		m_recv_wait_length = total_length;
+		tcl_recv_resume(); // The AL may wait for room for the replies, the packet is kept till it takes it.
 	} else {
-		tcl_timer_start(&m_recv_packet_timer); // Start receiving timer for waiting the next packet.
+		tcl_timer_start(&m_recv_packet_timer); // Wait for the next sub-packet, from the last one, not from the first.
 	}
 	// Continue to receive other sub-packets.
 	return TCL_SUCCESS;
@@ -429,6 +653,7 @@ static uint32_t tcl_process_recv_packet(tcl_packet_t* p_packet, uint16_t length)
  * @param[in]   length  		Length of the data.
  *
  * @return @ref TCL_SUCCESS					The packet is valid.
+ * @return @ref TCL_ERROR_DATA_SIZE			Shorter than the header.
  * @return @ref TCL_ERROR_MAGIC_NUMBER		The magic number is wrong.
  * @return @ref TCL_ERROR_VERSION			The version is wrong.
  * @return @ref TCL_ERROR_CHECK_SUM			The checksum is wrong.
@@ -436,13 +661,16 @@ static uint32_t tcl_process_recv_packet(tcl_packet_t* p_packet, uint16_t length)
 static uint32_t tcl_check_recv_packet(uint8_t* p_data, uint16_t length)
 {
 	tcl_packet_t* p_packet = (tcl_packet_t*)p_data;
+	if (length < TCL_HEADER_LENGTH) {
+		return TCL_ERROR_DATA_SIZE;
+	}
 	if (TCL_HEADER_MAGIC_NUMBER != p_packet->header.magic_number) {
 		return TCL_ERROR_MAGIC_NUMBER;
 	}
 	if (TCL_PROTOCOL_VERSION != p_packet->header.version) {
 		return TCL_ERROR_VERSION;
 	}
-	if (0x0000 != checksum((uint16_t*)p_data, length)) {
+	if (p_packet->header.check_sum != checksum(p_data, length)) {
 		return TCL_ERROR_CHECK_SUM;
 	}
 	return TCL_SUCCESS;
@@ -454,21 +682,22 @@ static uint32_t tcl_check_recv_packet(uint8_t* p_data, uint16_t length)
  * @param[in]   length  		Length of the data.
  *
  * @return @ref TCL_SUCCESS		Successfully sent the packet.
+ * @return @ref TCL_WAIT		The AL has not taken the packet before, pass this one again after tcl_recv_resume().
  * @return @ref TCL_ERROR		Common failed.
  */
 uint32_t tcl_recv_packet(uint8_t* p_data, uint16_t length)
 {
 	uint32_t err_code = tcl_check_recv_packet(p_data, length);
-	TCL_UNSET_FLAG(m_send_ack_packet.header.flag);
+	TCL_UNSET_FLAG(m_send_ack_header.flag);
 	if (TCL_SUCCESS != err_code) {
-		TCL_SET_ERR_FLAG(m_send_ack_packet.header.flag);
+		TCL_SET_ERR_FLAG(m_send_ack_header.flag);
 		return tcl_send_ack_packet();
 	}
 	//tcl_send_ack_packet();            /*<Modified by @Mida>TCL recv packet don't need to reply an ack packet at once!*/
 	tcl_packet_t* p_packet = (tcl_packet_t*)p_data;
 	if (true == tcl_is_ack_packet(p_packet)) {
 		 // Received a ACK packet.
-		 return tcl_process_recv_ack(*p_packet);
+		 return tcl_process_recv_ack(p_packet);
 	} else {
 		 // Received a data packet.
 		 return tcl_process_recv_packet(p_packet, length);
@@ -486,33 +715,33 @@ uint32_t tcl_recv_packet(uint8_t* p_data, uint16_t length)
  */
  void tcl_timer_time_out(void)
 {
-	if (TCL_TIMER_START == m_send_sub_packet_timer.status) { // If the sub-packet timer is started.
+	if (tcl_timer_expired(&m_send_sub_packet_timer, m_rtt.rto)) { // No ACK within the RTO.
+		m_rtt.timeouts++;
 		if (m_send_sub_packet_timer.count++ >= TCL_RESEND_MAX_TIMES) { // Failed to send ACK packet.
 			//tcl_timer_stop(&m_send_sub_packet_timer);
 			tcl_send_failed(); // Failed for time-out;
 			tcl_timer_stop(&m_send_sub_packet_timer);
 		} else {
-			tcl_send_sub_packet(); // Just send again the previous sub-packet.
+			m_rtt.rto = MIN(2 * m_rtt.rto, TCL_RTO_MAX); // Back off until the next sample.
+			memset(m_send_resent, 0, TCL_SACK_BITMAP_LENGTH);
+			tcl_resend_lost(m_send_next, false); // Just send again the sub-packets in flight.
 		}
 	}
-	if (TCL_TIMER_START == m_recv_packet_timer.status) { // If the recveiving timer is started.
-		if (m_recv_packet_timer.count++ >= TCL_RECV_WAIT_MAX_TIMES) { // Failed to receive packet.
-			tcl_timer_stop(&m_recv_packet_timer);
-			tcl_init_recv_env();
-		}
+	if (tcl_timer_expired(&m_recv_packet_timer, TCL_RECV_WAIT_TIME)) { // Failed to receive packet.
+		tcl_timer_stop(&m_recv_packet_timer);
+		tcl_init_recv_env();
 	}
 }
 
 
-/**@brief Function for initializing the TCL Packet Structure.
+/**@brief Function for initializing the TCL Packet Headers.
  *
  */
 static void tcl_packet_init()
 {
-	tcl_header_init(&m_send_ack_packet.header);
-	tcl_header_init(&m_send_packet.header);
-	memset(&m_send_packet.payload, 0, BLE_UART_PAYLOAD_MTU);
-	memset(&m_send_packet.payload, 0, BLE_UART_PAYLOAD_MTU);
+	tcl_header_init(&m_send_ack_header);
+	tcl_header_init(&m_send_header);
+	m_send_window = 1;
 }
 
 /**@brief Function for initializing timers.
@@ -534,8 +763,34 @@ void tcl_init(tcl_init_t* p_init)
 	al_recv_handler = p_init->al_recv_handler;
 	al_send_failed_handler = p_init->al_send_failed_handler;
 	al_send_success_handler = p_init->al_send_success_handler;
+	time_handler = p_init->time_handler;
+	tcl_rtt_init();
 	tcl_packet_init();
 	tcl_init_recv_env();
 	tcl_timer_init();
 }
 
+/**@brief Function for dropping the packets on the way, the RTT estimate and the window of the peer, when the link is gone.
+ *
+ * @note A packet being sent is failed to the AL.
+ */
+void tcl_reset(void)
+{
+	tcl_timer_stop(&m_send_sub_packet_timer);
+	tcl_timer_stop(&m_recv_packet_timer);
+	if (TCL_SEND_STATUS_SENDING == m_send_status)
+		tcl_send_failed();
+	tcl_init_recv_env();
+	m_recv_done_toggle = 0xFF;
+	m_send_window = 1; // The next peer may be a legacy one, stop-and-wait until its first ACK.
+	tcl_rtt_init();
+}
+
+/**@brief Function for getting the round-trip time estimate.
+ *
+ * @param[out]  p_rtt			Pointer to the estimate.
+ */
+void tcl_get_rtt(tcl_rtt_t* p_rtt)
+{
+	*p_rtt = m_rtt;
+}
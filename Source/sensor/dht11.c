@@ -1,130 +1,257 @@
 #include <dht11.h>
 #include <delay.h>
+#include <pm25.h>
+#include <app_timer.h>
+#include <nrf_gpiote.h>
+#include <nrf_soc.h>
+#include <ble_config.h>
+#include <calendar.h>
+
+typedef enum {
+	DHT11_IDLE = 0,
+	DHT11_START,                    //The start signal holds the line low.
+	DHT11_CAPTURE                   //The line is released, edges are captured.
+} DHT11_STATE;
 
-uint8_t U8FLAG, U8temp;
-uint8_t U8T_data_H, U8T_data_L, U8RH_data_H, U8RH_data_L, U8checkdata;
-uint8_t U8T_data_H_temp, U8T_data_L_temp, U8RH_data_H_temp, U8RH_data_L_temp, U8checkdata_temp;
-uint8_t U8comdata;
 float   temp,humi;
-static float sfDht11Queue[DHT11_QUEUE_LENGTH][2];
-static int snDht11QueueIndex = 0;
+static int32_t snDht11TemperatureBuffer[FILTER_BUFFER_LENGTH(DHT11_FILTER, DHT11_QUEUE_LENGTH)];
+static int32_t snDht11HumidityBuffer[FILTER_BUFFER_LENGTH(DHT11_FILTER, DHT11_QUEUE_LENGTH)];
+static Filter sDht11TemperatureFilter;
+static Filter sDht11HumidityFilter;
+static Dht11Cache sDht11Cache;                  //The only copy the other modules read.
+
+static app_timer_id_t sDht11TimerId;
+static volatile DHT11_STATE sDht11State = DHT11_IDLE;
+static Dht11Handler sDht11Handler = NULL;
+static uint16_t snDht11Edges[DHT11_EDGE_COUNT];
+static volatile uint8_t snDht11EdgeCount = 0;
+static volatile bool sbDht11EdgeLate = false;   //A capture was overwritten before it was read.
+static Dht11Statistics sDht11Statistics;
 
 
-static __INLINE void InsertDht11Queue(float temperature, float humidity)
+static __INLINE void InsertDht11Filter(float temperature, float humidity)
 {
-	sfDht11Queue[snDht11QueueIndex][0] = temperature;
-	sfDht11Queue[snDht11QueueIndex][1] = humidity;
-	if (DHT11_QUEUE_LENGTH == ++snDht11QueueIndex) {
-		snDht11QueueIndex = 0;
+	int32_t nTemperature = (int32_t)temperature * DHT11_SCALE;     //The DHT11 has no decimals.
+	int32_t nHumidity = (int32_t)humidity * DHT11_SCALE;
+	if (IsFilterEmpty(&sDht11TemperatureFilter)) {
+		FilterFill(&sDht11TemperatureFilter, nTemperature);          //One reading is enough to start the average.
+		FilterFill(&sDht11HumidityFilter, nHumidity);
+	} else {
+		FilterInsert(&sDht11TemperatureFilter, nTemperature);
+		FilterInsert(&sDht11HumidityFilter, nHumidity);
 	}
 }
 
-static __INLINE void FullDHT11Queue()
+bool IsDht11CacheFresh(void)
+{
+	if (!sDht11Cache.bValid)
+		return false;
+	return GetCalendarUptime() - sDht11Cache.uUptime < DHT11_CACHE_INTERVAL;
+}
+
+uint32_t Dht11DecodeFrame(const uint16_t *pEdges, uint8_t nEdges, uint8_t *pFrame)
 {
-	for (int i = 0; i < DHT11_QUEUE_LENGTH; ++i) {
-		GetDht11(&temp,&humi);
+	if (nEdges < DHT11_FRAME_EDGES)
+		return NRF_ERROR_INVALID_LENGTH;
+	for (int i = 0; i < DHT11_FRAME_LENGTH; ++i)
+		pFrame[i] = 0;
+	for (int i = 0; i < DHT11_FRAME_LENGTH * 8; ++i) {
+		//Edge 3 + 2i is the rising edge of bit i, the next one ends it. The 16bit timer may wrap.
+		uint16_t nLow = (uint16_t)(pEdges[3 + 2 * i] - pEdges[2 + 2 * i]);
+		uint16_t nHigh = (uint16_t)(pEdges[4 + 2 * i] - pEdges[3 + 2 * i]);
+		if (nLow < DHT11_LOW_MIN_WIDTH || nLow > DHT11_LOW_MAX_WIDTH || nHigh > DHT11_BIT_MAX_WIDTH)
+			return NRF_ERROR_INVALID_DATA;           //A missed edge swaps the lows and the highs.
+		pFrame[i >> 3] = (pFrame[i >> 3] << 1) | ((nHigh > DHT11_BIT_THRESHOLD) ? 1 : 0);
 	}
+	uint8_t uChecksum = pFrame[0] + pFrame[1] + pFrame[2] + pFrame[3];
+	if (uChecksum != pFrame[4])
+		return NRF_ERROR_INVALID_STATE;
+	return NRF_SUCCESS;
+}
+
+/**@brief GPIOTE interrupt, the DHT11 is its only user. The edge time is already in DHT11_TIMER->CC[DHT11_TIMER_CC] through the PPI.
+ *
+ * @note The IN channel sees every edge by itself, only the copy of the capture has to be done before the next edge.
+ *       Edge 2n is falling and 2n+1 rising, so a line at the wrong level, or the same capture twice, tells a late copy.
+ */
+void GPIOTE_IRQHandler(void)
+{
+	if (0 == NRF_GPIOTE->EVENTS_IN[DHT11_GPIOTE_CHANNEL])
+		return;
+	NRF_GPIOTE->EVENTS_IN[DHT11_GPIOTE_CHANNEL] = 0;
+	uint32_t uLevel = GpioRead(DHT11_PIN);
+	uint16_t nEdge = (uint16_t)DHT11_TIMER->CC[DHT11_TIMER_CC];
+	if (DHT11_CAPTURE != sDht11State)
+		return;
+	if (0 == snDht11EdgeCount && 0 != uLevel)
+		return;                                 //Our own release of the line, the frame starts falling.
+	if ((snDht11EdgeCount & 1) != uLevel || (0 != snDht11EdgeCount && nEdge == snDht11Edges[snDht11EdgeCount - 1]))
+		sbDht11EdgeLate = true;
+	if (snDht11EdgeCount < DHT11_EDGE_COUNT)
+		snDht11Edges[snDht11EdgeCount++] = nEdge;
 }
 
-static __INLINE void Dht11DelayOneUs(unsigned int us)
-{   
-	DelayUs(us); 
+static void Dht11StopCapture(void)
+{
+	NRF_GPIOTE->INTENCLR = GPIOTE_INTENCLR_IN0_Msk << DHT11_GPIOTE_CHANNEL;
+	nrf_gpiote_unconfig(DHT11_GPIOTE_CHANNEL);
+	sd_ppi_channel_enable_clr(1 << DHT11_PPI_CAPTURE);
+	DHT11_TIMER->TASKS_STOP = 1;
+	GpioConfig(DHT11_PIN, OUTPUT);
+	GpioWrite(DHT11_PIN, ON);                   //Idle high until the next start signal.
 }
 
-static __INLINE void Dht11DelayOneMs(unsigned int ms)
+static void Dht11StartCapture(void)
 {
-	while(ms--)
-	{
-		DelayUs(1000);
+	sd_ppi_channel_enable_clr(PM25_PPI_MASK);   //The last PM2.5 period ended during the start signal.
+	DHT11_TIMER->TASKS_STOP = 1;
+	DHT11_TIMER->MODE = TIMER_MODE_MODE_Timer;
+	DHT11_TIMER->BITMODE = TIMER_BITMODE_BITMODE_16Bit;
+	DHT11_TIMER->PRESCALER = 4;                 //1 tick == 1us
+	DHT11_TIMER->SHORTS = 0;
+	DHT11_TIMER->INTENCLR = 0xFFFFFFFF;
+	DHT11_TIMER->TASKS_CLEAR = 1;
+	sd_ppi_channel_assign(DHT11_PPI_CAPTURE, &NRF_GPIOTE->EVENTS_IN[DHT11_GPIOTE_CHANNEL], &DHT11_TIMER->TASKS_CAPTURE[DHT11_TIMER_CC]);
+	sd_ppi_channel_enable_set(1 << DHT11_PPI_CAPTURE);
+	DHT11_TIMER->TASKS_START = 1;
+
+	snDht11EdgeCount = 0;
+	sbDht11EdgeLate = false;
+	sDht11State = DHT11_CAPTURE;
+	nrf_gpiote_event_config(DHT11_GPIOTE_CHANNEL, DHT11_PIN, NRF_GPIOTE_POLARITY_TOGGLE);
+	NRF_GPIOTE->EVENTS_IN[DHT11_GPIOTE_CHANNEL] = 0;
+	NRF_GPIOTE->INTENSET = GPIOTE_INTENSET_IN0_Msk << DHT11_GPIOTE_CHANNEL;
+	GpioConfig(DHT11_PIN, INPUT);               //Release the line, the pull-up ends the start signal.
+}
+
+static void Dht11Complete(void)
+{
+	uint8_t uFrame[DHT11_FRAME_LENGTH];
+	uint32_t uErrCode = Dht11DecodeFrame(snDht11Edges, snDht11EdgeCount, uFrame);
+	if (sbDht11EdgeLate) {
+		sDht11Statistics.uLateEdges++;
+		uErrCode = NRF_ERROR_INVALID_DATA;      //The widths around the late edge are wrong, even if the checksum holds.
+	}
+	bool bValid = (NRF_SUCCESS == uErrCode);
+
+	sDht11Statistics.uReads++;
+	if (NRF_ERROR_INVALID_STATE == uErrCode)
+		sDht11Statistics.uChecksumErrors++;
+	else if (!bValid)
+		sDht11Statistics.uFrameErrors++;
+
+	if (bValid) {
+		temp = (float)uFrame[2];
+		humi = (float)uFrame[0];
+		InsertDht11Filter(temp, humi);
+		sDht11Cache.temperature = temp;
+		sDht11Cache.humidity = humi;
+		sDht11Cache.uUptime = GetCalendarUptime();
+		sDht11Cache.bValid = true;
 	}
+	sDht11State = DHT11_IDLE;
+	if (NULL != sDht11Handler)
+		sDht11Handler(bValid, temp, humi);       //Read error, the data of last time is passed on.
 }
 
-static __INLINE void Dht11ReadValue(void)
-{     
-	uint8_t i;  
-	for(i=0;i<8;i++)    
-	{
-		U8FLAG=2; 
-		GpioConfig(DHT11_PIN,OUTPUT);
-		GpioWrite(DHT11_PIN, OFF);
+static void Dht11TimeoutHandler(void *pContext)
+{
+	switch (sDht11State) {
+	case DHT11_START:
+		Dht11StartCapture();
+		app_timer_start(sDht11TimerId, APP_TIMER_TICKS(DHT11_FRAME_TIME, APP_TIMER_PRESCALER), NULL);
+		break;
+	case DHT11_CAPTURE:
+		Dht11StopCapture();
+		Dht11Complete();
+		break;
+	default:
+		break;
+	}
+}
+
+uint32_t StartDht11(Dht11Handler handler)
+{
+	if (DHT11_IDLE != sDht11State || IsPm25Busy()) {
+		sDht11Statistics.uBusy++;
+		return NRF_ERROR_BUSY;                  //DHT11_TIMER and the PPI channel are shared with the PM2.5.
+	}
+	sDht11Handler = handler;
+	sDht11State = DHT11_START;
+	GpioConfig(DHT11_PIN, OUTPUT);
+	GpioWrite(DHT11_PIN, OFF);
+	uint32_t uErrCode = app_timer_start(sDht11TimerId, APP_TIMER_TICKS(DHT11_START_TIME, APP_TIMER_PRESCALER), NULL);
+	if (NRF_SUCCESS != uErrCode) {
 		GpioWrite(DHT11_PIN, ON);
-		GpioConfig(DHT11_PIN,INPUT);
-		while((!GpioRead(DHT11_PIN))&&U8FLAG++);
-		Dht11DelayOneUs(30);
-		U8temp=0;
-		if(GpioRead(DHT11_PIN)) U8temp=1;
-		U8FLAG=2;
-		while(GpioRead(DHT11_PIN)&&U8FLAG++);   
-		if(U8FLAG==1) break;    
-		U8comdata<<=1;
-		U8comdata|=U8temp; 
-	}    
+		sDht11State = DHT11_IDLE;
+	}
+	return uErrCode;
+}
+
+void StopDht11(void)
+{
+	if (DHT11_IDLE == sDht11State)
+		return;
+	app_timer_stop(sDht11TimerId);
+	Dht11StopCapture();                         //Also ends a start signal, the line goes back high.
+	sDht11Handler = NULL;
+	sDht11State = DHT11_IDLE;
+}
+
+bool IsDht11Busy(void)
+{
+	return DHT11_IDLE != sDht11State;
+}
+
+void GetDht11Statistics(Dht11Statistics *pStatistics)
+{
+	*pStatistics = sDht11Statistics;
 }
 
 void GetDht11(float *temperature, float *humidity)
 {
-	GpioConfig(DHT11_PIN,OUTPUT);
-	GpioWrite(DHT11_PIN, ON);
-	Dht11DelayOneMs(100);
-	GpioWrite(DHT11_PIN, OFF);
-	Dht11DelayOneMs(20);
-	GpioWrite(DHT11_PIN, ON);
-	GpioConfig(DHT11_PIN,INPUT);
-	Dht11DelayOneUs(40);
-	if(!GpioRead(DHT11_PIN)) {
-		U8FLAG=2;
-		while((!GpioRead(DHT11_PIN))&&U8FLAG++);
-		U8FLAG=2;
-		while((GpioRead(DHT11_PIN))&&U8FLAG++); 
-		Dht11ReadValue();
-		U8RH_data_H_temp=U8comdata;
-		Dht11ReadValue();
-		U8RH_data_L_temp=U8comdata;
-		Dht11ReadValue();
-		U8T_data_H_temp=U8comdata;
-		Dht11ReadValue();
-		U8T_data_L_temp=U8comdata;
-		Dht11ReadValue();
-		U8checkdata_temp=U8comdata;
-		GpioConfig(DHT11_PIN,OUTPUT);
-		GpioWrite(DHT11_PIN,1);
-		U8temp=(U8T_data_H_temp+U8T_data_L_temp+U8RH_data_H_temp+U8RH_data_L_temp);
-		if(U8temp==U8checkdata_temp) {
-			U8RH_data_H=U8RH_data_H_temp;
-			U8RH_data_L=U8RH_data_L_temp;
-			U8T_data_H=U8T_data_H_temp;
-			U8T_data_L=U8T_data_L_temp;
-			U8checkdata=U8checkdata_temp;
-		}
-		*temperature=(float)U8T_data_H;
-		*humidity=(float)U8RH_data_H;
-	} else {  
-      *temperature=temp;            //Read error ,use the data of last time
-      *humidity=humi;
-	} 
-	InsertDht11Queue(*temperature,*humidity);
+	*temperature = temp;
+	*humidity = humi;
+}
+
+bool GetCachedDht11(float *temperature, float *humidity)
+{
+	bool bRead = !IsDht11CacheFresh() && (NRF_SUCCESS == StartDht11(NULL));
+	*temperature = sDht11Cache.temperature;
+	*humidity = sDht11Cache.humidity;
+	return bRead;
+}
+
+void GetDht11Cache(Dht11Cache *pCache)
+{
+	*pCache = sDht11Cache;
 }
 
 void InitDht11(void)                                            //Initializing the DHT11
 {
+		GpioConfig(DHT11_PIN, OUTPUT);
+		GpioWrite(DHT11_PIN, ON);
+		InitFilter(&sDht11TemperatureFilter, DHT11_FILTER, snDht11TemperatureBuffer, DHT11_QUEUE_LENGTH);
+		InitFilter(&sDht11HumidityFilter, DHT11_FILTER, snDht11HumidityBuffer, DHT11_QUEUE_LENGTH);
+		app_timer_create(&sDht11TimerId, APP_TIMER_MODE_SINGLE_SHOT, Dht11TimeoutHandler);
+		sd_nvic_ClearPendingIRQ(GPIOTE_IRQn);
+		sd_nvic_SetPriority(GPIOTE_IRQn, NRF_APP_PRIORITY_HIGH);   //Before the app_timer and the other sensors.
+		sd_nvic_EnableIRQ(GPIOTE_IRQn);
 		DelayMs(DHT11_INIT_TIME);
-		FullDHT11Queue();
+		StartDht11(NULL);                       //The filters are filled by the first reading.
 }
 
 
 void GetAverageDht11(float *temperature, float *humidity)				//Get the average of DHT11
 {
-		GetDht11(&temp,&humi);
-		float fRet[2] = {0};
-		for (int i = 0; i < DHT11_QUEUE_LENGTH; ++i) 
-		{
-			fRet[0] += sfDht11Queue[i][0];
-			fRet[1] += sfDht11Queue[i][1];
-		}	
-		*temperature = fRet[0] / DHT11_QUEUE_LENGTH;
-		*humidity = fRet[1] / DHT11_QUEUE_LENGTH;
+		float fTemperature, fHumidity;
+		GetCachedDht11(&fTemperature,&fHumidity);          //The filters only move when the cache is out of date.
+		GetDht11QueueAverage(temperature, humidity);
 }
 
-
-
+void GetDht11QueueAverage(float *temperature, float *humidity)
+{
+		*temperature = (float)FilterOutput(&sDht11TemperatureFilter) / DHT11_SCALE;
+		*humidity = (float)FilterOutput(&sDht11HumidityFilter) / DHT11_SCALE;
+}
 
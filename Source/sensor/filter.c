@@ -0,0 +1,115 @@
+#include <nrf.h>
+#include <filter.h>
+
+static __INLINE int32_t FilterDivide(int32_t nValue, int32_t nDivisor)  //Rounded to the nearest
+{
+	return (nValue >= 0) ? (nValue + nDivisor / 2) / nDivisor : (nValue - nDivisor / 2) / nDivisor;
+}
+
+/**@brief Replace nOld by nNew in the sorted window, shifting only the samples between them.
+ */
+static void FilterSortedReplace(Filter *pFilter, int32_t nOld, int32_t nNew)
+{
+	int32_t *pSorted = pFilter->pSorted;
+	int i = 0;
+	while (pSorted[i] != nOld)
+		++i;
+	while (i > 0 && pSorted[i - 1] > nNew) {
+		pSorted[i] = pSorted[i - 1];
+		--i;
+	}
+	while (i < pFilter->nCount - 1 && pSorted[i + 1] < nNew) {
+		pSorted[i] = pSorted[i + 1];
+		++i;
+	}
+	pSorted[i] = nNew;
+}
+
+static void FilterSortedInsert(Filter *pFilter, int32_t nNew)
+{
+	int32_t *pSorted = pFilter->pSorted;
+	int i = pFilter->nCount;                        //nCount is not yet counting nNew.
+	while (i > 0 && pSorted[i - 1] > nNew) {
+		pSorted[i] = pSorted[i - 1];
+		--i;
+	}
+	pSorted[i] = nNew;
+}
+
+void InitFilter(Filter *pFilter, FILTER_TYPE type, int32_t *pBuffer, uint8_t nLength)
+{
+	pFilter->type = type;
+	pFilter->nLength = nLength;
+	pFilter->nIndex = 0;
+	pFilter->nCount = 0;
+	pFilter->pWindow = pBuffer;
+	pFilter->pSorted = (FILTER_MEDIAN == type) ? pBuffer + nLength : 0;
+	pFilter->nSum = 0;
+	pFilter->nEma = 0;
+	pFilter->nEmaShift = 0;
+	while ((1u << (pFilter->nEmaShift + 1)) <= nLength)
+		pFilter->nEmaShift++;
+}
+
+int32_t FilterInsert(Filter *pFilter, int32_t nSample)
+{
+	if (FILTER_EMA == pFilter->type) {
+		if (0 == pFilter->nCount) {
+			pFilter->nEma = nSample * (1 << FILTER_EMA_Q);
+			pFilter->nCount = 1;
+		} else {
+			pFilter->nEma += ((nSample * (1 << FILTER_EMA_Q)) - pFilter->nEma) >> pFilter->nEmaShift;
+		}
+		return FilterOutput(pFilter);
+	}
+
+	bool bFull = (pFilter->nCount == pFilter->nLength);
+	int32_t nOld = pFilter->pWindow[pFilter->nIndex];
+	pFilter->pWindow[pFilter->nIndex] = nSample;
+	if (++pFilter->nIndex == pFilter->nLength)
+		pFilter->nIndex = 0;
+
+	if (FILTER_MEAN == pFilter->type) {
+		pFilter->nSum += nSample - (bFull ? nOld : 0);
+	} else if (bFull) {
+		FilterSortedReplace(pFilter, nOld, nSample);
+	} else {
+		FilterSortedInsert(pFilter, nSample);
+	}
+	if (!bFull)
+		pFilter->nCount++;
+	return FilterOutput(pFilter);
+}
+
+void FilterFill(Filter *pFilter, int32_t nSample)
+{
+	pFilter->nIndex = 0;
+	pFilter->nCount = (FILTER_EMA == pFilter->type) ? 1 : pFilter->nLength;
+	pFilter->nSum = nSample * pFilter->nLength;
+	pFilter->nEma = nSample * (1 << FILTER_EMA_Q);
+	for (int i = 0; i < FILTER_BUFFER_LENGTH(pFilter->type, pFilter->nLength) && FILTER_EMA != pFilter->type; ++i)
+		pFilter->pWindow[i] = nSample;
+}
+
+int32_t FilterOutput(const Filter *pFilter)
+{
+	if (0 == pFilter->nCount)
+		return 0;
+	switch (pFilter->type) {
+	case FILTER_MEAN:
+		return FilterDivide(pFilter->nSum, pFilter->nCount);
+	case FILTER_MEDIAN:
+		if (pFilter->nCount & 1)
+			return pFilter->pSorted[pFilter->nCount >> 1];
+		return FilterDivide(pFilter->pSorted[(pFilter->nCount >> 1) - 1] + pFilter->pSorted[pFilter->nCount >> 1], 2);
+	case FILTER_EMA:
+	default:
+		return FilterDivide(pFilter->nEma, 1 << FILTER_EMA_Q);
+	}
+}
+
+bool IsFilterEmpty(const Filter *pFilter)
+{
+	return 0 == pFilter->nCount;
+}
+
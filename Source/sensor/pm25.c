@@ -2,66 +2,181 @@
 #include <delay.h>
 #include <gpio.h>
 #include <pin.h>
+#include <dht11.h>
+#include <nrf_gpiote.h>
+#include <nrf_soc.h>
 
-static float sfPm25Queue[PM25_QUEUE_LENGTH];
-static int snPm25QueueIndex = 0;
+static int32_t snPm25FilterBuffer[FILTER_BUFFER_LENGTH(PM25_FILTER, PM25_QUEUE_LENGTH)];
+static Filter sPm25Filter;
+static int32_t snPm25Last = PM25_MIN;
 
-static __INLINE float Pm25Value(float fPm25Voltage)
+static volatile bool sbPm25Busy = false;        //A burst owns PM25_TIMER, the PPI channels and the ADC.
+static uint8_t snPm25BurstLength = 0;
+static uint8_t snPm25BurstSamples = 0;          //Samples of the running burst already in the queue.
+static uint8_t snPm25BurstId = 0;               //Passed to the ADC, samples of a stopped burst do not count.
+static volatile uint8_t snPm25BurstCycles = 0;  //Pulse periods finished by PM25_TIMER.
+static Pm25BurstHandler sPm25BurstHandler = NULL;
+static Pm25Statistics sPm25Statistics;
+
+static __INLINE int32_t Pm25Value(uint32_t uAdcValue)      //In 1/PM25_SCALE ug/m3
 {
-	float fRet = (fPm25Voltage - PM25_VOLTAGE_WITH_NO_DUST) * PM25_K;
-	if (fRet > PM25_MAX)
-		fRet = PM25_MAX;
-	else if (fRet < PM25_MIN)
-		fRet = PM25_MIN;
-	return fRet;
+	int32_t nMv = (int32_t)(uAdcValue * ADC_FULL_SCALE_MV / (uint32_t)ADC_COUNT_MAX);
+	int32_t nRet = (nMv - PM25_NO_DUST_MV) * PM25_K_X100 / (100000 / PM25_SCALE);
+	if (nRet > PM25_MAX * PM25_SCALE)
+		nRet = PM25_MAX * PM25_SCALE;
+	else if (nRet < PM25_MIN * PM25_SCALE)
+		nRet = PM25_MIN * PM25_SCALE;
+	return nRet;
 }
 
-static __INLINE void FullPm25Queue()
+/**@brief One pulse period on PM25_TIMER:
+ *
+ *   CC[0] PM25_PULSE_START              GPIOTE toggles the LED on.
+ *   CC[1] + PM25_SAMPLE_TIME (280us)    PPI starts the ADC.
+ *   CC[2] + PM25_PULSE_WIDTH (320us)    GPIOTE toggles the LED off.
+ *   CC[3] PM25_PERIOD (10ms)            Timer clears, the next pulse follows without the CPU.
+ */
+static void Pm25TimerConfig(void)
 {
-	for (int i = 0; i < PM25_QUEUE_LENGTH; ++i) {
-		GetPm25();
-	}
+	PM25_TIMER->TASKS_STOP = 1;
+	PM25_TIMER->TASKS_CLEAR = 1;
+	PM25_TIMER->MODE = TIMER_MODE_MODE_Timer;
+	PM25_TIMER->BITMODE = TIMER_BITMODE_BITMODE_16Bit;
+	PM25_TIMER->PRESCALER = 4;                              //1 tick == 1us
+	PM25_TIMER->CC[0] = PM25_PULSE_START;
+	PM25_TIMER->CC[1] = PM25_PULSE_START + PM25_SAMPLE_TIME;
+	PM25_TIMER->CC[2] = PM25_PULSE_START + PM25_PULSE_WIDTH;
+	PM25_TIMER->CC[3] = PM25_PERIOD;
+	PM25_TIMER->INTENCLR = 0xFFFFFFFF;
+
+	//Assigned for every burst, the DHT11 capture borrows the timer and PM25_PPI_PULSE_OFF.
+	sd_ppi_channel_assign(PM25_PPI_PULSE_ON, &PM25_TIMER->EVENTS_COMPARE[0], &NRF_GPIOTE->TASKS_OUT[PM25_GPIOTE_CHANNEL]);
+	sd_ppi_channel_assign(PM25_PPI_SAMPLE, &PM25_TIMER->EVENTS_COMPARE[1], &NRF_ADC->TASKS_START);
+	sd_ppi_channel_assign(PM25_PPI_PULSE_OFF, &PM25_TIMER->EVENTS_COMPARE[2], &NRF_GPIOTE->TASKS_OUT[PM25_GPIOTE_CHANNEL]);
+}
+
+/**@brief Called by the ADC driver once the ADC waits for the PPI, start the pulses.
+ */
+static void Pm25ArmHandler(void *pContext)
+{
+	//The GPIOTE channel starts from the OFF level so every period is ON then OFF.
+	Pm25TimerConfig();
+	nrf_gpiote_task_config(PM25_GPIOTE_CHANNEL, PM25_PULSE_PIN, NRF_GPIOTE_POLARITY_TOGGLE,
+	                       (PM25_PULSE_OFF) ? NRF_GPIOTE_INITIAL_VALUE_HIGH : NRF_GPIOTE_INITIAL_VALUE_LOW);
+	snPm25BurstCycles = 0;
+	PM25_TIMER->TASKS_CLEAR = 1;
+	PM25_TIMER->EVENTS_COMPARE[3] = 0;
+	PM25_TIMER->SHORTS = TIMER_SHORTS_COMPARE3_CLEAR_Msk
+	                   | ((1 == snPm25BurstLength) ? TIMER_SHORTS_COMPARE3_STOP_Msk : 0);
+	PM25_TIMER->INTENSET = TIMER_INTENSET_COMPARE3_Msk;
+	sd_ppi_channel_enable_set(PM25_PPI_MASK);
+	PM25_TIMER->TASKS_START = 1;
+}
+
+static void Pm25AdcHandler(uint32_t uAdcValue, void *pContext)
+{
+	snPm25Last = Pm25Value(uAdcValue);
+	if (IsFilterEmpty(&sPm25Filter))
+		FilterFill(&sPm25Filter, snPm25Last);
+	else
+		FilterInsert(&sPm25Filter, snPm25Last);
+	sPm25Statistics.uSamples++;
+
+	if (!sbPm25Busy || (uint8_t)(uintptr_t)pContext != snPm25BurstId)
+		return;
+	if (++snPm25BurstSamples < snPm25BurstLength)
+		return;
+	sbPm25Busy = false;
+	sPm25Statistics.uBursts++;
+	if (NULL != sPm25BurstHandler)
+		sPm25BurstHandler(GetAveragePM25Filter());
 }
 
-static __INLINE void InsertPm25Queue(float fPm25Value)
+void PM25_TIMER_IRQHandler(void)
 {
-	sfPm25Queue[snPm25QueueIndex++] = fPm25Value;
-	if (PM25_QUEUE_LENGTH == snPm25QueueIndex) {
-		snPm25QueueIndex = 0;
+	if (0 == PM25_TIMER->EVENTS_COMPARE[3])
+		return;
+	PM25_TIMER->EVENTS_COMPARE[3] = 0;
+
+	++snPm25BurstCycles;
+	if (snPm25BurstCycles + 1 == snPm25BurstLength) {
+		PM25_TIMER->SHORTS |= TIMER_SHORTS_COMPARE3_STOP_Msk;   //The running period is the last one.
+	} else if (snPm25BurstCycles >= snPm25BurstLength) {
+		PM25_TIMER->INTENCLR = TIMER_INTENCLR_COMPARE3_Msk;     //Stopped by the short, the LED is off.
+		sd_ppi_channel_enable_clr(PM25_PPI_MASK);
 	}
 }
 
 void InitPm25(void)
 {
 	GpioConfig(PM25_PULSE_PIN, OUTPUT);
-	GpioWrite(PM25_PULSE_PIN, ON);
+	GpioWrite(PM25_PULSE_PIN, PM25_PULSE_OFF);
+	InitFilter(&sPm25Filter, PM25_FILTER, snPm25FilterBuffer, PM25_QUEUE_LENGTH);
+	sd_nvic_ClearPendingIRQ(PM25_TIMER_IRQn);
+	sd_nvic_SetPriority(PM25_TIMER_IRQn, NRF_APP_PRIORITY_LOW);
+	sd_nvic_EnableIRQ(PM25_TIMER_IRQn);
 	DelayMs(PM25_INIT_TIME);
-	FullPm25Queue();
+	StartPm25Burst(PM25_QUEUE_LENGTH, NULL);    //Fills the filter in the background.
+}
+
+uint32_t StartPm25Burst(uint8_t nCount, Pm25BurstHandler handler)
+{
+	if (0 == nCount)
+		return NRF_ERROR_INVALID_PARAM;
+	if (sbPm25Busy || IsDht11Busy()) {
+		sPm25Statistics.uBusy++;
+		return NRF_ERROR_BUSY;
+	}
+	sbPm25Busy = true;                          //Owns PM25_TIMER until the last sample is in.
+	snPm25BurstLength = nCount;
+	snPm25BurstSamples = 0;
+	sPm25BurstHandler = handler;
+
+	AdcRequest request;
+	request.uAdcNumber = PM25_ADC_NUMBER;
+	request.nTriggerCount = nCount;
+	request.handler = Pm25AdcHandler;
+	request.armHandler = Pm25ArmHandler;
+	request.pContext = (void *)(uintptr_t)snPm25BurstId;
+	uint32_t uErrCode = QueueAdcRequest(&request);
+	if (NRF_SUCCESS != uErrCode)
+		sbPm25Busy = false;
+	return uErrCode;
+}
+
+void StopPm25Burst(void)
+{
+	if (!sbPm25Busy)
+		return;
+	snPm25BurstId++;
+	sPm25BurstHandler = NULL;
+	sPm25Statistics.uStopped++;
+	sbPm25Busy = false;
+}
+
+bool IsPm25Busy(void)
+{
+	return sbPm25Busy;
+}
+
+void GetPm25Statistics(Pm25Statistics *pStatistics)
+{
+	*pStatistics = sPm25Statistics;
 }
 
 float GetPm25(void)
 {
-	GpioWrite(PM25_PULSE_PIN, PM25_PULSE_ON);
-	DelayUs(PM25_SAMPLE_TIME);
-	OpenAdc(PM25_ADC_NUMBER);
-	uint32_t uPm25Adc = GetAdcValue();
-	DelayUs(PM25_SAMPLE_LEFT);
-	GpioWrite(PM25_PULSE_PIN, PM25_PULSE_OFF);
-	DelayUs(PM25_LOW_TIME);
-	float fPm25Voltage = GetVoltageByValue(uPm25Adc);
-	float fPm25Value = Pm25Value(fPm25Voltage);
-	InsertPm25Queue(fPm25Value);
-	return fPm25Value;
+	return (float)snPm25Last / PM25_SCALE;
+}
+
+float GetAveragePM25Filter(void)
+{
+	return (float)FilterOutput(&sPm25Filter) / PM25_SCALE;
 }
 
 float GetAveragePM25(void)
 {
-	GetPm25();
-	float fRet = 0.0;
-	for (int i = 0; i < PM25_QUEUE_LENGTH; ++i) {
-		fRet += sfPm25Queue[i];
-	}
-	fRet /= PM25_QUEUE_LENGTH;
-	return fRet;
+	StartPm25Burst(1, NULL);          //The sample joins the filter when the pulse is over.
+	return GetAveragePM25Filter();
 }
 
@@ -4,9 +4,36 @@
 #include <pm25.h>
 #include <tvoc.h>
 #include <lcd.h>
+#include <calendar.h>
+#include <nrf_soc.h>
+#include <app_timer.h>
+#include <ble_config.h>
+
+typedef enum {
+	SENSOR_IDLE = 0,
+	SENSOR_DHT11,
+	SENSOR_PM25,
+	SENSOR_TVOC,
+	SENSOR_RTC
+} SENSOR_STAGE;
+
+static volatile SENSOR_STAGE sSensorStage = SENSOR_IDLE;
+static SensorData sSensorWork;                  //Filled stage by stage.
+static SensorData sSensorSnapshot;              //The last complete acquisition, copied in one piece.
+static uint32_t snSensorSnapshotCount = 0;
+static SensorHandler sSensorHandler = NULL;
+static app_timer_id_t sSensorTimerId;           //The stage watchdog
+static uint32_t snSensorTimeoutCount = 0;
+
+static void SensorDht11Handler(bool bValid, float temperature, float humidity);
+static void SensorPm25Handler(float fPm25Average);
+static void SensorTvocHandler(float fTvocAverage);
+static void SensorPublish(void);
+static void SensorTimeoutHandler(void *pContext);
 
 void InitSensor(void)
 {
+		app_timer_create(&sSensorTimerId, APP_TIMER_MODE_SINGLE_SHOT, SensorTimeoutHandler);
 		InitAdc();        //Initializing the ADC
 		InitDht11(); 			//Initializing the DHT11
 		InitPm25();				//Initializing the PM2.5
@@ -18,12 +45,140 @@ void CloseSensor(void)
 	
 }
 
+/**@brief One stage after the other, every stage is started from the completion of the previous one.
+ *
+ *   SENSOR_DHT11   only if the cache is out of date, ends in the DHT11 handler (app_timer)
+ *   SENSOR_PM25    a burst of SENSOR_PM25_BURST pulses, ends in the burst handler (ADC event)
+ *   SENSOR_TVOC    one conversion, ends in the TVOC handler (ADC event)
+ *   SENSOR_RTC     the time from the software calendar, then the snapshot is published
+ *
+ * A stage which cannot start is skipped and keeps the value of the previous snapshot. So is a stage
+ * which has not ended after SENSOR_STAGE_TIMEOUT, e.g. its ADC result did not fit in the scheduler.
+ */
+static void SensorNextStage(void)
+{
+	app_timer_stop(sSensorTimerId);
+	switch (sSensorStage) {
+	case SENSOR_IDLE:
+		sSensorStage = SENSOR_DHT11;
+		if (IsDht11CacheFresh() || NRF_SUCCESS != StartDht11(SensorDht11Handler)) {
+			GetDht11QueueAverage(&sSensorWork.temperature, &sSensorWork.humidity);
+			SensorNextStage();
+			return;
+		}
+		break;
+	case SENSOR_DHT11:
+		sSensorStage = SENSOR_PM25;
+		if (NRF_SUCCESS != StartPm25Burst(SENSOR_PM25_BURST, SensorPm25Handler)) {
+			SensorNextStage();
+			return;
+		}
+		break;
+	case SENSOR_PM25:
+		sSensorStage = SENSOR_TVOC;
+		if (NRF_SUCCESS != StartTvoc(SensorTvocHandler)) {
+			SensorNextStage();
+			return;
+		}
+		break;
+	case SENSOR_TVOC:
+		sSensorStage = SENSOR_RTC;
+		GetCalenderTime(&sSensorWork.local_rtc);        //The software calendar, no DS1302 traffic
+		SensorPublish();
+		return;
+	default:
+		return;
+	}
+	//The stage is running, the context tells a late timeout from the one of this stage.
+	app_timer_start(sSensorTimerId, APP_TIMER_TICKS(SENSOR_STAGE_TIMEOUT, APP_TIMER_PRESCALER),
+	                (void *)(uintptr_t)sSensorStage);
+}
+
+static void SensorTimeoutHandler(void *pContext)
+{
+	if ((SENSOR_STAGE)(uintptr_t)pContext != sSensorStage)
+		return;
+	switch (sSensorStage) {
+	case SENSOR_DHT11:
+		StopDht11();
+		GetDht11QueueAverage(&sSensorWork.temperature, &sSensorWork.humidity);
+		break;
+	case SENSOR_PM25:
+		StopPm25Burst();                            //The busy flag is cleared, the next acquisition may start.
+		break;
+	case SENSOR_TVOC:
+		StopTvoc();
+		break;
+	default:
+		return;
+	}
+	snSensorTimeoutCount++;
+	SensorNextStage();
+}
+
+static void SensorDht11Handler(bool bValid, float temperature, float humidity)
+{
+	GetDht11QueueAverage(&sSensorWork.temperature, &sSensorWork.humidity);
+	SensorNextStage();
+}
+
+static void SensorPm25Handler(float fPm25Average)
+{
+	sSensorWork.pm2_5 = fPm25Average;
+	SensorNextStage();
+}
+
+static void SensorTvocHandler(float fTvocAverage)
+{
+	sSensorWork.tvoc = fTvocAverage;
+	SensorNextStage();
+}
+
+static void SensorPublish(void)
+{
+	uint8_t nNested = 0;
+	sd_nvic_critical_region_enter(&nNested);
+	sSensorSnapshot = sSensorWork;
+	snSensorSnapshotCount++;
+	sd_nvic_critical_region_exit(nNested);
+
+	SensorHandler handler = sSensorHandler;
+	sSensorStage = SENSOR_IDLE;
+	if (NULL != handler)
+		handler(&sSensorWork);
+}
+
+uint32_t StartSensorAcquisition(SensorHandler handler)
+{
+	if (SENSOR_IDLE != sSensorStage)
+		return NRF_ERROR_BUSY;
+	GetSensorData(&sSensorWork);                //Skipped stages keep the last values.
+	sSensorHandler = handler;
+	SensorNextStage();
+	return NRF_SUCCESS;
+}
+
+bool IsSensorBusy(void)
+{
+	return SENSOR_IDLE != sSensorStage;
+}
+
+uint32_t GetSensorSnapshotCount(void)
+{
+	return snSensorSnapshotCount;
+}
+
+uint32_t GetSensorTimeoutCount(void)
+{
+	return snSensorTimeoutCount;
+}
+
 void GetSensorData(SensorData *SRet)
 {	
-		GetAverageDht11(&SRet->temperature,&SRet->humidity);
-		SRet->pm2_5 = GetAveragePM25();
-		SRet->tvoc = GetAverageTvoc();
-		GetCalenderTime(&SRet->local_rtc);
+	uint8_t nNested = 0;
+	sd_nvic_critical_region_enter(&nNested);
+	*SRet = sSensorSnapshot;
+	sd_nvic_critical_region_exit(nNested);
 }
 
 
@@ -39,7 +194,8 @@ void LcdDisplaySensorData(SensorData sensor ,unsigned char LcdShowFlag)
 		 
 		case SHIdu : LcdDisplayHumi(sensor.humidity);break;		
 
-		case SHIjian :LcdDisplayTime(sensor.local_rtc); break;
+		case SHIjian :GetCalenderTime(&sensor.local_rtc);		//The clock page shows the time now, not the sample time
+					 LcdDisplayTime(sensor.local_rtc); break;
 								 
 //		case ZHUANsu: LcdDisplayFanSpeed(sensor.fan.rpm);		
 //					break;					   		
@@ -0,0 +1,217 @@
+#include <sensor_log.h>
+#include <calendar.h>
+#include <pstorage.h>
+#include <integrity.h>
+#include <nrf_soc.h>
+#include <string.h>
+
+#define SENSOR_LOG_CRC_LENGTH        (SENSOR_LOG_RECORD_SIZE - sizeof(uint16_t))
+
+static pstorage_handle_t sLogPage[SENSOR_LOG_PAGE_COUNT];
+static uint8_t  snLogHeadPage = 0;          //Page of the next record
+static uint8_t  snLogHeadSlot = 0;          //Slot of the next record in it
+static uint8_t  snLogTailPage = 0;          //Page of the oldest record
+static uint16_t snLogCount = 0;
+static uint32_t suLogNextSequence = 0;
+static uint32_t suLogLastTime = 0;
+static bool     sbLogStarted = false;
+static bool     sbLogRegistered = false;    //The pages have their pstorage handles.
+
+static SensorLogRecord sLogPending[SENSOR_LOG_PENDING];     //pstorage writes from here later
+static uint8_t snLogPendingWrite = 0;
+static volatile uint8_t snLogPendingRead = 0;
+static volatile SensorLogStatistics sLogStatistics;
+
+static void SensorLogCallback(pstorage_handle_t *pHandle, uint8_t uOpCode, uint32_t uResult, uint8_t *pData, uint32_t uLength)
+{
+	if (NRF_SUCCESS != uResult)
+		sLogStatistics.uFlashErrors++;
+	if (PSTORAGE_STORE_OP_CODE == uOpCode) {
+		snLogPendingRead++;                 //The stores finish in the order they were queued.
+		if (NRF_SUCCESS == uResult)
+			sLogStatistics.uStored++;
+	}
+}
+
+static __INLINE uint32_t SensorLogLoad(uint8_t nPage, uint8_t nSlot, SensorLogRecord *pRecord)
+{
+	pstorage_handle_t handle;
+	uint32_t uErrCode = pstorage_block_identifier_get(&sLogPage[nPage], nSlot, &handle);
+	if (NRF_SUCCESS != uErrCode)
+		return uErrCode;
+	return pstorage_load((uint8_t *)pRecord, &handle, SENSOR_LOG_RECORD_SIZE, 0);
+}
+
+static __INLINE uint32_t SensorLogSequence(uint8_t nPage, uint8_t nSlot)
+{
+	SensorLogRecord record;
+	if (NRF_SUCCESS != SensorLogLoad(nPage, nSlot, &record))
+		return SENSOR_LOG_EMPTY;
+	return record.uSequence;
+}
+
+static __INLINE uint16_t SensorLogCrc(const SensorLogRecord *pRecord)
+{
+	return integrity_crc16_compute((const uint8_t *)pRecord, SENSOR_LOG_CRC_LENGTH);   //Same CRC as crc16_compute(), old records stay valid
+}
+
+/**@brief Slots fill from the start of a page, find the first empty one by bisection.
+ */
+static uint8_t SensorLogUsedSlots(uint8_t nPage)
+{
+	uint8_t nLow = 0, nHigh = SENSOR_LOG_PAGE_RECORDS;
+	while (nLow < nHigh) {
+		uint8_t nMiddle = (nLow + nHigh) / 2;
+		if (SENSOR_LOG_EMPTY == SensorLogSequence(nPage, nMiddle))
+			nHigh = nMiddle;
+		else
+			nLow = nMiddle + 1;
+	}
+	return nLow;
+}
+
+uint32_t InitSensorLog(void)
+{
+	pstorage_module_param_t param;
+	param.cb = SensorLogCallback;
+	param.block_size = SENSOR_LOG_RECORD_SIZE;
+	param.block_count = SENSOR_LOG_PAGE_RECORDS;
+	sbLogRegistered = false;
+	for (int i = 0; i < SENSOR_LOG_PAGE_COUNT; ++i) {
+		uint32_t uErrCode = pstorage_register(&param, &sLogPage[i]);   //One module per page, so a clear erases only that page
+		if (NRF_SUCCESS != uErrCode)
+			return uErrCode;                    //No handles, nothing is logged.
+	}
+	sbLogRegistered = true;
+
+	//The page starting with the highest sequence is the head, the one with the lowest the tail.
+	uint32_t uHeadSequence = 0, uTailSequence = SENSOR_LOG_EMPTY;
+	uint8_t nUsedPages = 0;
+	for (uint8_t i = 0; i < SENSOR_LOG_PAGE_COUNT; ++i) {
+		uint32_t uSequence = SensorLogSequence(i, 0);
+		if (SENSOR_LOG_EMPTY == uSequence)
+			continue;
+		nUsedPages++;
+		if (uSequence >= uHeadSequence) {
+			uHeadSequence = uSequence;
+			snLogHeadPage = i;
+		}
+		if (uSequence < uTailSequence) {
+			uTailSequence = uSequence;
+			snLogTailPage = i;
+		}
+	}
+	if (0 == nUsedPages)
+		return NRF_SUCCESS;                     //A new log starts at page 0, sequence 0.
+	uint8_t nUsedSlots = SensorLogUsedSlots(snLogHeadPage);
+	snLogCount = (nUsedPages - 1) * SENSOR_LOG_PAGE_RECORDS + nUsedSlots;
+	suLogNextSequence = uHeadSequence + nUsedSlots;
+	snLogHeadSlot = nUsedSlots;
+	return NRF_SUCCESS;
+}
+
+uint32_t AppendSensorLog(const SensorData *pSensorData)
+{
+	if (!sbLogRegistered)
+		return NRF_ERROR_INVALID_STATE;
+	if (SENSOR_LOG_PENDING == (uint8_t)(snLogPendingWrite - snLogPendingRead)) {
+		sLogStatistics.uDropped++;
+		return NRF_ERROR_NO_MEM;
+	}
+	if (SENSOR_LOG_PAGE_RECORDS == snLogHeadSlot) {
+		uint8_t nNext = (snLogHeadPage + 1) % SENSOR_LOG_PAGE_COUNT;
+		if (snLogCount > (SENSOR_LOG_PAGE_COUNT - 1) * SENSOR_LOG_PAGE_RECORDS) {
+			snLogCount -= SENSOR_LOG_PAGE_RECORDS;  //The oldest page goes.
+			snLogTailPage = (snLogTailPage + 1) % SENSOR_LOG_PAGE_COUNT;
+		}
+		uint32_t uErrCode = pstorage_clear(&sLogPage[nNext], SENSOR_LOG_PAGE_SIZE);
+		if (NRF_SUCCESS != uErrCode) {
+			sLogStatistics.uFlashErrors++;
+			return uErrCode;
+		}
+		sLogStatistics.uErased++;
+		snLogHeadPage = nNext;
+		snLogHeadSlot = 0;
+	}
+
+	SensorLogRecord *pRecord = &sLogPending[snLogPendingWrite % SENSOR_LOG_PENDING];
+	pRecord->uSequence = suLogNextSequence;
+	pRecord->uTime = GetCalendarSeconds();
+	pRecord->uPm25 = (uint16_t)(pSensorData->pm2_5 * 10 + 0.5f);
+	pRecord->uTvoc = (uint16_t)(pSensorData->tvoc * 1000 + 0.5f);
+	pRecord->nTemperature = (int8_t)pSensorData->temperature;
+	pRecord->uHumidity = (uint8_t)pSensorData->humidity;
+	pRecord->uCrc = SensorLogCrc(pRecord);
+
+	pstorage_handle_t handle;
+	uint32_t uErrCode = pstorage_block_identifier_get(&sLogPage[snLogHeadPage], snLogHeadSlot, &handle);
+	if (NRF_SUCCESS == uErrCode)
+		uErrCode = pstorage_store(&handle, (uint8_t *)pRecord, SENSOR_LOG_RECORD_SIZE, 0);
+	if (NRF_SUCCESS != uErrCode) {
+		sLogStatistics.uFlashErrors++;
+		return uErrCode;
+	}
+	snLogPendingWrite++;
+	if (0 == snLogCount)
+		snLogTailPage = snLogHeadPage;
+	snLogHeadSlot++;
+	snLogCount++;
+	suLogNextSequence++;
+	sLogStatistics.uAppended++;
+	return NRF_SUCCESS;
+}
+
+uint32_t LogSensorData(const SensorData *pSensorData)
+{
+	uint32_t uNow = GetCalendarUptime();
+	if (sbLogStarted && uNow - suLogLastTime < SENSOR_LOG_INTERVAL)
+		return NRF_SUCCESS;
+	sbLogStarted = true;
+	suLogLastTime = uNow;
+	return AppendSensorLog(pSensorData);
+}
+
+uint16_t GetSensorLogCount(void)
+{
+	return snLogCount;
+}
+
+uint32_t GetSensorLogFirstSequence(void)
+{
+	return suLogNextSequence - snLogCount;
+}
+
+uint32_t ReadSensorLog(uint16_t nIndex, SensorLogRecord *pRecord)
+{
+	if (nIndex >= snLogCount)
+		return NRF_ERROR_INVALID_PARAM;
+
+	//The newest records may still wait for pstorage, they are read from sLogPending.
+	uint8_t nNested = 0;
+	sd_nvic_critical_region_enter(&nNested);
+	uint8_t nPending = (uint8_t)(snLogPendingWrite - snLogPendingRead);
+	bool bPending = (nIndex >= snLogCount - nPending);
+	if (bPending)
+		*pRecord = sLogPending[(uint8_t)(snLogPendingRead + nIndex - (snLogCount - nPending)) % SENSOR_LOG_PENDING];
+	sd_nvic_critical_region_exit(nNested);
+	if (bPending)
+		return NRF_SUCCESS;
+
+	uint8_t nPage = (snLogTailPage + nIndex / SENSOR_LOG_PAGE_RECORDS) % SENSOR_LOG_PAGE_COUNT;
+	uint32_t uErrCode = SensorLogLoad(nPage, nIndex % SENSOR_LOG_PAGE_RECORDS, pRecord);
+	if (NRF_SUCCESS != uErrCode)
+		return uErrCode;
+	if (pRecord->uCrc != SensorLogCrc(pRecord) || pRecord->uSequence != GetSensorLogFirstSequence() + nIndex) {
+		sLogStatistics.uCrcErrors++;
+		return NRF_ERROR_INVALID_DATA;          //Cut by a reset, or a failed store.
+	}
+	return NRF_SUCCESS;
+}
+
+void GetSensorLogStatistics(SensorLogStatistics *pStatistics)
+{
+	uint8_t nNested = 0;
+	sd_nvic_critical_region_enter(&nNested);
+	memcpy(pStatistics, (const void *)&sLogStatistics, sizeof(SensorLogStatistics));
+	sd_nvic_critical_region_exit(nNested);
+}
@@ -3,70 +3,93 @@
 #include <gpio.h>
 #include <pin.h>
 #include <dht11.h>
-#include <math.h>
+#include <tvoc_lut.h>
 
-static float sfTvocQueue[TVOC_QUEUE_LENGTH];
-static int snTvocQueueIndex = 0;
+static int32_t snTvocFilterBuffer[FILTER_BUFFER_LENGTH(TVOC_FILTER, TVOC_QUEUE_LENGTH)];
+static Filter sTvocFilter;
+static TvocHandler sTvocHandler = NULL;
 
-static __INLINE float TvocValue(float fTvocVoltage)
+/**@brief Formaldehyde in ug/m3 from the ADC code, in integers only.
+ *
+ * @details The ppm curve, log(ppm) = 1.528v - 0.125v^2 - 2.631, is in sTvocLut (1e-5 ppm every
+ *          TVOC_LUT_STEP codes), interpolated linearly. ppm * (273 + T) * 30 / (22.4 * 273) gives mg/m3.
+ */
+static __INLINE uint32_t TvocValue(uint32_t uAdcValue)
 {
-	float fRet,temperature,humi;
-	float Formaldehyde,Formaldehyde_ppm,log_Formaldehyde_ppm;																	//only need the Formaldehyde<Modify by @Mida 2015-7-16>
-//	float Toluene,Toluene_ppm,log_Toluene_ppm;																	
-	
-	log_Formaldehyde_ppm = 1.528*fTvocVoltage - 0.125*fTvocVoltage*fTvocVoltage - 2.631;			//only need the Formaldehyde<Modify by @Mida 2015-7-16>
-	Formaldehyde_ppm = pow(10,log_Formaldehyde_ppm);
-//	log_Toluene_ppm = 2.852*fTvocVoltage - 0.21*fTvocVoltage*fTvocVoltage - 7.071;
-//	Toluene_ppm = pow(10,log_Toluene_ppm);
-	
-	GetDht11(&temperature,&humi);
-	
-	Formaldehyde = (Formaldehyde_ppm *(273 + temperature)*TVOC_Formaldehyde_M)/(22.4*273);			//only need the Formaldehyde<Modify by @Mida 2015-7-16>
-//	Toluene = (Toluene_ppm *(273 + temperature)*TVOC_Toluene_M)/(22.4*273);
-	
-	fRet = Formaldehyde;               //only need the Formaldehyde<Modify by @Mida 2015-7-16>
-	return fRet;
-}
+	Dht11Cache cache;
+	GetDht11Cache(&cache);                                   //The compensation may lag, but it never waits for the DHT11.
+	int32_t nTemperature = cache.bValid ? (int32_t)cache.temperature : TVOC_DEFAULT_TEMPERATURE;
+	if (nTemperature < TVOC_TEMPERATURE_MIN)
+		nTemperature = TVOC_TEMPERATURE_MIN;
+	else if (nTemperature > TVOC_TEMPERATURE_MAX)
+		nTemperature = TVOC_TEMPERATURE_MAX;
 
+	uint32_t uIndex = uAdcValue >> TVOC_LUT_SHIFT;
+	uint32_t uFrac = uAdcValue & (TVOC_LUT_STEP - 1);
+	if (uIndex >= sizeof(sTvocLut) / sizeof(sTvocLut[0]) - 1) {
+		uIndex = sizeof(sTvocLut) / sizeof(sTvocLut[0]) - 2;
+		uFrac = TVOC_LUT_STEP;
+	}
+	uint32_t uPpm = sTvocLut[uIndex] + (((sTvocLut[uIndex + 1] - sTvocLut[uIndex]) * uFrac) >> TVOC_LUT_SHIFT);
+	return uPpm * (uint32_t)(273 + nTemperature) / TVOC_LUT_UG_DIVISOR;   //Below 2^32 up to 85 degrees.
+}
 
-static __INLINE void FullTvocQueue()
+static __INLINE void InsertTvocFilter(uint32_t uTvocValue)
 {
-	for (int i = 0; i < TVOC_QUEUE_LENGTH; ++i) {
-		GetTvoc();
-	}
+	if (IsFilterEmpty(&sTvocFilter))
+		FilterFill(&sTvocFilter, (int32_t)uTvocValue);       //The first sample fills the window.
+	else
+		FilterInsert(&sTvocFilter, (int32_t)uTvocValue);
 }
 
-static void InsertTvocQueue(float fTvocValue)
+static __INLINE float TvocFilterOutput(void)
 {
-	sfTvocQueue[snTvocQueueIndex++] = fTvocValue;
-	if (TVOC_QUEUE_LENGTH == snTvocQueueIndex) {
-		snTvocQueueIndex = 0;
-	}
+	return (float)FilterOutput(&sTvocFilter) / TVOC_UG_PER_MG;
 }
 
 void InitTvoc(void)
 {
-	FullTvocQueue();
+	InitFilter(&sTvocFilter, TVOC_FILTER, snTvocFilterBuffer, TVOC_QUEUE_LENGTH);
+	StartTvoc(NULL);                  //The first sample fills the filter.
+}
+
+static void TvocAdcHandler(uint32_t uAdcValue, void *pContext)
+{
+	InsertTvocFilter(TvocValue(uAdcValue));
+	TvocHandler handler = sTvocHandler;
+	sTvocHandler = NULL;
+	if (NULL != handler)
+		handler(TvocFilterOutput());
 }
 
 float GetTvoc(void)
 {
 	OpenAdc(TVOC_ADC_NUMBER);
-	float fTvocVoltage = GetVoltage(TVOC_ADC_NUMBER)/0.72;
-	float fTvocValue = TvocValue(fTvocVoltage);
-	InsertTvocQueue(fTvocValue);
-	return fTvocValue;
+	uint32_t uTvocValue = TvocValue(GetAdcValue());
+	InsertTvocFilter(uTvocValue);
+	return uTvocValue / TVOC_UG_PER_MG;
+}
+
+uint32_t StartTvoc(TvocHandler handler)
+{
+	if (NULL != sTvocHandler)
+		return NRF_ERROR_BUSY;
+	sTvocHandler = handler;
+	uint32_t uErrCode = StartAdc(TVOC_ADC_NUMBER, TvocAdcHandler, NULL);
+	if (NRF_SUCCESS != uErrCode)
+		sTvocHandler = NULL;
+	return uErrCode;
+}
+
+void StopTvoc(void)
+{
+	sTvocHandler = NULL;              //A late result still joins the filter.
 }
 
 float GetAverageTvoc(void)
 {
-	GetTvoc();
-	float fRet = 0.0;
-	for (int i = 0; i < TVOC_QUEUE_LENGTH; ++i) {
-		fRet += sfTvocQueue[i];
-	}
-	fRet /= TVOC_QUEUE_LENGTH;
-	return fRet;
+	StartTvoc(NULL);                  //The result joins the filter when the conversion finishes.
+	return TvocFilterOutput();
 }
 
 
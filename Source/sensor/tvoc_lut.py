@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+# Copyright (c) 2014 Before Technology. All Rights Reserved.
+#
+# Generates Include/sensor/tvoc_lut.h, the formaldehyde curve of the TVOC sensor:
+#   log10(ppm) = 1.528v - 0.125v^2 - 2.631
+# sampled every TVOC_LUT_STEP ADC codes, in units of 1e-5 ppm.
+#
+#   python tvoc_lut.py > ../../Include/sensor/tvoc_lut.h
+#   python tvoc_lut.py --check      worst error of the fixed point path against the float formula
+
+import sys
+
+ADC_COUNT_MAX = 1024
+ADC_COUNT_MAX_VOLTAGE = 1.2
+ADC_PRESCALING = 3.0
+TVOC_VOLTAGE_DIVIDER = 0.72
+STEP = 4
+PPM_SCALE = 100000
+UG_DIVISOR = 20384          # 22.4 * 273 * 1e5 / (30 * 1000), 1e-5 ppm * (273 + T) to ug/m3
+
+
+def voltage(code):
+    return code / ADC_COUNT_MAX * ADC_COUNT_MAX_VOLTAGE * ADC_PRESCALING / TVOC_VOLTAGE_DIVIDER
+
+
+def ppm(code):
+    v = voltage(code)
+    return 10 ** (1.528 * v - 0.125 * v * v - 2.631)
+
+
+def table():
+    return [int(round(ppm(code) * PPM_SCALE)) for code in range(0, ADC_COUNT_MAX + 1, STEP)]
+
+
+def fixed_ug(lut, code, temperature):
+    i, frac = code // STEP, code % STEP
+    value = lut[i] + (lut[i + 1] - lut[i]) * frac // STEP
+    return value * (273 + temperature) // UG_DIVISOR
+
+
+def float_ug(code, temperature):
+    return ppm(code) * (273 + temperature) * 30 / (22.4 * 273) * 1000
+
+
+def check(lut):
+    worst = 0.0
+    for temperature in (0, 25, 50):
+        for code in range(ADC_COUNT_MAX):
+            worst = max(worst, abs(fixed_ug(lut, code, temperature) - float_ug(code, temperature)))
+    print('worst error %.2f ug/m3' % worst)
+
+
+def main():
+    lut = table()
+    if '--check' in sys.argv:
+        check(lut)
+        return
+    print('/* Copyright (c) 2014 Before Technology. All Rights Reserved. */')
+    print('/* Generated by Source/sensor/tvoc_lut.py, do not edit. */')
+    print('#ifndef TVOC_LUT_H')
+    print('#define TVOC_LUT_H')
+    print('')
+    print('#include <stdint.h>')
+    print('')
+    print('#define TVOC_LUT_STEP          %d                    //ADC codes between two entries' % STEP)
+    print('#define TVOC_LUT_SHIFT         %d' % (STEP.bit_length() - 1))
+    print('#define TVOC_LUT_UG_DIVISOR    %d                //1e-5ppm * (273 + T) / this = ug/m3' % UG_DIVISOR)
+    print('')
+    print('//Formaldehyde in 1e-5 ppm for the ADC codes 0, %d, ... %d' % (STEP, ADC_COUNT_MAX))
+    print('static const uint32_t sTvocLut[%d] = {' % len(lut))
+    for i in range(0, len(lut), 8):
+        print('\t' + ', '.join('%u' % x for x in lut[i:i + 8]) + ',')
+    print('};')
+    print('')
+    print('#endif')
+
+
+if __name__ == '__main__':
+    main()
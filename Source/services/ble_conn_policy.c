@@ -0,0 +1,151 @@
+/* Copyright (c) 2014 Before Technology. All Rights Reserved.
+ *
+ */
+
+#include <string.h>
+#include "nordic_common.h"
+#include "app_util.h"
+#include "app_timer.h"
+#include <ble_config.h>
+#include <ble_conn_policy.h>
+
+static ble_conn_policy_busy_handler_t	m_busy_handler;
+static ble_gap_conn_params_t			m_params[2]; // Indexed by ble_conn_policy_mode_t.
+static app_timer_id_t					m_timer_id;
+static uint16_t							m_conn_handle = BLE_CONN_HANDLE_INVALID;
+static volatile bool					m_pending; // A request waits for the answer of the central.
+static uint8_t							m_quiet_ticks; // Ticks without traffic.
+static uint8_t							m_dwell_ticks; // Ticks since the last request.
+static ble_conn_policy_statistics_t		m_statistics;
+
+/**@brief Function for checking whether an interval belongs to a profile.
+ *
+ * @param[in]   mode       Profile.
+ * @param[in]   interval   Connection interval, uint(1.25ms).
+ */
+static bool conn_policy_interval_match(ble_conn_policy_mode_t mode, uint16_t interval)
+{
+	return (interval >= m_params[mode].min_conn_interval) && (interval <= m_params[mode].max_conn_interval);
+}
+
+/**@brief Function for requesting the parameters of a profile.
+ *
+ * @param[in]   mode       Profile to switch to.
+ */
+static void conn_policy_request(ble_conn_policy_mode_t mode)
+{
+	m_statistics.mode = mode;
+	m_dwell_ticks = 0;
+	m_statistics.requested++;
+	// Changes the preferred parameters too, so that ble_conn_params retries the same profile.
+	// It does not renegotiate when the interval in use already fits, so no answer will come then.
+	if (NRF_SUCCESS != ble_conn_params_change_conn_params(&m_params[mode]))
+		m_statistics.rejected++;
+	else if (conn_policy_interval_match(mode, m_statistics.conn_interval))
+		m_statistics.accepted++;
+	else
+		m_pending = true;
+}
+
+/**@brief Function for handling the time-out of the policy timer.
+ *
+ * @details Goes to the bulk profile at the first busy tick, and back to the idle profile after
+ *          BLE_CONN_POLICY_IDLE_TICKS quiet ticks. Nothing is requested while an answer is pending
+ *          or within BLE_CONN_POLICY_DWELL_TICKS of the last request.
+ *
+ * @param[in]   p_context	Not used.
+ */
+static void conn_policy_timeout_handler(void * p_context)
+{
+	UNUSED_PARAMETER(p_context);
+
+	if (m_busy_handler())
+		m_quiet_ticks = 0;
+	else if (m_quiet_ticks < BLE_CONN_POLICY_IDLE_TICKS)
+		m_quiet_ticks++;
+	if (m_dwell_ticks < BLE_CONN_POLICY_DWELL_TICKS)
+		m_dwell_ticks++;
+
+	if (m_pending || BLE_CONN_HANDLE_INVALID == m_conn_handle || m_dwell_ticks < BLE_CONN_POLICY_DWELL_TICKS)
+		return;
+	if (BLE_CONN_POLICY_IDLE == m_statistics.mode && 0 == m_quiet_ticks)
+		conn_policy_request(BLE_CONN_POLICY_BULK);
+	else if (BLE_CONN_POLICY_BULK == m_statistics.mode && m_quiet_ticks >= BLE_CONN_POLICY_IDLE_TICKS)
+		conn_policy_request(BLE_CONN_POLICY_IDLE);
+}
+
+uint32_t ble_conn_policy_init(const ble_conn_policy_init_t * p_init)
+{
+	m_busy_handler = p_init->busy_handler;
+	m_params[BLE_CONN_POLICY_IDLE] = p_init->idle_params;
+	m_params[BLE_CONN_POLICY_BULK].min_conn_interval = BLE_CONN_POLICY_BULK_MIN_INTERVAL;
+	m_params[BLE_CONN_POLICY_BULK].max_conn_interval = BLE_CONN_POLICY_BULK_MAX_INTERVAL;
+	m_params[BLE_CONN_POLICY_BULK].slave_latency = BLE_CONN_POLICY_BULK_SLAVE_LATENCY;
+	m_params[BLE_CONN_POLICY_BULK].conn_sup_timeout = BLE_CONN_POLICY_BULK_SUP_TIMEOUT;
+	memset(&m_statistics, 0, sizeof(m_statistics));
+	m_statistics.mode = BLE_CONN_POLICY_IDLE;
+
+	return app_timer_create(&m_timer_id, APP_TIMER_MODE_REPEATED, conn_policy_timeout_handler);
+}
+
+void ble_conn_policy_on_ble_evt(ble_evt_t * p_ble_evt)
+{
+	ble_gap_conn_params_t * p_conn_params;
+
+	switch (p_ble_evt->header.evt_id)
+	{
+		case BLE_GAP_EVT_CONNECTED:
+			m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+			p_conn_params = &p_ble_evt->evt.gap_evt.params.connected.conn_params;
+			m_statistics.conn_interval = p_conn_params->max_conn_interval;
+			m_statistics.slave_latency = p_conn_params->slave_latency;
+			// The Connection Parameters module negotiates the idle profile first.
+			m_statistics.mode = BLE_CONN_POLICY_IDLE;
+			m_pending = false;
+			m_quiet_ticks = 0;
+			m_dwell_ticks = 0;
+			app_timer_start(m_timer_id, APP_TIMER_TICKS(BLE_CONN_POLICY_TICK_INTERVAL, APP_TIMER_PRESCALER), NULL);
+			break;
+
+		case BLE_GAP_EVT_DISCONNECTED:
+			m_conn_handle = BLE_CONN_HANDLE_INVALID;
+			app_timer_stop(m_timer_id);
+			// The next connection starts with the idle profile.
+			ble_conn_params_change_conn_params(&m_params[BLE_CONN_POLICY_IDLE]);
+			break;
+
+		case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+			p_conn_params = &p_ble_evt->evt.gap_evt.params.conn_param_update.conn_params;
+			m_statistics.conn_interval = p_conn_params->max_conn_interval;
+			m_statistics.slave_latency = p_conn_params->slave_latency;
+			if (m_pending)
+			{
+				if (conn_policy_interval_match(m_statistics.mode, p_conn_params->max_conn_interval))
+					m_statistics.accepted++;
+				else
+					m_statistics.rejected++;
+				m_pending = false;
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+bool ble_conn_policy_on_conn_params_evt(ble_conn_params_evt_t * p_evt)
+{
+	if (BLE_CONN_PARAMS_EVT_FAILED != p_evt->evt_type || BLE_CONN_POLICY_BULK != m_statistics.mode)
+		return false;
+	// The central keeps refusing the bulk profile, go back to the idle one and try again after the dwell time.
+	if (m_pending)
+		m_statistics.rejected++; // Never answered.
+	m_pending = false;
+	conn_policy_request(BLE_CONN_POLICY_IDLE);
+	return true;
+}
+
+void ble_conn_policy_get_statistics(ble_conn_policy_statistics_t * p_statistics)
+{
+	*p_statistics = m_statistics;
+}
@@ -9,6 +9,12 @@
 #include <car_air_purifier.h>
 #include <ble_instant_air_quality.h>
 
+// Indexed by ble_iaq_char_t.
+static const float m_iaq_notify_deadband[IAQ_CHAR_COUNT] =
+{
+    IAQ_NOTIFY_DEADBAND_PM25, IAQ_NOTIFY_DEADBAND_TVOC, IAQ_NOTIFY_DEADBAND_TEMP, IAQ_NOTIFY_DEADBAND_HUMI
+};
+
 /**@brief Function for handling the Connect event.
  *
  * @param[in]   p_iaq       Instant Air Quality Service Service structure.
@@ -17,6 +23,7 @@
 static void on_connect(ble_iaq_t * p_iaq, ble_evt_t * p_ble_evt)
 {
     p_iaq->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+    memset(p_iaq->is_notified, 0, sizeof(p_iaq->is_notified));
 }
 
 
@@ -422,6 +429,7 @@ uint32_t ble_iaq_init(ble_iaq_t * p_iaq, const ble_iaq_init_t * p_iaq_init)
 
     // Initialize service structure
     p_iaq->conn_handle = BLE_CONN_HANDLE_INVALID;
+    memset(p_iaq->is_notified, 0, sizeof(p_iaq->is_notified));
     
     // Add service
     ble_uuid128_t base_uuid = IAQ_UUID_BASE;
@@ -478,3 +486,76 @@ uint32_t ble_iaq_init(ble_iaq_t * p_iaq, const ble_iaq_init_t * p_iaq_init)
 	
 	return NRF_SUCCESS;
 }
+
+/**@brief Function for storing a value and notifying it when it moved out of its deadband.
+ *
+ * @param[in]   p_iaq        Instant Air Quality Service structure.
+ * @param[in]   index        Index of the characteristic.
+ * @param[in]   p_handles    Handles of the characteristic.
+ * @param[in]   value        New value.
+ *
+ * @return      NRF_SUCCESS if stored, notified or held back, otherwise an error code.
+ */
+static uint32_t iaq_value_change(ble_iaq_t * p_iaq, ble_iaq_char_t index, ble_gatts_char_handles_t * p_handles, float value)
+{
+    uint16_t len = BLE_SENSOR_SIZE;
+    uint32_t err_code = sd_ble_gatts_value_set(p_handles->value_handle, 0, &len, (uint8_t *)&value);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+    if (BLE_CONN_HANDLE_INVALID == p_iaq->conn_handle)
+    {
+        return NRF_SUCCESS;
+    }
+
+    uint32_t now = GetCalendarUptime();
+    float    change = value - p_iaq->notified_value[index];
+    if (p_iaq->is_notified[index]
+        && ((change <= m_iaq_notify_deadband[index] && -change <= m_iaq_notify_deadband[index])
+            || now - p_iaq->notified_time[index] < IAQ_NOTIFY_MIN_INTERVAL))
+    {
+        return NRF_SUCCESS;     // Within the deadband, or changed too recently. The read gets the new value anyway.
+    }
+
+    ble_gatts_hvx_params_t params;
+    memset(&params, 0, sizeof(params));
+    len = BLE_SENSOR_SIZE;
+    params.type   = BLE_GATT_HVX_NOTIFICATION;
+    params.handle = p_handles->value_handle;
+    params.p_data = (uint8_t *)&value;
+    params.p_len  = &len;
+    err_code = sd_ble_gatts_hvx(p_iaq->conn_handle, &params);
+    if (err_code == NRF_SUCCESS)
+    {
+        p_iaq->notified_value[index] = value;
+        p_iaq->notified_time[index]  = now;
+        p_iaq->is_notified[index]    = true;
+    }
+    else if (err_code == NRF_ERROR_INVALID_STATE || err_code == BLE_ERROR_GATTS_SYS_ATTR_MISSING
+             || err_code == BLE_ERROR_NO_TX_BUFFERS)
+    {
+        err_code = NRF_SUCCESS;     // Notification not enabled, or no buffer now. Try again with the next value.
+    }
+    return err_code;
+}
+
+uint32_t ble_iaq_on_pm25_change(ble_iaq_t *p_iaq, float pm25)
+{
+    return iaq_value_change(p_iaq, IAQ_CHAR_PM25, &p_iaq->pm25_handles, pm25);
+}
+
+uint32_t ble_iaq_on_tvoc_change(ble_iaq_t *p_iaq, float tvoc)
+{
+    return iaq_value_change(p_iaq, IAQ_CHAR_TVOC, &p_iaq->tvoc_handles, tvoc);
+}
+
+uint32_t ble_iaq_on_temp_change(ble_iaq_t *p_iaq, float temperature)
+{
+    return iaq_value_change(p_iaq, IAQ_CHAR_TEMP, &p_iaq->temp_handles, temperature);
+}
+
+uint32_t ble_iaq_on_humi_change(ble_iaq_t *p_iaq, float humidity)
+{
+    return iaq_value_change(p_iaq, IAQ_CHAR_HUMI, &p_iaq->humi_handles, humidity);
+}
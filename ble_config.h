@@ -11,20 +11,25 @@
 #define APP_ADV_INTERVAL                64                                          /**< The advertising interval (in units of 0.625 ms. This value corresponds to 40 ms). */
 #define APP_ADV_TIMEOUT_IN_SECONDS      10                                          /**< The advertising timeout (in units of seconds). */
 
+#define APP_ADV_SENSOR_BROADCAST        1                                           /**< Put the latest sample into the manufacturer specific data of the advertising packet. */
+#define APP_COMPANY_IDENTIFIER          0xFFFF                                      /**< Company identifier of the manufacturer specific data (0xFFFF is reserved for test). */
+#define APP_ADV_SENSOR_FORMAT           0x01                                        /**< Version of the layout below, the first byte of the manufacturer specific data. */
+#define APP_ADV_SENSOR_DATA_LENGTH      9                                           /**< Format(1) Sequence(1) PM2.5(2, ug/m3) TVOC(2, ug/m3) Temperature(1, signed degree) Humidity(1, %RH) Battery(1, %), little endian. */
+
 // YOUR_JOB: Modify these according to requirements.
 #define APP_TIMER_PRESCALER             0                                        		/**< Value of the RTC1 PRESCALER register. */
-#define APP_TIMER_MAX_TIMERS            4                                           /**< Maximum number of simultaneously created timers. */
+#define APP_TIMER_MAX_TIMERS            8                                           /**< Maximum number of simultaneously created timers. */
 #define APP_TIMER_OP_QUEUE_SIZE         5                                           /**< Size of timer operation queues. */
 
-#define MIN_CONN_INTERVAL               MSEC_TO_UNITS(500, UNIT_1_25_MS)            /**< Minimum acceptable connection interval (0.5 seconds). */
-#define MAX_CONN_INTERVAL               MSEC_TO_UNITS(1000, UNIT_1_25_MS)           /**< Maximum acceptable connection interval (1 second). */
-#define SLAVE_LATENCY                   0                                           /**< Slave latency. */
-#define CONN_SUP_TIMEOUT                MSEC_TO_UNITS(4000, UNIT_10_MS)             /**< Connection supervisory timeout (4 seconds). */
+// The idle profile, the bulk profile is in ble_conn_policy.h.
+#define MIN_CONN_INTERVAL               MSEC_TO_UNITS(400, UNIT_1_25_MS)            /**< Minimum acceptable connection interval (0.4 seconds). */
+#define MAX_CONN_INTERVAL               MSEC_TO_UNITS(650, UNIT_1_25_MS)            /**< Maximum acceptable connection interval (0.65 seconds). */
+#define SLAVE_LATENCY                   2                                           /**< Slave latency. */
+#define CONN_SUP_TIMEOUT                MSEC_TO_UNITS(6000, UNIT_10_MS)             /**< Connection supervisory timeout (6 seconds), more than 3 * MAX_CONN_INTERVAL * (1 + SLAVE_LATENCY). */
 #define FIRST_CONN_PARAMS_UPDATE_DELAY  APP_TIMER_TICKS(20000, APP_TIMER_PRESCALER) /**< Time from initiating event (connect or start of notification) to first time sd_ble_gap_conn_param_update is called (15 seconds). */
 #define NEXT_CONN_PARAMS_UPDATE_DELAY   APP_TIMER_TICKS(5000, APP_TIMER_PRESCALER)  /**< Time between each call to sd_ble_gap_conn_param_update after the first call (5 seconds). */
 #define MAX_CONN_PARAMS_UPDATE_COUNT    3                                           /**< Number of attempts before giving up the connection parameter negotiation. */
 
-#define APP_GPIOTE_MAX_USERS            1                                           /**< Maximum number of users of the GPIOTE handler. */
 
 #define SEC_PARAM_TIMEOUT               30                                          /**< Timeout for Pairing Request or Security Request (in seconds). */
 #define SEC_PARAM_BOND                  1                                           /**< Perform bonding. */
@@ -19,19 +19,22 @@
 #include "softdevice_handler.h"
 #include "app_timer.h"
 #include "ble_error_log.h"
-#include "app_gpiote.h"
-#include "app_button.h"
 #include "ble_debug_assert_handler.h"
 #include "pstorage.h"
+#include "app_util.h"
 
 // Headers of Sevices
 #include <ble_config.h>
+#include <ble_conn_policy.h>
 #include <ble_id.h>
+#include <ble_instant_air_quality.h>
 #include <ble_uart.h>
 // Common Header for Car Air Purfier
 #include <car_air_purifier.h>
 // Headers of Buffer Queue
 #include <rx_buffer_queue.h> 
+#include <packet_pool.h>
+#include <adc.h>
 
 
 
@@ -45,23 +48,30 @@
 static ble_gap_sec_params_t             m_sec_params;                               /**< Security requirements for this application. */
 static uint16_t                         m_conn_handle = BLE_CONN_HANDLE_INVALID;    /**< Handle of the current connection. */
 static ble_id_t							m_id;
+static ble_iaq_t							m_iaq;
 static uint32_t							m_product_id = CAR_AIR_PURIFIER_SERIAL_NUMBER;																				
 static ble_uart_t						m_uart;
 static app_timer_id_t					m_adv_timer_id = 0;
 static app_timer_id_t					m_sample_timer_id = 1;
-static rx_buffer_elem_t     al_recv_buffer_queue[RX_BUFFER_QUEUE_LENGTH];             /*The buffer queue for AL receive the 'write' data.<Created by @Mida 2015-6-2>***/
 static SensorData 					m_sensor;
 static uint8_t 							SampleTickTack = 0;
 
+static power_statistics_t				m_power_statistics;
+static uint32_t							m_power_wake_ticks;						/**< RTC1 counter at the last return from sd_app_evt_wait(). */
+
 static ble_gap_adv_params_t				adv_params;
+#if APP_ADV_SENSOR_BROADCAST
+static uint8_t							m_adv_sensor_data[APP_ADV_SENSOR_DATA_LENGTH];	/**< Manufacturer specific data of the advertising packet. */
+static uint8_t							m_adv_sensor_sequence = 0;						/**< Increased on each sample, so that a scanner knows a new one. */
+#endif
 
 #define ADV_TIMER_TICKS					APP_TIMER_TICKS(APP_ADV_TIMEOUT_IN_SECONDS * 500, APP_TIMER_PRESCALER)
 #define SAMPLE_TIMER_TICKS			APP_TIMER_TICKS(SENSOR_SAMPLE_TIMER_INTERVAL * 500, APP_TIMER_PRESCALER)
 
 // YOUR_JOB: Modify these according to requirements (e.g. if other event types are to pass through
 //           the scheduler).
-#define SCHED_MAX_EVENT_DATA_SIZE       sizeof(app_timer_event_t)                   /**< Maximum size of scheduler events. Note that scheduler BLE stack events do not contain any data, as the events are being pulled from the stack in the event handler. */
-#define SCHED_QUEUE_SIZE                10                                          /**< Maximum number of events in the scheduler queue. */
+#define SCHED_MAX_EVENT_DATA_SIZE       MAX(sizeof(app_timer_event_t), sizeof(AdcEvent)) /**< Maximum size of scheduler events. Note that scheduler BLE stack events do not contain any data, as the events are being pulled from the stack in the event handler. */
+#define SCHED_QUEUE_SIZE                20                                          /**< Maximum number of events in the scheduler queue. A PM2.5 burst alone posts 10 samples. */
 
 // Persistent storage system event handler
 void pstorage_sys_event_handler (uint32_t p_evt);
@@ -158,17 +168,105 @@ static void adv_timers_stop(void)
     APP_ERROR_CHECK(err_code);
 }
 
-/**@brief Function for handling sample-start of timer.
- *<Modify by @Mida 2015-8-4>
- * @note The interval value is 3s.
- * @details Sampling the all sensor.And Pass to the AL.
+/**@brief Function for setting the advertising data and the scan response data.
+ */
+static void advertising_data_set(void)
+{
+    uint32_t      err_code;
+    ble_advdata_t advdata;
+    ble_advdata_t scanrsp;
+    uint8_t       flags = BLE_GAP_ADV_FLAGS_LE_ONLY_LIMITED_DISC_MODE;
+#if APP_ADV_SENSOR_BROADCAST
+    ble_advdata_manuf_data_t manuf_data;
+#endif
+
+    // YOUR_JOB: Use UUIDs for service(s) used in your application.
+    ble_uuid_t adv_uuids[] = {{ID_UUID_SERVICE,		m_id.uuid_type},};
+    // Build and set advertising data
+    memset(&advdata, 0, sizeof(advdata));
+
+    advdata.name_type               = BLE_ADVDATA_FULL_NAME;
+    advdata.include_appearance      = true;
+    advdata.flags.size              = sizeof(flags);
+    advdata.flags.p_data            = &flags;
+	
+    //advdata.uuids_complete.uuid_cnt = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
+    //advdata.uuids_complete.p_uuids  = adv_uuids;
+#if APP_ADV_SENSOR_BROADCAST
+    manuf_data.company_identifier = APP_COMPANY_IDENTIFIER;
+    manuf_data.data.size          = sizeof(m_adv_sensor_data);
+    manuf_data.data.p_data        = m_adv_sensor_data;
+    advdata.p_manuf_specific_data = &manuf_data;
+#endif
+	memset(&scanrsp, 0, sizeof(scanrsp));
+	scanrsp.uuids_complete.uuid_cnt = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
+    scanrsp.uuids_complete.p_uuids  = adv_uuids;
+
+    // Passes the encoded data to sd_ble_gap_adv_data_set(), which may be called while advertising.
+    err_code = ble_advdata_set(&advdata, &scanrsp);
+    APP_ERROR_CHECK(err_code);
+}
+
+#if APP_ADV_SENSOR_BROADCAST
+/**@brief Function for rounding a value to the nearest integer within a field of the advertising data.
+ *
+ * @note A float out of the range of the integer type is undefined behaviour when cast, so a sensor fault
+ *       could put any byte on the air. NaN gives min_value.
  */
+static int32_t advertising_field_value(float value, int32_t min_value, int32_t max_value)
+{
+	if (!(value > min_value))
+		return min_value;
+	if (value >= max_value)
+		return max_value;
+	return (int32_t)((value < 0) ? value - 0.5f : value + 0.5f);
+}
+
+/**@brief Function for putting a sample into the manufacturer specific data of the advertising packet.
+ *
+ * @details The layout is described at APP_ADV_SENSOR_DATA_LENGTH. The advertising data is set again, 
+ *          so that passive scanners get the sample without a connection.
+ *
+ * @param[in]   p_sensor   The sample.
+ */
+static void advertising_sensor_update(const SensorData * p_sensor)
+{
+	uint8_t  index = 0;
+	
+	m_adv_sensor_data[index++] = APP_ADV_SENSOR_FORMAT;
+	m_adv_sensor_data[index++] = ++m_adv_sensor_sequence;
+	index += uint16_encode((uint16_t)advertising_field_value(p_sensor->pm2_5, 0, UINT16_MAX), &m_adv_sensor_data[index]);
+	index += uint16_encode((uint16_t)advertising_field_value(p_sensor->tvoc * 1000, 0, UINT16_MAX), &m_adv_sensor_data[index]);
+	m_adv_sensor_data[index++] = (uint8_t)(int8_t)advertising_field_value(p_sensor->temperature, INT8_MIN, INT8_MAX);
+	m_adv_sensor_data[index++] = (uint8_t)advertising_field_value(p_sensor->humidity, 0, 100);
+	m_adv_sensor_data[index++] = al_get_battery_capacity();
+	
+	advertising_data_set();
+}
+#endif
+
+/**@brief Function for handling a completed sensor acquisition.
+ */
+static void sensor_data_handler(const SensorData * p_sensor)
+{
+	m_sensor = *p_sensor;
+	LogSensorData(p_sensor);                       //Kept in flash for AL_COMMAND_OL_DATA, connected or not.
+	ble_iaq_on_pm25_change(&m_iaq, p_sensor->pm2_5);   //Readable at once, notified when changed.
+	ble_iaq_on_tvoc_change(&m_iaq, p_sensor->tvoc);
+	ble_iaq_on_temp_change(&m_iaq, p_sensor->temperature);
+	ble_iaq_on_humi_change(&m_iaq, p_sensor->humidity);
+#if APP_ADV_SENSOR_BROADCAST
+	advertising_sensor_update(p_sensor);               //Broadcast to passive scanners.
+#endif
+	pass_to_al_sensor_data(m_sensor);
+	SmartAdapt(m_sensor);                          //The LEDs change with the sample only.
+}
+
 static void sample_start_handler(void * p_context)    //Every (3*5=)15s sample one time ;every 3s change one lcd page.
 {
 	if(0 == SampleTickTack)
 	{
-		GetSensorData(&m_sensor);
-		pass_to_al_sensor_data(m_sensor);
+		StartSensorAcquisition(sensor_data_handler);  //Returns at once, the stages run from the timer and ADC events.
 	}
 	LcdDisplaySensorData(m_sensor,SampleTickTack);
 	if(++SampleTickTack >= LCD_SHOW_PAGE )
@@ -184,14 +282,6 @@ static void sample_timers_start(void)
 		sample_start_handler(NULL);
 }
 
-/**@brief Function for stopping tcl timer.
-*/
-static void sample_timers_stop(void)
-{
-    uint32_t err_code = app_timer_stop(m_sample_timer_id);
-    APP_ERROR_CHECK(err_code);
-}
-
 
 
 /**@brief Function for the Timer initialization.
@@ -257,29 +347,7 @@ static void gap_params_init(void)
  */
 static void advertising_init(void)
 {
-    uint32_t      err_code;
-    ble_advdata_t advdata;
-    ble_advdata_t scanrsp;
-    uint8_t       flags = BLE_GAP_ADV_FLAGS_LE_ONLY_LIMITED_DISC_MODE;
-
-    // YOUR_JOB: Use UUIDs for service(s) used in your application.
-    ble_uuid_t adv_uuids[] = {{ID_UUID_SERVICE,		m_id.uuid_type},};
-    // Build and set advertising data
-    memset(&advdata, 0, sizeof(advdata));
-
-    advdata.name_type               = BLE_ADVDATA_FULL_NAME;
-    advdata.include_appearance      = true;
-    advdata.flags.size              = sizeof(flags);
-    advdata.flags.p_data            = &flags;
-	
-    //advdata.uuids_complete.uuid_cnt = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
-    //advdata.uuids_complete.p_uuids  = adv_uuids;
-	memset(&scanrsp, 0, sizeof(scanrsp));
-	scanrsp.uuids_complete.uuid_cnt = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
-    scanrsp.uuids_complete.p_uuids  = adv_uuids;
-
-    err_code = ble_advdata_set(&advdata, &scanrsp);
-    APP_ERROR_CHECK(err_code);
+    advertising_data_set();
 	
 	memset(&adv_params, 0, sizeof(adv_params));
 
@@ -319,6 +387,14 @@ static void add_uart_service()
 	APP_ERROR_CHECK(err_code);
 }
 
+static void add_iaq_service()
+{
+  uint32_t err_code;
+	ble_iaq_init_t iaq_init; // The content of this structure is dummy that should be ignored.
+	err_code = ble_iaq_init(&m_iaq, &iaq_init);
+	APP_ERROR_CHECK(err_code);
+}
+
 /**@brief Function for initializing services that will be used by the application.
  */
 static void services_init(void)
@@ -326,6 +402,7 @@ static void services_init(void)
 	// Add ID Sevice to BLE Stack
 	add_id_service();
 	add_uart_service();
+	add_iaq_service();
 }
 
 
@@ -357,6 +434,10 @@ static void on_conn_params_evt(ble_conn_params_evt_t * p_evt)
 {
     uint32_t err_code;
 
+    if (ble_conn_policy_on_conn_params_evt(p_evt))
+    {
+        return; // The central refused the bulk profile, the policy falls back to the idle one.
+    }
     if(p_evt->evt_type == BLE_CONN_PARAMS_EVT_FAILED)
     {
         err_code = sd_ble_gap_disconnect(m_conn_handle, BLE_HCI_CONN_INTERVAL_UNACCEPTABLE);
@@ -397,6 +478,26 @@ static void conn_params_init(void)
     APP_ERROR_CHECK(err_code);
 }
 
+/**@brief Function for initializing the Connection Parameters Policy module.
+ *
+ * @details The idle profile is the one of gap_params_init(). The bulk profile is requested while the
+ *          Protocol has data on the way.
+ */
+static void conn_policy_init(void)
+{
+    uint32_t               err_code;
+    ble_conn_policy_init_t policy_init;
+
+    policy_init.busy_handler                  = protocol_is_busy;
+    policy_init.idle_params.min_conn_interval = MIN_CONN_INTERVAL;
+    policy_init.idle_params.max_conn_interval = MAX_CONN_INTERVAL;
+    policy_init.idle_params.slave_latency     = SLAVE_LATENCY;
+    policy_init.idle_params.conn_sup_timeout  = CONN_SUP_TIMEOUT;
+
+    err_code = ble_conn_policy_init(&policy_init);
+    APP_ERROR_CHECK(err_code);
+}
+
 /**@brief Function for handling the Application's BLE Stack events.
  *
  * @param[in]   p_ble_evt   Bluetooth stack event.
@@ -411,35 +512,16 @@ static void on_ble_evt(ble_evt_t * p_ble_evt)
     {
         case BLE_GAP_EVT_CONNECTED:
 			adv_timers_stop();
-			sample_timers_start();               //<Add by @Mida 2015-6-9>
 			
             nrf_gpio_pin_set(CONNECTED_LED_PIN_NO);
             //nrf_gpio_pin_clear(ADVERTISING_LED_PIN_NO);
             m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
-
-            /* YOUR_JOB: Uncomment this part if you are using the app_button module to handle button
-                         events (assuming that the button events are only needed in connected
-                         state). If this is uncommented out here,
-                            1. Make sure that app_button_disable() is called when handling
-                               BLE_GAP_EVT_DISCONNECTED below.
-                            2. Make sure the app_button module is initialized.
-			*/
-            //err_code = app_button_enable();
-            //APP_ERROR_CHECK(err_code);
             break;
 
         case BLE_GAP_EVT_DISCONNECTED:
             nrf_gpio_pin_clear(CONNECTED_LED_PIN_NO);
             m_conn_handle = BLE_CONN_HANDLE_INVALID;
-
-            /* YOUR_JOB: Uncomment this part if you are using the app_button module to handle button
-                         events. This should be done to save power when not connected
-                         to a peer.
-            */
-            //err_code = app_button_disable();
-            //APP_ERROR_CHECK(err_code);
 			
-			sample_timers_stop();
       adv_timers_start();			
 			advertising_start();						//<Add by @Mida 2015-6-9>
 			
@@ -504,9 +586,12 @@ static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
 {
     on_ble_evt(p_ble_evt);
     ble_conn_params_on_ble_evt(p_ble_evt);
+    ble_conn_policy_on_ble_evt(p_ble_evt);
 	// Dispatch the event to the Sevice Event Handler.
     ble_id_on_ble_evt(&m_id, p_ble_evt); // ID Sevice Event Handler.
     ble_uart_on_ble_evt(&m_uart, p_ble_evt); // Uart Sevice Event Handler.
+    ble_iaq_on_ble_evt(&m_iaq, p_ble_evt); // Instant Air Quality Sevice Event Handler.
+    protocol_on_ble_evt(p_ble_evt); // Notification queue of the Protocol.
 }
 
 
@@ -520,6 +605,7 @@ static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
 static void sys_evt_dispatch(uint32_t sys_evt)
 {
     pstorage_sys_event_handler(sys_evt);
+    AdcOnSysEvt(sys_evt);
 }
 
 
@@ -551,20 +637,47 @@ static void scheduler_init(void)
     APP_SCHED_INIT(SCHED_MAX_EVENT_DATA_SIZE, SCHED_QUEUE_SIZE);
 }
 
-/**@brief Function for initializing the GPIOTE handler module.
+/**@brief Function for initializing the persistent storage module.
  */
-static void gpiote_init(void)
+static void storage_init(void)
 {
-    APP_GPIOTE_INIT(APP_GPIOTE_MAX_USERS);
+    uint32_t err_code = pstorage_init();
+    APP_ERROR_CHECK(err_code);
 }
 
 
 /**@brief Function for the Power manager.
+ *
+ * @details Sleeps until the next event and counts the time awake and asleep in RTC1 ticks.
  */
 static void power_manage(void)
 {
+    uint32_t        ticks;
+    uint32_t        elapsed;
+
+    app_timer_cnt_get(&ticks);
+    app_timer_cnt_diff_compute(ticks, m_power_wake_ticks, &elapsed);
+    m_power_statistics.awake_ticks += elapsed;
+
     uint32_t err_code = sd_app_evt_wait();
     APP_ERROR_CHECK(err_code);
+
+    app_timer_cnt_get(&m_power_wake_ticks);
+    app_timer_cnt_diff_compute(m_power_wake_ticks, ticks, &elapsed);
+    m_power_statistics.sleep_ticks += elapsed;
+    m_power_statistics.wakeups++;
+}
+
+/**@brief Function for getting the time spent awake and asleep.
+ *
+ * @param[out]  p_statistics	Pointer to the statistics.
+ */
+void power_get_statistics(power_statistics_t* p_statistics)
+{
+    uint8_t nested = 0;
+    sd_nvic_critical_region_enter(&nested);     // The 64-bit totals are not read in one access.
+    *p_statistics = m_power_statistics;
+    sd_nvic_critical_region_exit(nested);
 }
 
 /**@brief Function for initializing the Transport Protocol module.
@@ -582,9 +695,9 @@ int main(void)
 {
     // Initialize	
     timers_init();
-    gpiote_init();
     ble_stack_init();
     scheduler_init();    
+    storage_init();
     gap_params_init();
 			
 	// Attention that the order of the following two init functions must be fixed.
@@ -593,9 +706,11 @@ int main(void)
     advertising_init();
 	// }
     conn_params_init();
+    conn_policy_init();
     sec_params_init();
 			
-		init_rx_buffer_queue_evt(al_recv_buffer_queue);
+		packet_pool_init();                         //The buffers of the RX buffer queue and of the Transport Protocol.
+		init_rx_buffer_queue_evt();
 		InitAirPurifier();
 	
 	// Init the Transport Protocol Module.
@@ -607,12 +722,15 @@ int main(void)
 	
     // Enter main loop
 		LcdDisplayInit();
+		sample_timers_start();                  //Samples all the time, the offline log needs them.
+		SmartAdapt(m_sensor);			//<2015-8-7>For testing LEDs, again after each sample.
+    app_timer_cnt_get(&m_power_wake_ticks);  // The first awake time counts from here, not from the reset.
     for (;;)
     {
+        // The RX packets, the samples and the LEDs all come as scheduler events.
         app_sched_execute();
-				rx_buffer_queue_evt_schedule();
-				SmartAdapt(m_sensor);			//<2015-8-7>For testing LEDs
-        //power_manage();
+        protocol_prepare_sleep();           // The TCL timer runs only while a packet is on the way.
+        power_manage();
     }
 }
 
@@ -0,0 +1,16 @@
+/* Host copy of crc16_compute() of the SDK, Source/app_common/crc16.c, for the host tests. */
+#include <stddef.h>
+#include <crc16.h>
+
+uint16_t crc16_compute(const uint8_t * p_data, uint32_t size, const uint16_t * p_crc)
+{
+	uint16_t crc = (p_crc == NULL) ? 0xffff : *p_crc;
+	for (uint32_t i = 0; i < size; i++) {
+		crc  = (unsigned char)(crc >> 8) | (crc << 8);
+		crc ^= p_data[i];
+		crc ^= (unsigned char)(crc & 0xff) >> 4;
+		crc ^= (crc << 8) << 4;
+		crc ^= ((crc & 0xff) << 4) << 1;
+	}
+	return crc;
+}
@@ -0,0 +1,123 @@
+/* Host simulation of pstorage on a RAM flash.
+ *
+ * Every module is one page. Stores and clears are queued and run by SimFlashRun(), a store reads its source
+ * only then, as the SoftDevice does, and only clears bits. Loads are immediate.
+ */
+#include <string.h>
+#include <pstorage.h>
+#include "pstorage_sim.h"
+
+typedef struct {
+	uint8_t           uOpCode;
+	pstorage_handle_t handle;
+	uint8_t           *pSrc;
+	pstorage_size_t   uSize;
+} SimFlashOp;
+
+uint8_t SimFlash[SIM_FLASH_PAGE_COUNT * SIM_FLASH_PAGE_SIZE];
+bool    SimFlashFailNext = false;
+
+static pstorage_ntf_cb_t sSimFlashCallbacks[SIM_FLASH_PAGE_COUNT];
+static uint32_t   suSimFlashModules = 0;
+static SimFlashOp sSimFlashQueue[SIM_FLASH_QUEUE_SIZE];
+static uint32_t   suSimFlashHead = 0;
+static uint32_t   suSimFlashTail = 0;
+
+static uint32_t SimFlashQueue(uint8_t uOpCode, pstorage_handle_t *pHandle, uint8_t *pSrc, pstorage_size_t uSize)
+{
+	if (SIM_FLASH_QUEUE_SIZE == suSimFlashTail - suSimFlashHead)
+		return NRF_ERROR_NO_MEM;
+	SimFlashOp *pOp = &sSimFlashQueue[suSimFlashTail++ % SIM_FLASH_QUEUE_SIZE];
+	pOp->uOpCode = uOpCode;
+	pOp->handle = *pHandle;
+	pOp->pSrc = pSrc;
+	pOp->uSize = uSize;
+	return NRF_SUCCESS;
+}
+
+uint32_t pstorage_init(void)
+{
+	return NRF_SUCCESS;
+}
+
+uint32_t pstorage_register(pstorage_module_param_t *p_module_param, pstorage_handle_t *p_block_id)
+{
+	if (SIM_FLASH_PAGE_COUNT == suSimFlashModules
+	    || p_module_param->block_size * p_module_param->block_count > SIM_FLASH_PAGE_SIZE)
+		return NRF_ERROR_NO_MEM;
+	sSimFlashCallbacks[suSimFlashModules] = p_module_param->cb;
+	p_block_id->module_id = suSimFlashModules;
+	p_block_id->block_id = suSimFlashModules * SIM_FLASH_PAGE_SIZE;
+	suSimFlashModules++;
+	return NRF_SUCCESS;
+}
+
+uint32_t pstorage_block_identifier_get(pstorage_handle_t *p_base_id, pstorage_size_t block_num, pstorage_handle_t *p_block_id)
+{
+	//The block size is not kept, the sensor log and the tests use 16 bytes.
+	if (block_num >= SIM_FLASH_PAGE_SIZE / PSTORAGE_MIN_BLOCK_SIZE)
+		return NRF_ERROR_INVALID_PARAM;
+	p_block_id->module_id = p_base_id->module_id;
+	p_block_id->block_id = p_base_id->block_id + block_num * PSTORAGE_MIN_BLOCK_SIZE;
+	return NRF_SUCCESS;
+}
+
+uint32_t pstorage_store(pstorage_handle_t *p_dest, uint8_t *p_src, pstorage_size_t size, pstorage_size_t offset)
+{
+	pstorage_handle_t handle = *p_dest;
+	handle.block_id += offset;
+	if (handle.block_id + size > sizeof(SimFlash))
+		return NRF_ERROR_INVALID_PARAM;
+	return SimFlashQueue(PSTORAGE_STORE_OP_CODE, &handle, p_src, size);
+}
+
+uint32_t pstorage_load(uint8_t *p_dest, pstorage_handle_t *p_src, pstorage_size_t size, pstorage_size_t offset)
+{
+	if (p_src->block_id + offset + size > sizeof(SimFlash))
+		return NRF_ERROR_INVALID_PARAM;
+	memcpy(p_dest, &SimFlash[p_src->block_id + offset], size);
+	return NRF_SUCCESS;
+}
+
+uint32_t pstorage_clear(pstorage_handle_t *p_base_id, pstorage_size_t size)
+{
+	return SimFlashQueue(PSTORAGE_CLEAR_OP_CODE, p_base_id, NULL, size);
+}
+
+uint32_t SimFlashRun(uint32_t uCount)
+{
+	uint32_t uRun = 0;
+	while (uRun < uCount && suSimFlashHead != suSimFlashTail) {
+		SimFlashOp op = sSimFlashQueue[suSimFlashHead++ % SIM_FLASH_QUEUE_SIZE];
+		uint32_t uResult = SimFlashFailNext ? NRF_ERROR_TIMEOUT : NRF_SUCCESS;
+		SimFlashFailNext = false;
+		if (NRF_SUCCESS == uResult) {
+			if (PSTORAGE_CLEAR_OP_CODE == op.uOpCode) {
+				memset(&SimFlash[op.handle.block_id], 0xFF, op.uSize);
+			} else {
+				for (uint32_t i = 0; i < op.uSize; i++)
+					SimFlash[op.handle.block_id + i] &= op.pSrc[i];     //Programming only clears bits.
+			}
+		}
+		sSimFlashCallbacks[op.handle.module_id](&op.handle, op.uOpCode, uResult, op.pSrc, op.uSize);
+		uRun++;
+	}
+	return uRun;
+}
+
+uint32_t SimFlashQueued(void)
+{
+	return suSimFlashTail - suSimFlashHead;
+}
+
+void SimFlashReset(void)
+{
+	suSimFlashHead = suSimFlashTail;
+	suSimFlashModules = 0;
+}
+
+void SimFlashErase(void)
+{
+	memset(SimFlash, 0xFF, sizeof(SimFlash));
+	SimFlashReset();
+}
@@ -0,0 +1,26 @@
+/* Host simulation of pstorage on a RAM flash, for the host tests. */
+#ifndef PSTORAGE_SIM_H
+#define PSTORAGE_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pstorage.h>
+
+#define SIM_FLASH_PAGE_SIZE         1024
+#define SIM_FLASH_PAGE_COUNT        PSTORAGE_MAX_APPLICATIONS   //One page per registered module
+#define SIM_FLASH_QUEUE_SIZE        PSTORAGE_CMD_QUEUE_SIZE
+
+extern uint8_t SimFlash[SIM_FLASH_PAGE_COUNT * SIM_FLASH_PAGE_SIZE];
+extern bool    SimFlashFailNext;            //The next operation run reports NRF_ERROR_TIMEOUT and leaves the flash
+
+/**@brief Run up to uCount queued operations, the oldest first, and call back for each. Returns the number run. */
+uint32_t SimFlashRun(uint32_t uCount);
+
+uint32_t SimFlashQueued(void);
+
+/**@brief A reset: the queued operations are lost, the flash stays, the modules must register again. */
+void SimFlashReset(void);
+
+void SimFlashErase(void);                   //Every page back to 0xFF, and a reset
+
+#endif
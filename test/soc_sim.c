@@ -0,0 +1,211 @@
+/* Host simulation of the SoftDevice calls and of app_scheduler, shared by the host tests.
+ *
+ * The critical region is a recursive mutex, so that a test thread may play the interrupt.
+ */
+#define _GNU_SOURCE                 //PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP
+#include <pthread.h>
+#include <string.h>
+#include <nrf_soc.h>
+#include <app_scheduler.h>
+#include <app_timer.h>
+#include "soc_sim.h"
+
+#define SIM_TIMER_COUNT             8
+#define SIM_RTC_MASK                0x00FFFFFF  //RTC1 counts 24 bits
+
+typedef struct {
+	app_timer_timeout_handler_t handler;
+	app_timer_mode_t            mode;
+	bool                        bRunning;
+	uint32_t                    uPeriod;
+	uint32_t                    uLeft;
+	void                        *pContext;
+} SimTimer;
+
+typedef struct {
+	app_sched_event_handler_t handler;
+	uint16_t                  size;
+	uint8_t                   data[SIM_SCHED_EVENT_SIZE];
+} SimSchedEvent;
+
+bool     SimHfclkRunning = false;
+uint32_t SimHfclkRequests = 0;
+uint16_t SimSchedCapacity = SIM_SCHED_QUEUE_SIZE;
+uint32_t SimGpioIn = 0;
+uint32_t SimPpiEnabled = 0;
+const volatile void *SimPpiEep[16];
+const volatile void *SimPpiTep[16];
+
+static pthread_mutex_t sCritical = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static SimSchedEvent   sSchedQueue[SIM_SCHED_QUEUE_SIZE];
+static uint16_t        snSchedRead = 0;
+static uint16_t        snSchedCount = 0;
+static SimTimer        sTimers[SIM_TIMER_COUNT];
+static uint8_t         snTimers = 0;
+static uint32_t        suRtcCounter = 0;
+
+uint32_t sd_nvic_critical_region_enter(uint8_t * p_is_nested_critical_region)
+{
+	pthread_mutex_lock(&sCritical);
+	*p_is_nested_critical_region = 0;
+	return NRF_SUCCESS;
+}
+
+uint32_t sd_nvic_critical_region_exit(uint8_t is_nested_critical_region)
+{
+	(void)is_nested_critical_region;
+	pthread_mutex_unlock(&sCritical);
+	return NRF_SUCCESS;
+}
+
+uint32_t sd_nvic_ClearPendingIRQ(IRQn_Type IRQn) { (void)IRQn; return NRF_SUCCESS; }
+uint32_t sd_nvic_SetPendingIRQ(IRQn_Type IRQn) { (void)IRQn; return NRF_SUCCESS; }
+uint32_t sd_nvic_SetPriority(IRQn_Type IRQn, uint32_t priority) { (void)IRQn; (void)priority; return NRF_SUCCESS; }
+uint32_t sd_nvic_EnableIRQ(IRQn_Type IRQn) { (void)IRQn; return NRF_SUCCESS; }
+
+uint32_t sd_clock_hfclk_request(void)
+{
+	SimHfclkRequests++;
+	return NRF_SUCCESS;
+}
+
+uint32_t sd_clock_hfclk_release(void)
+{
+	if (0 != SimHfclkRequests)
+		SimHfclkRequests--;
+	return NRF_SUCCESS;
+}
+
+uint32_t sd_clock_hfclk_is_running(uint32_t * p_is_running)
+{
+	*p_is_running = SimHfclkRunning;
+	return NRF_SUCCESS;
+}
+
+uint32_t sd_ppi_channel_assign(uint8_t channel_num, const volatile void * evt_endpoint, const volatile void * task_endpoint)
+{
+	SimPpiEep[channel_num] = evt_endpoint;
+	SimPpiTep[channel_num] = task_endpoint;
+	return NRF_SUCCESS;
+}
+
+uint32_t sd_ppi_channel_enable_set(uint32_t channel_enable_set_msk)
+{
+	SimPpiEnabled |= channel_enable_set_msk;
+	return NRF_SUCCESS;
+}
+
+uint32_t sd_ppi_channel_enable_clr(uint32_t channel_enable_clr_msk)
+{
+	SimPpiEnabled &= ~channel_enable_clr_msk;
+	return NRF_SUCCESS;
+}
+
+bool SimPpiConnected(const volatile void *pEvent, const volatile void *pTask)
+{
+	for (int i = 0; i < 16; i++)
+		if ((SimPpiEnabled & (1UL << i)) && pEvent == SimPpiEep[i] && pTask == SimPpiTep[i])
+			return true;
+	return false;
+}
+
+uint32_t app_timer_create(app_timer_id_t * p_timer_id, app_timer_mode_t mode, app_timer_timeout_handler_t timeout_handler)
+{
+	if (SIM_TIMER_COUNT == snTimers)
+		return NRF_ERROR_NO_MEM;
+	sTimers[snTimers].handler = timeout_handler;
+	sTimers[snTimers].mode = mode;
+	sTimers[snTimers].bRunning = false;
+	*p_timer_id = snTimers++;
+	return NRF_SUCCESS;
+}
+
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void * p_context)
+{
+	if (timer_id >= snTimers || timeout_ticks < APP_TIMER_MIN_TIMEOUT_TICKS)
+		return NRF_ERROR_INVALID_PARAM;
+	sTimers[timer_id].bRunning = true;
+	sTimers[timer_id].uPeriod = timeout_ticks;
+	sTimers[timer_id].uLeft = timeout_ticks;
+	sTimers[timer_id].pContext = p_context;
+	return NRF_SUCCESS;
+}
+
+uint32_t app_timer_stop(app_timer_id_t timer_id)
+{
+	if (timer_id >= snTimers)
+		return NRF_ERROR_INVALID_PARAM;
+	sTimers[timer_id].bRunning = false;
+	return NRF_SUCCESS;
+}
+
+uint32_t app_timer_cnt_get(uint32_t * p_ticks)
+{
+	*p_ticks = suRtcCounter;
+	return NRF_SUCCESS;
+}
+
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from, uint32_t * p_ticks_diff)
+{
+	*p_ticks_diff = (ticks_to - ticks_from) & SIM_RTC_MASK;
+	return NRF_SUCCESS;
+}
+
+void SimTimerAdvance(uint32_t uTicks)
+{
+	while (uTicks--) {
+		suRtcCounter = (suRtcCounter + 1) & SIM_RTC_MASK;
+		for (uint8_t i = 0; i < snTimers; i++) {
+			SimTimer *pTimer = &sTimers[i];
+			if (!pTimer->bRunning || 0 != --pTimer->uLeft)
+				continue;
+			if (APP_TIMER_MODE_REPEATED == pTimer->mode)
+				pTimer->uLeft = pTimer->uPeriod;
+			else
+				pTimer->bRunning = false;
+			pTimer->handler(pTimer->pContext);
+		}
+	}
+}
+
+uint32_t app_sched_event_put(void * p_event_data, uint16_t event_size, app_sched_event_handler_t handler)
+{
+	uint32_t uErrCode = NRF_SUCCESS;
+	if (event_size > SIM_SCHED_EVENT_SIZE)
+		return NRF_ERROR_INVALID_LENGTH;
+	pthread_mutex_lock(&sCritical);
+	if (snSchedCount >= SimSchedCapacity) {
+		uErrCode = NRF_ERROR_NO_MEM;
+	} else {
+		SimSchedEvent *pEvent = &sSchedQueue[(snSchedRead + snSchedCount) % SIM_SCHED_QUEUE_SIZE];
+		pEvent->handler = handler;
+		pEvent->size = event_size;
+		if (NULL != p_event_data)
+			memcpy(pEvent->data, p_event_data, event_size);
+		snSchedCount++;
+	}
+	pthread_mutex_unlock(&sCritical);
+	return uErrCode;
+}
+
+void app_sched_execute(void)
+{
+	for (;;) {
+		SimSchedEvent event;
+		pthread_mutex_lock(&sCritical);
+		if (0 == snSchedCount) {
+			pthread_mutex_unlock(&sCritical);
+			return;
+		}
+		event = sSchedQueue[snSchedRead];
+		snSchedRead = (snSchedRead + 1) % SIM_SCHED_QUEUE_SIZE;
+		snSchedCount--;
+		pthread_mutex_unlock(&sCritical);
+		event.handler(0 == event.size ? NULL : event.data, event.size);
+	}
+}
+
+uint16_t SimSchedDepth(void)
+{
+	return snSchedCount;
+}
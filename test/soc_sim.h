@@ -0,0 +1,28 @@
+/* Host simulation of the SoftDevice calls and of app_scheduler, shared by the host tests. */
+#ifndef SOC_SIM_H
+#define SOC_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SIM_SCHED_QUEUE_SIZE        20      //As SCHED_QUEUE_SIZE of main.c
+#define SIM_SCHED_EVENT_SIZE        32
+
+extern bool     SimHfclkRunning;            //sd_clock_hfclk_is_running() reports it
+extern uint32_t SimHfclkRequests;           //Outstanding sd_clock_hfclk_request() calls
+extern uint16_t SimSchedCapacity;           //Events the scheduler takes, SIM_SCHED_QUEUE_SIZE at most
+
+extern uint32_t SimGpioIn;                  //Level of every pin
+extern uint32_t SimPpiEnabled;              //Mask of the enabled PPI channels
+extern const volatile void *SimPpiEep[16];
+extern const volatile void *SimPpiTep[16];
+
+uint16_t SimSchedDepth(void);
+
+/**@brief Let the RTC1 counter run, the app_timer handlers due in the time run at once. */
+void SimTimerAdvance(uint32_t uTicks);
+
+/**@brief Whether a task is triggered by an event through an enabled PPI channel. */
+bool SimPpiConnected(const volatile void *pEvent, const volatile void *pTask);
+
+#endif
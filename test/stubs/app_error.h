@@ -0,0 +1,16 @@
+/* Host stand-in for the SDK error handler, an error stops the test. */
+#ifndef APP_ERROR_H__
+#define APP_ERROR_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define APP_ERROR_CHECK(ERR_CODE) do { \
+		if (0 != (ERR_CODE)) { \
+			printf("%s:%d: error %u\n", __FILE__, __LINE__, (unsigned)(ERR_CODE)); \
+			abort(); \
+		} \
+	} while (0)
+
+#endif
@@ -0,0 +1,12 @@
+/* Host stand-in for the SDK scheduler, implemented by soc_sim.c. */
+#ifndef APP_SCHEDULER_H__
+#define APP_SCHEDULER_H__
+
+#include "nrf.h"
+
+typedef void (*app_sched_event_handler_t)(void * p_event_data, uint16_t event_size);
+
+uint32_t app_sched_event_put(void * p_event_data, uint16_t event_size, app_sched_event_handler_t handler);
+void app_sched_execute(void);
+
+#endif
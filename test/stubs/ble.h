@@ -0,0 +1,46 @@
+/* Host stand-in for the SoftDevice BLE API, only the types the protocol headers use. */
+#ifndef BLE_H__
+#define BLE_H__
+
+#include "nrf_soc.h"
+
+#define BLE_ERROR_NO_TX_BUFFERS     0x3004
+#define BLE_CONN_HANDLE_INVALID     0xFFFF
+
+#define BLE_EVT_TX_COMPLETE         0x01
+#define BLE_GAP_EVT_CONNECTED       0x10
+#define BLE_GAP_EVT_DISCONNECTED    0x11
+
+typedef struct {
+	uint16_t evt_id;
+	uint16_t evt_len;
+} ble_evt_hdr_t;
+
+typedef struct {
+	ble_evt_hdr_t header;
+	union {
+		struct {
+			uint16_t conn_handle;
+			union {
+				struct {
+					uint8_t count;
+				} tx_complete;
+			} params;
+		} common_evt;
+		uint8_t raw[64];
+	} evt;
+} ble_evt_t;
+
+typedef struct {
+	uint16_t value_handle;
+	uint16_t user_desc_handle;
+	uint16_t cccd_handle;
+	uint16_t sccd_handle;
+} ble_gatts_char_handles_t;
+
+typedef struct {
+	uint16_t uuid;
+	uint8_t  type;
+} ble_uuid_t;
+
+#endif
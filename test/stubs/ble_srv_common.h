@@ -0,0 +1,7 @@
+/* Host stand-in for the SDK service helpers, nothing is used but the include. */
+#ifndef BLE_SRV_COMMON_H__
+#define BLE_SRV_COMMON_H__
+
+#include "ble.h"
+
+#endif
@@ -0,0 +1,5 @@
+/* Host stand-in for the board definitions of the SDK, the pins are in pin.h. */
+#ifndef BOARDS_H
+#define BOARDS_H
+
+#endif
@@ -0,0 +1,9 @@
+/* Host stand-in for the SDK CRC-16 header, implemented by crc16_sim.c. */
+#ifndef CRC16_H__
+#define CRC16_H__
+
+#include <stdint.h>
+
+uint16_t crc16_compute(const uint8_t * p_data, uint32_t size, const uint16_t * p_crc);
+
+#endif
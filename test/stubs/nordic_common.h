@@ -0,0 +1,8 @@
+/* Host stand-in for the SDK common macros, only what the host tests use. */
+#ifndef NORDIC_COMMON_H__
+#define NORDIC_COMMON_H__
+
+#define MIN(a, b)                   ((a) < (b) ? (a) : (b))
+#define MAX(a, b)                   ((a) < (b) ? (b) : (a))
+
+#endif
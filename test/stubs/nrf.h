@@ -0,0 +1,105 @@
+/* Host stand-in for the nRF51 device header, only what the host tests use.
+ * The peripherals are plain structures in RAM, the tests play the hardware on them.
+ */
+#ifndef NRF_H
+#define NRF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define __INLINE                    inline
+#define __DMB()                     __sync_synchronize()   //The host test may run the interrupt on a thread
+
+#define NRF_SUCCESS                 0
+#define NRF_ERROR_NOT_FOUND         5
+#define NRF_ERROR_NO_MEM            4
+#define NRF_ERROR_INVALID_PARAM     7
+#define NRF_ERROR_INVALID_STATE     8
+#define NRF_ERROR_INVALID_LENGTH    9
+#define NRF_ERROR_INVALID_DATA      11
+#define NRF_ERROR_DATA_SIZE         12
+#define NRF_ERROR_TIMEOUT           13
+#define NRF_ERROR_NULL              14
+#define NRF_ERROR_BUSY              17
+
+typedef enum {
+	GPIOTE_IRQn = 6,
+	ADC_IRQn = 7,
+	TIMER1_IRQn = 9,
+	TIMER2_IRQn = 10,
+	RTC1_IRQn = 17,
+	SWI0_IRQn = 20
+} IRQn_Type;
+
+typedef struct {
+	volatile uint32_t TASKS_START;
+	volatile uint32_t TASKS_STOP;
+	volatile uint32_t EVENTS_END;
+	volatile uint32_t INTENSET;
+	volatile uint32_t INTENCLR;
+	volatile uint32_t BUSY;
+	volatile uint32_t ENABLE;
+	volatile uint32_t CONFIG;
+	volatile uint32_t RESULT;
+} NRF_ADC_Type;
+
+extern NRF_ADC_Type         SimAdc;
+#define NRF_ADC             (&SimAdc)
+
+#define ADC_INTENSET_END_Msk                              (1UL)
+#define ADC_INTENCLR_END_Msk                              (1UL)
+#define ADC_RESULT_RESULT_Msk                             (0x3FFUL)
+#define ADC_CONFIG_RES_Pos                                (0UL)
+#define ADC_CONFIG_RES_10bit                              (2UL)
+#define ADC_CONFIG_INPSEL_Pos                             (2UL)
+#define ADC_CONFIG_INPSEL_AnalogInputOneThirdPrescaling   (2UL)
+#define ADC_CONFIG_REFSEL_Pos                             (5UL)
+#define ADC_CONFIG_REFSEL_VBG                             (0UL)
+#define ADC_CONFIG_PSEL_Pos                               (8UL)
+#define ADC_CONFIG_PSEL_Msk                               (0xFFUL << ADC_CONFIG_PSEL_Pos)
+#define ADC_CONFIG_PSEL_AnalogInput2                      (0x04UL)
+#define ADC_CONFIG_PSEL_AnalogInput3                      (0x08UL)
+
+typedef struct {
+	volatile uint32_t TASKS_START;
+	volatile uint32_t TASKS_STOP;
+	volatile uint32_t TASKS_COUNT;
+	volatile uint32_t TASKS_CLEAR;
+	volatile uint32_t TASKS_CAPTURE[4];
+	volatile uint32_t EVENTS_COMPARE[4];
+	volatile uint32_t SHORTS;
+	volatile uint32_t INTENSET;
+	volatile uint32_t INTENCLR;
+	volatile uint32_t MODE;
+	volatile uint32_t BITMODE;
+	volatile uint32_t PRESCALER;
+	volatile uint32_t CC[4];
+} NRF_TIMER_Type;
+
+extern NRF_TIMER_Type       SimTimer1;
+#define NRF_TIMER1          (&SimTimer1)
+
+#define TIMER_MODE_MODE_Timer                             (0UL)
+#define TIMER_BITMODE_BITMODE_16Bit                       (0UL)
+#define TIMER_SHORTS_COMPARE3_CLEAR_Msk                   (1UL << 3)
+#define TIMER_SHORTS_COMPARE3_STOP_Msk                    (1UL << 11)
+#define TIMER_INTENSET_COMPARE3_Msk                       (1UL << 19)
+#define TIMER_INTENCLR_COMPARE3_Msk                       (1UL << 19)
+
+typedef struct {
+	volatile uint32_t TASKS_OUT[4];
+	volatile uint32_t EVENTS_IN[4];
+	volatile uint32_t EVENTS_PORT;
+	volatile uint32_t INTENSET;
+	volatile uint32_t INTENCLR;
+	volatile uint32_t CONFIG[4];
+} NRF_GPIOTE_Type;
+
+extern NRF_GPIOTE_Type      SimGpiote;
+#define NRF_GPIOTE          (&SimGpiote)
+
+#define GPIOTE_INTENSET_IN0_Msk                           (1UL)
+#define GPIOTE_INTENCLR_IN0_Msk                           (1UL)
+
+#endif
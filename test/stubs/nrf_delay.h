@@ -0,0 +1,10 @@
+/* Host stand-in for the SDK delay header, the tests do not wait. */
+#ifndef NRF_DELAY_H
+#define NRF_DELAY_H
+
+#include "nrf.h"
+
+static __INLINE void nrf_delay_us(uint32_t number_of_us) { (void)number_of_us; }
+static __INLINE void nrf_delay_ms(uint32_t number_of_ms) { (void)number_of_ms; }
+
+#endif
@@ -0,0 +1,20 @@
+/* Host stand-in for the SDK GPIO header. */
+#ifndef NRF_GPIO_H__
+#define NRF_GPIO_H__
+
+#include "nrf.h"
+
+#define NRF_GPIO_PIN_NOPULL     0
+#define NRF_GPIO_PIN_PULLUP     3
+
+extern uint32_t SimGpioIn;                  //Level of every pin, set by the tests
+
+static __INLINE void nrf_gpio_cfg_output(uint32_t pin_number) { (void)pin_number; }
+static __INLINE void nrf_gpio_cfg_input(uint32_t pin_number, int pull_config) { (void)pin_number; (void)pull_config; }
+static __INLINE void nrf_gpio_pin_set(uint32_t pin_number) { (void)pin_number; }
+static __INLINE void nrf_gpio_pin_clear(uint32_t pin_number) { (void)pin_number; }
+static __INLINE void nrf_gpio_pin_toggle(uint32_t pin_number) { (void)pin_number; }
+static __INLINE void nrf_gpio_pin_write(uint32_t pin_number, uint32_t value) { (void)pin_number; (void)value; }
+static __INLINE uint32_t nrf_gpio_pin_read(uint32_t pin_number) { return (SimGpioIn >> pin_number) & 1; }
+
+#endif
@@ -0,0 +1,34 @@
+/* Host stand-in for the SDK GPIOTE header, on the simulated NRF_GPIOTE. */
+#ifndef NRF_GPIOTE_H__
+#define NRF_GPIOTE_H__
+
+#include "nrf.h"
+
+typedef enum {
+	NRF_GPIOTE_POLARITY_LOTOHI = 1,
+	NRF_GPIOTE_POLARITY_HITOLO = 2,
+	NRF_GPIOTE_POLARITY_TOGGLE = 3
+} nrf_gpiote_polarity_t;
+
+typedef enum {
+	NRF_GPIOTE_INITIAL_VALUE_LOW = 0,
+	NRF_GPIOTE_INITIAL_VALUE_HIGH = 1
+} nrf_gpiote_outinit_t;
+
+static __INLINE void nrf_gpiote_task_config(uint32_t channel_number, uint32_t pin_number,
+                                            nrf_gpiote_polarity_t polarity, nrf_gpiote_outinit_t initial_value)
+{
+	NRF_GPIOTE->CONFIG[channel_number] = 3 | (pin_number << 8) | ((uint32_t)polarity << 16) | ((uint32_t)initial_value << 20);
+}
+
+static __INLINE void nrf_gpiote_event_config(uint32_t channel_number, uint32_t pin_number, nrf_gpiote_polarity_t polarity)
+{
+	NRF_GPIOTE->CONFIG[channel_number] = 1 | (pin_number << 8) | ((uint32_t)polarity << 16);
+}
+
+static __INLINE void nrf_gpiote_unconfig(uint32_t channel_number)
+{
+	NRF_GPIOTE->CONFIG[channel_number] = 0;
+}
+
+#endif
@@ -0,0 +1,30 @@
+/* Host stand-in for the SoftDevice SoC API, implemented by soc_sim.c. */
+#ifndef NRF_SOC_H__
+#define NRF_SOC_H__
+
+#include "nrf.h"
+
+#define NRF_APP_PRIORITY_HIGH       1
+#define NRF_APP_PRIORITY_LOW        3
+
+enum {
+	NRF_EVT_HFCLKSTARTED,
+	NRF_EVT_POWER_FAILURE_WARNING,
+	NRF_EVT_FLASH_OPERATION_SUCCESS,
+	NRF_EVT_FLASH_OPERATION_ERROR
+};
+
+uint32_t sd_nvic_critical_region_enter(uint8_t * p_is_nested_critical_region);
+uint32_t sd_nvic_critical_region_exit(uint8_t is_nested_critical_region);
+uint32_t sd_nvic_ClearPendingIRQ(IRQn_Type IRQn);
+uint32_t sd_nvic_SetPendingIRQ(IRQn_Type IRQn);
+uint32_t sd_nvic_SetPriority(IRQn_Type IRQn, uint32_t priority);
+uint32_t sd_nvic_EnableIRQ(IRQn_Type IRQn);
+uint32_t sd_clock_hfclk_request(void);
+uint32_t sd_clock_hfclk_release(void);
+uint32_t sd_clock_hfclk_is_running(uint32_t * p_is_running);
+uint32_t sd_ppi_channel_assign(uint8_t channel_num, const volatile void * evt_endpoint, const volatile void * task_endpoint);
+uint32_t sd_ppi_channel_enable_set(uint32_t channel_enable_set_msk);
+uint32_t sd_ppi_channel_enable_clr(uint32_t channel_enable_clr_msk);
+
+#endif
@@ -0,0 +1,12 @@
+/* A second TCL for the host link simulation: transport.c again, its functions renamed and its state separate. */
+#define tcl_init                    peer_tcl_init
+#define tcl_send_packet             peer_tcl_send_packet
+#define tcl_recv_packet             peer_tcl_recv_packet
+#define tcl_timer_time_out          peer_tcl_timer_time_out
+#define tcl_reset                   peer_tcl_reset
+#define tcl_get_rtt                 peer_tcl_get_rtt
+#define tcl_send_status             peer_tcl_send_status
+#define tcl_recv_busy               peer_tcl_recv_busy
+#define tcl_recv_resume             peer_tcl_recv_resume
+
+#include "../Source/protocol/transport.c"
@@ -0,0 +1,17 @@
+/* The other end of the simulated link, a second TCL built from the same transport.c by tcl_peer.c. */
+#ifndef TCL_PEER_H
+#define TCL_PEER_H
+
+#include <transport.h>
+
+void peer_tcl_init(tcl_init_t* p_init);
+uint32_t peer_tcl_send_packet(packet_buf_t* p_data, uint16_t length);
+uint32_t peer_tcl_recv_packet(uint8_t* p_data, uint16_t length);
+void peer_tcl_timer_time_out(void);
+void peer_tcl_reset(void);
+void peer_tcl_get_rtt(tcl_rtt_t* p_rtt);
+tcl_send_status_t peer_tcl_send_status(void);
+bool peer_tcl_recv_busy(void);
+bool peer_tcl_recv_resume(void);
+
+#endif
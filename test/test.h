@@ -0,0 +1,24 @@
+/* Checks of the host tests. A test returns TestResult() from main(), so make stops on a failure. */
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+static int snTestChecks = 0;
+static int snTestFailures = 0;
+
+#define CHECK(cond) do { \
+		snTestChecks++; \
+		if (!(cond)) { \
+			snTestFailures++; \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+		} \
+	} while (0)
+
+static int TestResult(const char *pName)
+{
+	printf("%s: %d checks, %d failed\n", pName, snTestChecks, snTestFailures);
+	return 0 == snTestFailures ? 0 : 1;
+}
+
+#endif
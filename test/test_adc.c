@@ -0,0 +1,195 @@
+/* Host test of the ADC request queue, Source/AirPurifier/adc.c, on a simulated ADC.
+ *
+ * The simulated ADC finishes one conversion per step. The HFCLK takes SIM_HFCLK_STARTUP_STEPS steps to start,
+ * and a PPI triggered request gets one START per step from the simulated timer.
+ */
+#include <string.h>
+#include <adc.h>
+#include <nrf_soc.h>
+#include <app_scheduler.h>
+#include "soc_sim.h"
+#include "test.h"
+
+#define SIM_HFCLK_STARTUP_STEPS     3
+#define SIM_ADC_CODE(channel)       (100 + (channel))   //The voltage on every analog input
+
+NRF_ADC_Type SimAdc;
+
+void ADC_IRQHandler(void);
+
+static bool     sbSimAdcIntEnabled = false;
+static uint8_t  snSimPpiTriggers = 0;                  //STARTs left for the armed request
+static uint32_t snSimStep = 0;
+static uint32_t snSimHfclkStartStep = 0;
+
+typedef struct {
+	uint32_t uAdcValue;
+	uint32_t uContext;
+	uint32_t uLatency;
+} Result;
+
+static Result   sResults[32];
+static uint8_t  snResults = 0;
+static uint32_t snQueuedStep = 0;
+static uint8_t  snArmed = 0;
+
+static void SimAdcStep(void)
+{
+	snSimStep++;
+	if (0 != SimHfclkRequests && !SimHfclkRunning && snSimStep >= snSimHfclkStartStep) {
+		SimHfclkRunning = true;
+		AdcOnSysEvt(NRF_EVT_HFCLKSTARTED);
+	}
+	if (0 == SimHfclkRequests)
+		SimHfclkRunning = false;
+	if (0 != SimAdc.INTENCLR) {
+		sbSimAdcIntEnabled = false;
+		SimAdc.INTENCLR = 0;
+	}
+	if (0 != SimAdc.INTENSET) {
+		sbSimAdcIntEnabled = true;
+		SimAdc.INTENSET = 0;
+	}
+	if (0 != snSimPpiTriggers) {
+		snSimPpiTriggers--;
+		SimAdc.TASKS_START = 1;
+	}
+	if (0 == SimAdc.TASKS_START)
+		return;
+	SimAdc.TASKS_START = 0;
+	SimAdc.RESULT = SIM_ADC_CODE((SimAdc.CONFIG & ADC_CONFIG_PSEL_Msk) >> ADC_CONFIG_PSEL_Pos);
+	SimAdc.EVENTS_END = 1;
+	if (sbSimAdcIntEnabled)
+		ADC_IRQHandler();
+}
+
+static void SimAdcRun(uint32_t uSteps)
+{
+	if (0 != SimHfclkRequests && !SimHfclkRunning && 0 == snSimHfclkStartStep)
+		snSimHfclkStartStep = snSimStep + SIM_HFCLK_STARTUP_STEPS;
+	while (uSteps--)
+		SimAdcStep();
+}
+
+static void ResultHandler(uint32_t uAdcValue, void *pContext)
+{
+	Result *pResult = &sResults[snResults++];
+	pResult->uAdcValue = uAdcValue;
+	pResult->uContext = (uint32_t)(uintptr_t)pContext;
+	pResult->uLatency = snSimStep - snQueuedStep;
+}
+
+static void ArmHandler(void *pContext)
+{
+	snArmed++;
+	snSimPpiTriggers = (uint8_t)(uintptr_t)pContext;
+}
+
+static void Reset(void)
+{
+	memset(&SimAdc, 0, sizeof(SimAdc));
+	snResults = 0;
+	snArmed = 0;
+	snSimHfclkStartStep = 0;
+	SimHfclkRunning = false;
+	SimSchedCapacity = SIM_SCHED_QUEUE_SIZE;
+	InitAdc();
+}
+
+static void TestQueueOrder(void)
+{
+	AdcStatistics statistics;
+	Reset();
+	snQueuedStep = snSimStep;
+	for (uint32_t i = 0; i < ADC_QUEUE_LENGTH; i++)
+		CHECK(NRF_SUCCESS == StartAdc(i, ResultHandler, (void *)(uintptr_t)(10 + i)));
+	CHECK(NRF_ERROR_NO_MEM == StartAdc(0, ResultHandler, NULL));
+	CHECK(1 == SimHfclkRequests);                        //Once for the whole queue.
+	CHECK(IsAdcBusy());
+	CHECK(0 == SimAdc.TASKS_START);                      //Nothing before the HFCLK runs.
+
+	SimAdcRun(SIM_HFCLK_STARTUP_STEPS + ADC_QUEUE_LENGTH + 1);
+	CHECK(0 == snResults);                               //Handlers only run from the scheduler.
+	CHECK(ADC_QUEUE_LENGTH == SimSchedDepth());
+	app_sched_execute();
+	CHECK(ADC_QUEUE_LENGTH == snResults);
+	for (uint32_t i = 0; i < snResults; i++) {
+		CHECK(SIM_ADC_CODE(i) == sResults[i].uAdcValue);
+		CHECK(10 + i == sResults[i].uContext);
+	}
+	CHECK(!IsAdcBusy());
+	CHECK(0 == SimHfclkRequests);                        //Released with the queue empty.
+
+	GetAdcStatistics(&statistics);
+	CHECK(ADC_QUEUE_LENGTH == statistics.uRequests);
+	CHECK(ADC_QUEUE_LENGTH == statistics.uConversions);
+	CHECK(1 == statistics.uRejected);
+	CHECK(ADC_QUEUE_LENGTH == statistics.nMaxDepth);
+}
+
+static void TestLatency(void)
+{
+	Reset();
+	snQueuedStep = snSimStep;
+	for (uint32_t i = 0; i < ADC_QUEUE_LENGTH; i++)
+		CHECK(NRF_SUCCESS == StartAdc(i, ResultHandler, NULL));
+	for (uint32_t i = 0; i < SIM_HFCLK_STARTUP_STEPS + 2 * ADC_QUEUE_LENGTH; i++) {
+		SimAdcRun(1);
+		app_sched_execute();                             //As the main loop does between the steps.
+	}
+	CHECK(ADC_QUEUE_LENGTH == snResults);
+	CHECK(SIM_HFCLK_STARTUP_STEPS == sResults[0].uLatency);
+	for (uint32_t i = 1; i < snResults; i++)
+		CHECK(sResults[i - 1].uLatency + 1 == sResults[i].uLatency);     //Back to back, no HFCLK restart.
+	printf("adc: %u requests served %u to %u steps after queuing, HFCLK start %u steps\n", ADC_QUEUE_LENGTH,
+	       sResults[0].uLatency, sResults[snResults - 1].uLatency, SIM_HFCLK_STARTUP_STEPS);
+}
+
+static void TestTriggeredBurst(void)
+{
+	AdcRequest request;
+	Reset();
+	request.uAdcNumber = 2;
+	request.nTriggerCount = 5;
+	request.handler = ResultHandler;
+	request.armHandler = ArmHandler;
+	request.pContext = (void *)(uintptr_t)5;
+	CHECK(NRF_SUCCESS == QueueAdcRequest(&request));
+	CHECK(NRF_SUCCESS == StartAdc(3, ResultHandler, (void *)(uintptr_t)3));
+	CHECK(0 == snArmed);
+
+	SimAdcRun(SIM_HFCLK_STARTUP_STEPS + 10);
+	app_sched_execute();
+	CHECK(1 == snArmed);                                 //Armed once for all its conversions.
+	CHECK(6 == snResults);
+	for (uint32_t i = 0; i < 5; i++)
+		CHECK(SIM_ADC_CODE(2) == sResults[i].uAdcValue && 5 == sResults[i].uContext);
+	CHECK(SIM_ADC_CODE(3) == sResults[5].uAdcValue && 3 == sResults[5].uContext);
+	CHECK(!IsAdcBusy());
+	CHECK(0 == SimHfclkRequests);
+}
+
+static void TestSchedulerFull(void)
+{
+	AdcStatistics before, after;
+	Reset();
+	GetAdcStatistics(&before);
+	SimSchedCapacity = 1;
+	for (uint32_t i = 0; i < 3; i++)
+		CHECK(NRF_SUCCESS == StartAdc(i, ResultHandler, NULL));
+	SimAdcRun(SIM_HFCLK_STARTUP_STEPS + 4);
+	app_sched_execute();
+	GetAdcStatistics(&after);
+	CHECK(1 == snResults);
+	CHECK(2 == after.uRejected - before.uRejected);     //The results which did not fit are counted.
+	CHECK(!IsAdcBusy());                                 //And the queue goes on.
+}
+
+int main(void)
+{
+	TestQueueOrder();
+	TestLatency();
+	TestTriggeredBurst();
+	TestSchedulerFull();
+	return TestResult("test_adc");
+}
@@ -0,0 +1,425 @@
+/* Host test of the transmit queue of the AL, Source/protocol/application.c, over a simulated TCL.
+ *
+ * application.c is included so the test can look at the queue. The simulated TCL takes one packet at a time,
+ * the chain of buffers of the packet pool, and keeps a flat copy of it. The test finishes the packet with
+ * al_send_success() or al_send_failed() as the ACK or the time-out would.
+ * al_tx_resume() is called where protocol.c calls it, on the TCL tick.
+ */
+#include "../Source/protocol/application.c"
+#include "test.h"
+
+#define SIM_TCL_PACKETS             16
+
+typedef enum {
+	SIM_TCL_ACCEPT,                                 //Sent, finished by the test
+	SIM_TCL_REFUSE                                  //Fails the packet before returning, as a full notification queue
+} SimTclMode;
+
+static SimTclMode sSimTclMode = SIM_TCL_ACCEPT;
+static bool       sbSimTclBusy = false;
+static bool       sbSimTclChainBad = false;          //A chain which is not one sub-packet in each buffer, behind the headroom
+static uint32_t   snSimTclSent = 0;                  //Calls of the send handler
+static uint8_t    sSimTclPackets[SIM_TCL_PACKETS][AL_MTU];
+static uint16_t   snSimTclLengths[SIM_TCL_PACKETS];
+
+static uint32_t   snCompleted = 0, snFailed = 0;
+
+static SensorData sSimSensor;
+static uint32_t   snFanSet = 0;                      //Calls of OpenFan() and CloseFan()
+static int        snSetTimeResult = 0;               //Returned by SetCalenderTime(), -1 as the RTC failing
+static uint32_t   snSetTime = 0;
+
+void GetSensorData(SensorData *SRet)       { *SRet = sSimSensor; }
+uint8_t GetFanDutyCycle(void)             { return 0; }
+void OpenFan(uint8_t duty_cycle)          { snFanSet++; }
+void CloseFan(void)                       { snFanSet++; }
+uint32_t GetCalendarUptime(void)          { return 0; }
+uint32_t CalenderTimeToSeconds(const CalenderTime *ct) { return 0; }
+int SetCalenderTime(CalenderTime *ct)     { snSetTime++; return snSetTimeResult; }
+uint16_t GetSensorLogCount(void)          { return 0; }
+uint32_t GetSensorLogFirstSequence(void)  { return 0; }
+uint32_t ReadSensorLog(uint16_t nIndex, SensorLogRecord *pRecord) { return NRF_ERROR_INVALID_PARAM; }
+
+static uint32_t SimTclSend(packet_buf_t *p_packet, uint16_t length)
+{
+	if (sbSimTclBusy)
+		return TCL_WAIT;
+	uint32_t n = snSimTclSent++ % SIM_TCL_PACKETS;
+	uint16_t nCopied = 0;
+	for (uint32_t id = 0; id < TCL_CALC_SUB_PACKET_NUMBER(length); id++, p_packet = p_packet->p_next) {
+		uint16_t nSub = (length - nCopied < BLE_UART_PAYLOAD_MTU) ? length - nCopied : BLE_UART_PAYLOAD_MTU;
+		if (NULL == p_packet || TCL_HEADER_LENGTH != p_packet->offset || nSub != p_packet->length) {
+			sbSimTclChainBad = true;
+			break;
+		}
+		memcpy(&sSimTclPackets[n][nCopied], packet_buf_data(p_packet), nSub);
+		nCopied += nSub;
+	}
+	if (NULL != p_packet)
+		sbSimTclChainBad = true;                       //Longer than the packet
+	snSimTclLengths[n] = length;
+	if (SIM_TCL_REFUSE == sSimTclMode) {
+		al_send_failed();
+		return TCL_ERROR;
+	}
+	sbSimTclBusy = true;
+	return TCL_SUCCESS;
+}
+
+//The packet on the way is done, as the ACK or the last time-out of the TCL.
+static void SimTclFinish(bool bSuccess)
+{
+	sbSimTclBusy = false;
+	if (bSuccess)
+		al_send_success();
+	else
+		al_send_failed();
+}
+
+static const uint8_t *SimTclLast(uint16_t *pnLength)
+{
+	uint32_t n = (snSimTclSent - 1) % SIM_TCL_PACKETS;
+	*pnLength = snSimTclLengths[n];
+	return sSimTclPackets[n];
+}
+
+static uint8_t PoolFree(void)
+{
+	packet_pool_statistics_t statistics;
+	get_packet_pool_statistics(&statistics);
+	return statistics.free;
+}
+
+static void Completed(void *p_context, al_send_status_t status)
+{
+	if (AL_SEND_STATUS_SUCCESS == status)
+		snCompleted++;
+	else
+		snFailed++;
+}
+
+//A request of the phone with one key-value, as the TCL passes it up.
+static uint32_t Request(uint8_t nCommand, uint8_t nCorrelation, uint8_t nKey, const uint8_t *pValue, uint8_t nLength)
+{
+	uint8_t packet[AL_HEADER_LENGTH + AL_KEY_HEADER_LENGTH + 255];
+	uint16_t nPayload = AL_KEY_HEADER_LENGTH + nLength;
+	packet[0] = nCommand;
+	packet[1] = nCorrelation;
+	memcpy(&packet[2], &nPayload, sizeof(nPayload));
+	packet[4] = nKey;
+	packet[5] = nLength;
+	if (0 != nLength)
+		memcpy(&packet[6], pValue, nLength);
+	return al_recv_packet(packet, AL_HEADER_LENGTH + nPayload);
+}
+
+static void Reset(void)
+{
+	al_init_t init = {0};
+	al_reset();
+	sbSimTclBusy = false;
+	SimTclFinish(false);                                   //As tcl_reset(), fails the packet on the way.
+	sSimTclMode = SIM_TCL_ACCEPT;
+	init.tcl_send_handler = SimTclSend;
+	init.settting_handler = al_process_setting_packet;
+	init.control_handler = al_process_control_packet;
+	init.real_time_monitor_handler = al_process_rt_monitor_packet;
+	init.status_handler = al_process_status_packet;
+	init.ol_data_handler = al_process_ol_data_packet;
+	al_init(&init);
+	snSimTclSent = snCompleted = snFailed = snFanSet = snSetTime = 0;
+	snSetTimeResult = 0;
+}
+
+static uint32_t QueueValue(uint8_t *pValue, uint8_t nLength, uint8_t nKvs, al_priority_t priority)
+{
+	al_data_t kv[4];
+	for (uint8_t i = 0; i < nKvs; i++) {
+		kv[i].key_id = i;
+		kv[i].key_length = nLength;
+		kv[i].p_value = pValue;
+	}
+	return al_queue_packet(AL_COMMAND_OL_DATA, kv, nKvs, priority, Completed, NULL);
+}
+
+//The packets are built in the packet pool, one sub-packet in each buffer, which go back when the packet is done.
+static void TestPoolPackets(void)
+{
+	static uint8_t value[AL_TX_PAYLOAD_MTU];
+	uint16_t nLength, nPayload;
+	for (uint32_t i = 0; i < sizeof(value); i++)
+		value[i] = (uint8_t)i;
+	Reset();
+	CHECK(AL_ERROR_DATA_SIZE == QueueValue(value, AL_TX_PAYLOAD_MTU - AL_KEY_HEADER_LENGTH + 1, 1, AL_PRIORITY_LOW));
+	CHECK(PACKET_POOL_SIZE == PoolFree());
+	CHECK(AL_SUCCESS == QueueValue(value, 8, 1, AL_PRIORITY_LOW));              //On the way, 14 bytes in 2 buffers
+	CHECK(PACKET_POOL_SIZE - 2 == PoolFree());
+	CHECK(AL_WAIT == QueueValue(value, AL_TX_PAYLOAD_MTU - AL_KEY_HEADER_LENGTH, 1, AL_PRIORITY_HIGH));   //The pool is short.
+	CHECK(PACKET_POOL_SIZE - 2 == PoolFree());                                 //All the buffers or none
+	SimTclFinish(true);
+	CHECK(PACKET_POOL_SIZE == PoolFree());
+
+	CHECK(AL_SUCCESS == QueueValue(value, AL_TX_PAYLOAD_MTU - AL_KEY_HEADER_LENGTH, 1, AL_PRIORITY_HIGH));
+	CHECK(PACKET_POOL_RESERVE == PoolFree());
+	CHECK(AL_WAIT == QueueValue(value, 1, 1, AL_PRIORITY_HIGH));                //The reserve is for the RX buffer queue and the ACKs.
+	const uint8_t *pPacket = SimTclLast(&nLength);
+	memcpy(&nPayload, &pPacket[2], sizeof(nPayload));
+	CHECK(2 == snSimTclSent && AL_HEADER_LENGTH + AL_TX_PAYLOAD_MTU == nLength && !sbSimTclChainBad);
+	CHECK(AL_COMMAND_OL_DATA == pPacket[0] && AL_TX_PAYLOAD_MTU == nPayload);
+	CHECK(0 == pPacket[4] && AL_TX_PAYLOAD_MTU - AL_KEY_HEADER_LENGTH == pPacket[5]);
+	CHECK(0 == memcmp(&pPacket[6], value, AL_TX_PAYLOAD_MTU - AL_KEY_HEADER_LENGTH));
+	SimTclFinish(true);
+	CHECK(2 == snCompleted && 0 == snFailed && PACKET_POOL_SIZE == PoolFree());
+
+	CHECK(AL_SUCCESS == QueueValue(value, 8, 1, AL_PRIORITY_LOW));
+	CHECK(AL_SUCCESS == QueueValue(value, 100, 1, AL_PRIORITY_LOW));
+	Reset();                                                                    //The link is gone.
+	CHECK(PACKET_POOL_SIZE == PoolFree());
+}
+
+static void TestDeferredRetry(void)
+{
+	uint8_t value[8] = {0};
+	Reset();
+	sSimTclMode = SIM_TCL_REFUSE;
+	CHECK(AL_SUCCESS == QueueValue(value, 8, 1, AL_PRIORITY_LOW));
+	CHECK(AL_SUCCESS == QueueValue(value, 8, 1, AL_PRIORITY_LOW));
+	CHECK(1 == snSimTclSent);                                                   //Not again in the same call
+	al_tx_resume();                                                             //The TCL ticks.
+	CHECK(2 == snSimTclSent);
+	for (uint32_t i = 1; i < AL_RESEND_MAX_COUNT; i++)
+		al_tx_resume();
+	CHECK(AL_RESEND_MAX_COUNT + 2 == snSimTclSent && 1 == snFailed);           //Failed, the next one tried once
+	CHECK(m_al_tx_deferred);
+
+	sSimTclMode = SIM_TCL_ACCEPT;
+	al_tx_resume();
+	CHECK(AL_RESEND_MAX_COUNT + 3 == snSimTclSent);
+	al_tx_resume();                                                             //Nothing refused, nothing sent again
+	CHECK(AL_RESEND_MAX_COUNT + 3 == snSimTclSent);
+	SimTclFinish(true);
+	CHECK(1 == snCompleted && 1 == snFailed);
+
+	sSimTclMode = SIM_TCL_REFUSE;
+	CHECK(AL_SUCCESS == QueueValue(value, 8, 1, AL_PRIORITY_LOW));
+	Reset();                                                                    //Dropped with the link, not sent again
+	CHECK(AL_SUCCESS == QueueValue(value, 8, 1, AL_PRIORITY_LOW));
+	CHECK(1 == snSimTclSent);
+}
+
+//A reply which finds its class full is not lost in silence, the request returns AL_WAIT.
+static void TestReplyWait(void)
+{
+	uint8_t value[8] = {0};
+	Reset();
+	CHECK(AL_SUCCESS == Request(AL_COMMAND_STATUS, 1, AL_KEY_STATUS_PURIFY, NULL, 0));
+	CHECK(1 == snSimTclSent);
+	for (uint32_t i = 1; i < AL_TX_QUEUE_LENGTH; i++)
+		CHECK(AL_SUCCESS == QueueValue(value, 1, 1, AL_PRIORITY_HIGH));
+	CHECK(AL_WAIT == Request(AL_COMMAND_CONTROL, 2, AL_KEY_CONTROL_PURIFY_OPEN, NULL, 0));
+	CHECK(AL_WAIT == Request(AL_COMMAND_STATUS, 3, AL_KEY_STATUS_BATT_CAP, NULL, 0));
+	for (uint32_t i = 0; i < AL_TX_QUEUE_LENGTH; i++)
+		CHECK(AL_SUCCESS == QueueValue(value, 1, 1, AL_PRIORITY_LOW));
+	CHECK(AL_WAIT == Request(AL_COMMAND_RT_DATA, 4, AL_KEY_RT_DATA_ALL, NULL, 0));
+	CHECK(AL_WAIT == Request(AL_COMMAND_RT_DATA, 5, AL_KEY_RT_DATA_PM25, NULL, 0));
+	CHECK(AL_WAIT == Request(AL_COMMAND_OL_DATA, 6, AL_KEY_OL_DATA_COUNT, NULL, 0));
+
+	CHECK(0 == snFanSet && 1 == snSimTclSent);                                  //Nothing executed, nothing queued
+
+	SimTclFinish(true);                                                         //One high slot free
+	CHECK(AL_SUCCESS == Request(AL_COMMAND_CONTROL, 2, AL_KEY_CONTROL_PURIFY_OPEN, NULL, 0));
+	CHECK(1 == snFanSet && AL_TX_QUEUE_LENGTH == al_tx_depth(AL_PRIORITY_HIGH));
+	CHECK(AL_KEY_CONTROL_PURIFY_OPEN == purify_status);
+
+	//Passed again, the packet goes on from the key-value which waited, the ones before are not executed twice.
+	uint8_t packet[AL_HEADER_LENGTH + 2 * AL_KEY_HEADER_LENGTH];
+	uint16_t nPayload = 2 * AL_KEY_HEADER_LENGTH;
+	packet[0] = AL_COMMAND_CONTROL;
+	packet[1] = 8;
+	memcpy(&packet[2], &nPayload, sizeof(nPayload));
+	packet[4] = AL_KEY_CONTROL_PURIFY_CLOSE;
+	packet[5] = 0;
+	packet[6] = AL_KEY_CONTROL_PURIFY_OPEN;
+	packet[7] = 0;
+	SimTclFinish(true);
+	CHECK(AL_WAIT == al_recv_packet(packet, sizeof(packet)));                   //The close takes the free slot
+	CHECK(2 == snFanSet && AL_KEY_CONTROL_PURIFY_CLOSE == purify_status);
+	CHECK(AL_WAIT == al_recv_packet(packet, sizeof(packet)));
+	CHECK(2 == snFanSet);
+	SimTclFinish(true);
+	CHECK(AL_SUCCESS == al_recv_packet(packet, sizeof(packet)));
+	CHECK(3 == snFanSet && AL_KEY_CONTROL_PURIFY_OPEN == purify_status);
+	CHECK(AL_TX_QUEUE_LENGTH == al_tx_depth(AL_PRIORITY_HIGH));                 //Each key-value answered once
+	CHECK(0 == m_al_recv_resume && NULL == m_p_al_tx_reply);
+}
+
+//The reply of the last packet sent: a failed execute status of {command, key, reason} for request nCorrelation.
+static bool IsRejected(uint8_t nCorrelation, uint8_t nCommand, uint8_t nKey, uint32_t nReason)
+{
+	uint16_t nLength;
+	const uint8_t *pPacket = SimTclLast(&nLength);
+	return AL_HEADER_LENGTH + AL_KEY_HEADER_LENGTH + 3 == nLength && AL_COMMAND_EXE_STAT == pPacket[0]
+	       && nCorrelation == pPacket[1] && AL_KEY_EXE_STAT_FAILED == pPacket[4] && 3 == pPacket[5]
+	       && nCommand == pPacket[6] && nKey == pPacket[7] && nReason == pPacket[8];
+}
+
+static void TestRejected(void)
+{
+	uint8_t packet[AL_HEADER_LENGTH + 2 * AL_KEY_HEADER_LENGTH + PAY_LOAD_MAX_LENGTH + 1] = {0};
+	uint16_t nPayload;
+	Reset();
+	packet[0] = AL_COMMAND_CONTROL;
+	packet[1] = 11;
+	CHECK(AL_ERROR_DATA_SIZE == al_recv_packet(packet, 2));                      //No payload length
+	CHECK(1 == snSimTclSent && IsRejected(11, AL_COMMAND_CONTROL, AL_EXE_STAT_KEY_NONE, AL_ERROR_DATA_SIZE));
+	SimTclFinish(true);
+
+	nPayload = 10;
+	memcpy(&packet[2], &nPayload, sizeof(nPayload));
+	CHECK(AL_ERROR_DATA_SIZE == al_recv_packet(packet, AL_HEADER_LENGTH + 4));   //Longer than the packet
+	CHECK(IsRejected(11, AL_COMMAND_CONTROL, AL_EXE_STAT_KEY_NONE, AL_ERROR_DATA_SIZE));
+	SimTclFinish(true);
+
+	CHECK(AL_ERROR_COMMAND == Request(AL_COMMAND_LOG + 1, 12, 0, NULL, 0));
+	CHECK(IsRejected(12, AL_COMMAND_LOG + 1, AL_EXE_STAT_KEY_NONE, AL_ERROR_COMMAND));
+	SimTclFinish(true);
+	CHECK(AL_ERROR_NO_HANDLER == Request(AL_COMMAND_DFU, 13, AL_KEY_DFU_REQUEST, NULL, 0));
+	CHECK(IsRejected(13, AL_COMMAND_DFU, AL_EXE_STAT_KEY_NONE, AL_ERROR_NO_HANDLER));
+	SimTclFinish(true);
+	CHECK(AL_ERROR_KEY == Request(AL_COMMAND_CONTROL, 14, 99, NULL, 0));
+	CHECK(IsRejected(14, AL_COMMAND_CONTROL, 99, AL_ERROR_KEY));
+	SimTclFinish(true);
+	CHECK(AL_ERROR == Request(AL_COMMAND_OL_DATA, 15, AL_KEY_OL_DATA_RECORD, packet, 2));   //No such record
+	CHECK(IsRejected(15, AL_COMMAND_OL_DATA, AL_KEY_OL_DATA_RECORD, AL_ERROR));
+	SimTclFinish(true);
+	CHECK(6 == snSimTclSent);                                                   //One reply each, nothing more
+
+	//A value too long for the receive buffer is skipped, the next key-value is still executed.
+	nPayload = 2 * AL_KEY_HEADER_LENGTH + PAY_LOAD_MAX_LENGTH + 1;
+	packet[0] = AL_COMMAND_STATUS;
+	packet[1] = 16;
+	memcpy(&packet[2], &nPayload, sizeof(nPayload));
+	packet[4] = AL_KEY_STATUS_PURIFY;
+	packet[5] = PAY_LOAD_MAX_LENGTH + 1;
+	packet[6 + PAY_LOAD_MAX_LENGTH + 1] = AL_KEY_STATUS_BATT_CAP;
+	packet[7 + PAY_LOAD_MAX_LENGTH + 1] = 0;
+	CHECK(AL_ERROR_DATA_SIZE == al_recv_packet(packet, AL_HEADER_LENGTH + nPayload));
+	CHECK(IsRejected(16, AL_COMMAND_STATUS, AL_KEY_STATUS_PURIFY, AL_ERROR_DATA_SIZE));
+	SimTclFinish(true);
+	uint16_t nLength;
+	const uint8_t *pPacket = SimTclLast(&nLength);
+	CHECK(8 == snSimTclSent && AL_COMMAND_STATUS == pPacket[0] && 16 == pPacket[1] && AL_KEY_STATUS_BATT_CAP == pPacket[4]);
+	SimTclFinish(true);
+
+	//A reply which finds the low class full waits, it is not rejected, and follows once the packet is passed again.
+	uint8_t value[8] = {0};
+	for (uint32_t i = 0; i < AL_TX_QUEUE_LENGTH; i++)
+		CHECK(AL_SUCCESS == QueueValue(value, 1, 1, AL_PRIORITY_LOW));
+	CHECK(AL_WAIT == Request(AL_COMMAND_RT_DATA, 17, AL_KEY_RT_DATA_ALL, NULL, 0));
+	CHECK(0 == m_al_correlation_id && 0 == al_tx_depth(AL_PRIORITY_HIGH));
+	SimTclFinish(true);                                                         //The first low one
+	CHECK(0 == al_tx_depth(AL_PRIORITY_HIGH));                                  //Not rejected
+	CHECK(AL_SUCCESS == Request(AL_COMMAND_RT_DATA, 17, AL_KEY_RT_DATA_ALL, NULL, 0));
+	CHECK(AL_TX_QUEUE_LENGTH == al_tx_depth(AL_PRIORITY_LOW) && 0 == m_al_correlation_id);
+}
+
+//The reply of the last packet sent: a successful execute status of {command, key} for request nCorrelation.
+static bool IsExecuted(uint8_t nCorrelation, uint8_t nCommand, uint8_t nKey)
+{
+	uint16_t nLength;
+	const uint8_t *pPacket = SimTclLast(&nLength);
+	return AL_HEADER_LENGTH + AL_KEY_HEADER_LENGTH + 2 == nLength && AL_COMMAND_EXE_STAT == pPacket[0]
+	       && nCorrelation == pPacket[1] && AL_KEY_EXE_STAT_SUCCUSS == pPacket[4] && 2 == pPacket[5]
+	       && nCommand == pPacket[6] && nKey == pPacket[7];
+}
+
+//The packets sent for one request, once the queue is empty again.
+static uint32_t Answers(uint32_t nSent)
+{
+	while (sbSimTclBusy)
+		SimTclFinish(true);
+	return snSimTclSent - nSent;
+}
+
+//Every key-value is answered once, the ones which return no data with a successful execute status.
+static void TestEveryKeyAnswered(void)
+{
+	static const struct {
+		uint8_t nCommand;
+		uint8_t nKey;
+	} sExecuted[] = {
+		{AL_COMMAND_SETTING, AL_KEY_SETTING_PERIOD},
+		{AL_COMMAND_SETTING, AL_KEY_SETTING_TIME},
+		{AL_COMMAND_CONTROL, AL_KEY_CONTROL_PURIFY_CLOSE},
+		{AL_COMMAND_CONTROL, AL_KEY_CONTROL_PURIFY_OPEN},
+		{AL_COMMAND_CONTROL, AL_KEY_CONTROL_REVOLVING},
+		{AL_COMMAND_CONTROL, AL_KEY_CONTROL_POWEROFF},
+		{AL_COMMAND_RT_DATA, AL_KEY_RT_DATA_UNSUBSCRIBE},
+	};
+	uint8_t time[sizeof(CalenderTime)] = {15, 6, 17, 12, 0, 0};
+	uint32_t nSent;
+	Reset();
+	for (uint8_t i = 0; i < sizeof(sExecuted) / sizeof(sExecuted[0]); i++) {
+		nSent = snSimTclSent;
+		CHECK(AL_SUCCESS == Request(sExecuted[i].nCommand, (uint8_t)(30 + i), sExecuted[i].nKey, time, sizeof(time)));
+		CHECK(IsExecuted(30 + i, sExecuted[i].nCommand, sExecuted[i].nKey));
+		CHECK(1 == Answers(nSent));
+	}
+	CHECK(1 == snSetTime && 2 == snFanSet);
+
+	nSent = snSimTclSent;                                                       //The reply, then the first push
+	CHECK(AL_SUCCESS == Request(AL_COMMAND_RT_DATA, 40, AL_KEY_RT_DATA_SUBSCRIBE, NULL, 0));
+	CHECK(IsExecuted(40, AL_COMMAND_RT_DATA, AL_KEY_RT_DATA_SUBSCRIBE));
+	CHECK(2 == Answers(nSent) && m_rt_subscribed);
+	nSent = snSimTclSent;
+	CHECK(AL_SUCCESS == Request(AL_COMMAND_RT_DATA, 41, AL_KEY_RT_DATA_UNSUBSCRIBE, NULL, 0));
+	CHECK(IsExecuted(41, AL_COMMAND_RT_DATA, AL_KEY_RT_DATA_UNSUBSCRIBE));
+	CHECK(1 == Answers(nSent) && !m_rt_subscribed);
+
+	//A time too short is not set, nor one the RTC refuses, each answered with the reason.
+	nSent = snSimTclSent;
+	CHECK(AL_ERROR_DATA_SIZE == Request(AL_COMMAND_SETTING, 42, AL_KEY_SETTING_TIME, time, sizeof(time) - 1));
+	CHECK(IsRejected(42, AL_COMMAND_SETTING, AL_KEY_SETTING_TIME, AL_ERROR_DATA_SIZE));
+	CHECK(1 == Answers(nSent) && 1 == snSetTime);
+	snSetTimeResult = -1;
+	nSent = snSimTclSent;
+	CHECK(AL_ERROR == Request(AL_COMMAND_SETTING, 43, AL_KEY_SETTING_TIME, time, sizeof(time)));
+	CHECK(IsRejected(43, AL_COMMAND_SETTING, AL_KEY_SETTING_TIME, AL_ERROR));
+	CHECK(1 == Answers(nSent) && 2 == snSetTime);
+	nSent = snSimTclSent;
+	CHECK(AL_ERROR_KEY == Request(AL_COMMAND_SETTING, 44, 99, NULL, 0));
+	CHECK(IsRejected(44, AL_COMMAND_SETTING, 99, AL_ERROR_KEY));
+	CHECK(1 == Answers(nSent));
+	CHECK(PACKET_POOL_SIZE == PoolFree() && !sbSimTclChainBad);
+}
+
+//The replies of AL_REQUESTS_OUTSTANDING_MAX key-values all queue, whatever the class, beside a push.
+static void TestOutstanding(void)
+{
+	uint8_t value[8] = {0};
+	Reset();
+	CHECK(AL_SUCCESS == QueueValue(value, 1, 1, AL_PRIORITY_LOW));              //The push, on the way
+	for (uint8_t i = 0; i < AL_REQUESTS_OUTSTANDING_MAX; i++)
+		CHECK(AL_SUCCESS == Request(AL_COMMAND_RT_DATA, (uint8_t)(20 + i), AL_KEY_RT_DATA_ALL, NULL, 0));
+	Reset();
+	CHECK(AL_SUCCESS == QueueValue(value, 1, 1, AL_PRIORITY_LOW));
+	for (uint8_t i = 0; i < AL_REQUESTS_OUTSTANDING_MAX; i++)
+		CHECK(AL_ERROR_KEY == Request(AL_COMMAND_STATUS, (uint8_t)(20 + i), 99, NULL, 0));
+	for (uint8_t i = 0; i <= AL_REQUESTS_OUTSTANDING_MAX; i++)
+		SimTclFinish(true);
+	CHECK(AL_REQUESTS_OUTSTANDING_MAX + 1 == snSimTclSent);
+	CHECK(IsRejected(20 + AL_REQUESTS_OUTSTANDING_MAX - 1, AL_COMMAND_STATUS, 99, AL_ERROR_KEY));
+	CHECK(PACKET_POOL_SIZE == PoolFree() && !sbSimTclChainBad);
+}
+
+int main(void)
+{
+	packet_pool_init();
+	TestPoolPackets();
+	TestDeferredRetry();
+	TestReplyWait();
+	TestRejected();
+	TestEveryKeyAnswered();
+	TestOutstanding();
+	return TestResult("test_al_queue");
+}
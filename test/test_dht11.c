@@ -0,0 +1,168 @@
+/* Host test of the DHT11 capture, Source/sensor/dht11.c.
+ *
+ * Dht11DecodeFrame() is fed edge times in the shape TIMER1 captures them: 1us ticks of a 16 bit timer,
+ * the response falling edge first and the rising edge which ends the frame last. The same edges are then
+ * played through the GPIOTE IN channel and the PPI, once in time and once with a late interrupt.
+ */
+#include <string.h>
+#include <dht11.h>
+#include <app_timer.h>
+#include <ble_config.h>
+#include "soc_sim.h"
+#include "test.h"
+
+NRF_TIMER_Type  SimTimer1;
+NRF_GPIOTE_Type SimGpiote;
+
+void GPIOTE_IRQHandler(void);
+
+//55%RH 24C
+static const uint16_t snGoodEdges[84] = {
+	1203, 1283, 1366, 1417, 1445, 1495, 1524, 1577, 1649, 1697, 1766, 1819,
+	1848, 1898, 1970, 2023, 2092, 2139, 2210, 2259, 2285, 2332, 2361, 2414,
+	2439, 2490, 2518, 2568, 2597, 2649, 2675, 2726, 2751, 2804, 2833, 2880,
+	2905, 2952, 2978, 3026, 3055, 3102, 3173, 3222, 3293, 3344, 3370, 3421,
+	3447, 3499, 3526, 3576, 3601, 3653, 3678, 3728, 3755, 3805, 3834, 3887,
+	3912, 3964, 3991, 4040, 4066, 4117, 4144, 4191, 4216, 4267, 4335, 4385,
+	4410, 4463, 4490, 4540, 4608, 4655, 4723, 4771, 4840, 4887, 4958, 5008,
+};
+
+//38%RH 29C, the 16 bit timer wraps within the frame
+static const uint16_t snWrapEdges[84] = {
+	63987, 64069, 64149, 64199, 64224, 64275, 64301, 64354, 64424, 64473, 64498, 64547,
+	64574, 64621, 64692, 64745, 64813, 64861, 64887, 64939, 64964, 65011, 65036, 65086,
+	65114, 65162, 65191, 65239, 65267, 65318, 65344, 65396, 65422, 65472, 65500, 11,
+	39, 89, 115, 162, 189, 242, 314, 363, 431, 479, 548, 598,
+	627, 679, 751, 798, 823, 871, 897, 947, 974, 1021, 1050, 1099,
+	1126, 1176, 1201, 1248, 1273, 1321, 1350, 1402, 1428, 1475, 1547, 1596,
+	1623, 1674, 1702, 1750, 1779, 1829, 1858, 1906, 1977, 2025, 2094, 2143,
+};
+
+//55%RH 24C with bit 6 of the humidity flipped, the checksum no longer matches
+static const uint16_t snBadChecksumEdges[84] = {
+	1187, 1265, 1348, 1399, 1425, 1477, 1503, 1551, 1623, 1671, 1742, 1792,
+	1821, 1868, 1939, 1986, 2011, 2058, 2126, 2177, 2204, 2252, 2280, 2329,
+	2357, 2410, 2439, 2489, 2516, 2567, 2593, 2645, 2670, 2718, 2744, 2794,
+	2823, 2875, 2904, 2955, 2980, 3029, 3098, 3146, 3214, 3261, 3288, 3338,
+	3366, 3414, 3439, 3486, 3512, 3561, 3588, 3639, 3668, 3716, 3741, 3790,
+	3816, 3866, 3893, 3945, 3974, 4025, 4051, 4102, 4127, 4174, 4245, 4294,
+	4321, 4368, 4393, 4444, 4512, 4562, 4630, 4682, 4752, 4801, 4870, 4917,
+};
+
+//55%RH 24C without the falling edge which ends bit 18
+static const uint16_t snMissingEdgeEdges[83] = {
+	1211, 1288, 1368, 1419, 1446, 1498, 1523, 1575, 1644, 1697, 1767, 1816,
+	1841, 1893, 1964, 2011, 2082, 2135, 2203, 2256, 2284, 2335, 2360, 2411,
+	2439, 2489, 2518, 2565, 2594, 2641, 2666, 2713, 2738, 2787, 2815, 2867,
+	2894, 2944, 2973, 3023, 3101, 3173, 3220, 3292, 3345, 3374, 3421, 3448,
+	3499, 3524, 3574, 3599, 3647, 3672, 3722, 3751, 3803, 3831, 3880, 3905,
+	3954, 3981, 4029, 4058, 4106, 4135, 4183, 4210, 4262, 4333, 4383, 4409,
+	4458, 4486, 4538, 4608, 4656, 4727, 4780, 4849, 4897, 4968, 5016,
+};
+
+static bool     sbHandlerValid;
+static uint8_t  snHandlerCalls;
+static float    sfTemperature, sfHumidity;
+
+bool IsPm25Busy(void)
+{
+	return false;
+}
+
+uint32_t GetCalendarUptime(void)
+{
+	return 0;
+}
+
+static void ReadHandler(bool bValid, float temperature, float humidity)
+{
+	snHandlerCalls++;
+	sbHandlerValid = bValid;
+	sfTemperature = temperature;
+	sfHumidity = humidity;
+}
+
+static void TestDecode(void)
+{
+	uint8_t uFrame[DHT11_FRAME_LENGTH];
+	CHECK(NRF_SUCCESS == Dht11DecodeFrame(snGoodEdges, DHT11_FRAME_EDGES, uFrame));
+	CHECK(55 == uFrame[0] && 0 == uFrame[1] && 24 == uFrame[2] && 0 == uFrame[3] && 79 == uFrame[4]);
+	CHECK(NRF_SUCCESS == Dht11DecodeFrame(snGoodEdges, DHT11_EDGE_COUNT, uFrame));     //With the closing edge
+
+	CHECK(NRF_SUCCESS == Dht11DecodeFrame(snWrapEdges, DHT11_EDGE_COUNT, uFrame));
+	CHECK(38 == uFrame[0] && 29 == uFrame[2] && 67 == uFrame[4]);
+
+	CHECK(NRF_ERROR_INVALID_STATE == Dht11DecodeFrame(snBadChecksumEdges, DHT11_EDGE_COUNT, uFrame));
+	CHECK(NRF_ERROR_INVALID_DATA == Dht11DecodeFrame(snMissingEdgeEdges, DHT11_FRAME_EDGES, uFrame));
+	CHECK(NRF_ERROR_INVALID_LENGTH == Dht11DecodeFrame(snGoodEdges, DHT11_FRAME_EDGES - 1, uFrame));
+	CHECK(NRF_ERROR_INVALID_LENGTH == Dht11DecodeFrame(snGoodEdges, 0, uFrame));
+}
+
+/**@brief An edge of the DHT11 line, seen by the GPIOTE IN channel and captured through the PPI. */
+static void PlayEdge(uint16_t nTime, uint32_t uLevel)
+{
+	SimGpioIn = (SimGpioIn & ~(1UL << DHT11_PIN)) | (uLevel << DHT11_PIN);
+	if (0 == SimGpiote.CONFIG[DHT11_GPIOTE_CHANNEL])
+		return;
+	if (SimPpiConnected(&NRF_GPIOTE->EVENTS_IN[DHT11_GPIOTE_CHANNEL], &DHT11_TIMER->TASKS_CAPTURE[DHT11_TIMER_CC]))
+		SimTimer1.CC[DHT11_TIMER_CC] = nTime;
+	SimGpiote.EVENTS_IN[DHT11_GPIOTE_CHANNEL] = 1;
+}
+
+/**@brief Read the DHT11 with the edges played, the interrupt running after every edge but uLateEdge. */
+static void PlayRead(const uint16_t *pEdges, uint8_t nEdges, int nLateEdge)
+{
+	snHandlerCalls = 0;
+	CHECK(NRF_SUCCESS == StartDht11(ReadHandler));
+	CHECK(IsDht11Busy());
+	SimTimerAdvance(APP_TIMER_TICKS(DHT11_START_TIME, APP_TIMER_PRESCALER));
+	CHECK(0 != SimGpiote.CONFIG[DHT11_GPIOTE_CHANNEL]);
+
+	PlayEdge(pEdges[0] - 30, 1);                 //The release of the line, before the response.
+	GPIOTE_IRQHandler();
+	for (int i = 0; i < nEdges; i++) {
+		PlayEdge(pEdges[i], (i & 1) ? 1 : 0);
+		if (i != nLateEdge)
+			GPIOTE_IRQHandler();
+	}
+	SimTimerAdvance(APP_TIMER_TICKS(DHT11_FRAME_TIME, APP_TIMER_PRESCALER));
+	CHECK(1 == snHandlerCalls);
+	CHECK(!IsDht11Busy());
+	CHECK(0 == SimGpiote.CONFIG[DHT11_GPIOTE_CHANNEL]);      //The channel is given back.
+}
+
+static void TestCapture(void)
+{
+	Dht11Statistics before, after;
+	Dht11Cache cache;
+
+	GetDht11Statistics(&before);
+
+	PlayRead(snGoodEdges, DHT11_EDGE_COUNT, -1);
+	CHECK(sbHandlerValid && 24.0f == sfTemperature && 55.0f == sfHumidity);
+	GetDht11Cache(&cache);
+	CHECK(cache.bValid && 24.0f == cache.temperature && 55.0f == cache.humidity);
+
+	PlayRead(snWrapEdges, DHT11_EDGE_COUNT, 40);  //The copy of edge 40 comes after edge 41.
+	CHECK(!sbHandlerValid);
+	PlayRead(snWrapEdges, DHT11_EDGE_COUNT, -1);
+	CHECK(sbHandlerValid && 29.0f == sfTemperature && 38.0f == sfHumidity);
+
+	PlayRead(snBadChecksumEdges, DHT11_EDGE_COUNT, -1);
+	CHECK(!sbHandlerValid && 29.0f == sfTemperature);   //The last good reading is passed on.
+
+	GetDht11Statistics(&after);
+	CHECK(4 == after.uReads - before.uReads);
+	CHECK(1 == after.uChecksumErrors - before.uChecksumErrors);
+	CHECK(1 == after.uFrameErrors - before.uFrameErrors);
+	CHECK(1 == after.uLateEdges - before.uLateEdges);
+}
+
+int main(void)
+{
+	TestDecode();
+	InitDht11();
+	SimTimerAdvance(APP_TIMER_TICKS(DHT11_START_TIME + DHT11_FRAME_TIME, APP_TIMER_PRESCALER));  //The read of InitDht11() gets no answer.
+	TestCapture();
+	return TestResult("test_dht11");
+}
@@ -0,0 +1,186 @@
+/* Host test of the streaming filters, Source/sensor/filter.c, against a window recomputed on every sample.
+ *
+ * The benchmark puts FilterInsert() + FilterOutput() next to the float ring and average the drivers had before.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <filter.h>
+#include "test.h"
+
+#define FILTER_TEST_SAMPLES          2000
+#define FILTER_BENCH_SAMPLES         2000000
+#define FILTER_MAX_LENGTH            16
+
+static int32_t snSamples[FILTER_TEST_SAMPLES];
+static volatile int32_t snBenchSink;
+
+static int32_t RoundDivide(int32_t nValue, int32_t nDivisor)
+{
+	return (nValue >= 0) ? (nValue + nDivisor / 2) / nDivisor : (nValue - nDivisor / 2) / nDivisor;
+}
+
+static int CompareSample(const void *pLeft, const void *pRight)
+{
+	int32_t nLeft = *(const int32_t *)pLeft, nRight = *(const int32_t *)pRight;
+	return (nLeft > nRight) - (nLeft < nRight);
+}
+
+//The output of the window snSamples[nFirst .. nLast] the slow way.
+static int32_t ReferenceOutput(FILTER_TYPE type, int nFirst, int nLast)
+{
+	int32_t nWindow[FILTER_MAX_LENGTH];
+	int nCount = nLast - nFirst + 1;
+	int32_t nSum = 0;
+	for (int i = 0; i < nCount; i++) {
+		nWindow[i] = snSamples[nFirst + i];
+		nSum += nWindow[i];
+	}
+	if (FILTER_MEAN == type)
+		return RoundDivide(nSum, nCount);
+	qsort(nWindow, nCount, sizeof(nWindow[0]), CompareSample);
+	if (nCount & 1)
+		return nWindow[nCount >> 1];
+	return RoundDivide(nWindow[(nCount >> 1) - 1] + nWindow[nCount >> 1], 2);
+}
+
+static void MakeSamples(uint32_t uSeed)
+{
+	srand(uSeed);
+	for (int i = 0; i < FILTER_TEST_SAMPLES; i++) {
+		snSamples[i] = 500 + rand() % 200 - 100;
+		if (0 == rand() % 10)
+			snSamples[i] = (rand() & 1) ? 30000 : -30000;       //Spikes, and some repeated values for the median
+		if (0 == rand() % 7 && i > 0)
+			snSamples[i] = snSamples[i - 1];
+	}
+}
+
+static void TestWindow(FILTER_TYPE type, uint8_t nLength)
+{
+	int32_t nBuffer[2 * FILTER_MAX_LENGTH];
+	Filter filter;
+	int nFails = 0;
+	InitFilter(&filter, type, nBuffer, nLength);
+	CHECK(IsFilterEmpty(&filter));
+	CHECK(0 == FilterOutput(&filter));
+	for (int i = 0; i < FILTER_TEST_SAMPLES; i++) {
+		int32_t nOutput = FilterInsert(&filter, snSamples[i]);
+		int nFirst = (i + 1 >= nLength) ? i + 1 - nLength : 0;
+		if (nOutput != ReferenceOutput(type, nFirst, i) || nOutput != FilterOutput(&filter))
+			nFails++;
+	}
+	CHECK(0 == nFails);
+	CHECK(!IsFilterEmpty(&filter));
+}
+
+static void TestFill(FILTER_TYPE type, uint8_t nLength)
+{
+	int32_t nBuffer[2 * FILTER_MAX_LENGTH];
+	Filter filter;
+	InitFilter(&filter, type, nBuffer, nLength);
+	FilterFill(&filter, 1234);
+	CHECK(1234 == FilterOutput(&filter));
+	if (FILTER_EMA == type)
+		return;
+	for (int i = 0; i < nLength / 2; i++)
+		FilterInsert(&filter, -50);
+	if (FILTER_MEDIAN == type)
+		CHECK(((nLength & 1) ? 1234 : RoundDivide(1234 - 50, 2)) == FilterOutput(&filter));   //Half the window is new
+	else
+		CHECK(RoundDivide(1234 * (nLength - nLength / 2) - 50 * (nLength / 2), nLength) == FilterOutput(&filter));
+}
+
+static void TestEma(void)
+{
+	int32_t nBuffer[1];
+	Filter filter;
+	InitFilter(&filter, FILTER_EMA, nBuffer, 8);
+	CHECK(100 == FilterInsert(&filter, 100));                  //The first sample starts the average.
+	for (int i = 0; i < 200; i++)
+		FilterInsert(&filter, 900);
+	CHECK(900 == FilterOutput(&filter));                        //Converges, the Q8 state does not stick below.
+	int32_t nLast = FilterOutput(&filter);
+	FilterInsert(&filter, 100);
+	CHECK(RoundDivide(900 * 7 + 100, 8) == FilterOutput(&filter) && FilterOutput(&filter) < nLast);
+	for (int i = 0; i < 200; i++)
+		FilterInsert(&filter, -400);
+	CHECK(-400 == FilterOutput(&filter));
+}
+
+static void TestMedianSpike(void)
+{
+	int32_t nBuffer[2 * 5];
+	Filter filter;
+	InitFilter(&filter, FILTER_MEDIAN, nBuffer, 5);
+	FilterFill(&filter, 250);
+	CHECK(250 == FilterInsert(&filter, 9999));                 //One outlier never shows.
+	CHECK(250 == FilterInsert(&filter, 250));
+	CHECK(250 == FilterInsert(&filter, -9999));
+}
+
+//What the drivers did before filter.c: a float ring and the average of all of it for every output.
+static float sfRing[FILTER_MAX_LENGTH];
+static int snRingIndex = 0;
+
+static float RingInsertAverage(float fSample, int nLength)
+{
+	sfRing[snRingIndex++] = fSample;
+	if (nLength == snRingIndex)
+		snRingIndex = 0;
+	float fRet = 0.0f;
+	for (int i = 0; i < nLength; ++i)
+		fRet += sfRing[i];
+	return fRet / nLength;
+}
+
+static double Seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void Benchmark(uint8_t nLength)
+{
+	static const char *pNames[] = {"mean", "median", "ema"};
+	int32_t nBuffer[2 * FILTER_MAX_LENGTH];
+	Filter filter;
+	double fTimes[3];
+	int32_t nSink = 0;
+	for (int type = FILTER_MEAN; type <= FILTER_EMA; type++) {
+		InitFilter(&filter, (FILTER_TYPE)type, nBuffer, nLength);
+		double fStart = Seconds();
+		for (int i = 0; i < FILTER_BENCH_SAMPLES; i++)
+			nSink += FilterInsert(&filter, snSamples[i % FILTER_TEST_SAMPLES]);
+		fTimes[type] = Seconds() - fStart;
+	}
+	float fSink = 0.0f;
+	double fStart = Seconds();
+	for (int i = 0; i < FILTER_BENCH_SAMPLES; i++)
+		fSink += RingInsertAverage((float)snSamples[i % FILTER_TEST_SAMPLES], nLength);
+	double fRing = Seconds() - fStart;
+	snBenchSink = nSink + (int32_t)fSink;
+
+	printf("filter: N=%u, ns per sample on the host:", nLength);
+	for (int type = FILTER_MEAN; type <= FILTER_EMA; type++)
+		printf(" %s %.1f", pNames[type], fTimes[type] * 1e9 / FILTER_BENCH_SAMPLES);
+	printf(", float ring %.1f\n", fRing * 1e9 / FILTER_BENCH_SAMPLES);
+}
+
+int main(void)
+{
+	static const uint8_t snLengths[] = {1, 2, 5, 8, 10, FILTER_MAX_LENGTH};
+	MakeSamples(1);
+	for (uint32_t i = 0; i < sizeof(snLengths); i++) {
+		TestWindow(FILTER_MEAN, snLengths[i]);
+		TestWindow(FILTER_MEDIAN, snLengths[i]);
+		TestFill(FILTER_MEAN, snLengths[i]);
+		TestFill(FILTER_MEDIAN, snLengths[i]);
+		TestFill(FILTER_EMA, snLengths[i]);
+	}
+	TestEma();
+	TestMedianSpike();
+	Benchmark(10);
+	return TestResult("test_filter");
+}
@@ -0,0 +1,189 @@
+/* Host test of the CRC-16, Source/protocol/integrity.c, against the shifts of the SDK's crc16_compute().
+ *
+ * Built twice, test_integrity with the default of integrity.h and test_integrity_table with the nibble table.
+ * The benchmark puts the variant built next to crc16_compute() and the additive sum the TCL had before, in
+ * TSC cycles per byte on x86 hosts and ns per byte elsewhere. The host vectorizes the sum, which the
+ * Cortex-M0 cannot, and a host is not an M0 either, so the figures only hint at the order on the target.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include <crc16.h>
+#include <integrity.h>
+#include "test.h"
+
+#define INTEGRITY_TEST_LENGTH        504             //TCL_PAYLOAD_MTU, the largest packet the CRC covers
+#define INTEGRITY_TEST_PACKETS       200
+#define INTEGRITY_BENCH_ROUNDS       20000
+
+static uint8_t snData[INTEGRITY_TEST_LENGTH + 1];   //One more for the byte the old sum read past odd lengths
+static volatile uint32_t suBenchSink;
+
+#if INTEGRITY_CRC16_NIBBLE_TABLE
+#define INTEGRITY_TEST_VARIANT       "nibble table"
+#else
+#define INTEGRITY_TEST_VARIANT       "default"
+#endif
+
+//crc16_compute() of the SDK.
+static uint16_t SdkCrc16(const uint8_t *pData, uint32_t nLength, uint16_t uCrc)
+{
+	return crc16_compute(pData, nLength, &uCrc);
+}
+
+//checksum() of the TCL before the CRC: the complement of the sum of the 16-bit words.
+static uint16_t OldChecksum(const uint8_t *pData, uint16_t nLength)
+{
+	uint16_t uRet = 0, uWord;
+	nLength = (uint16_t)((nLength + 1) / 2);
+	for (uint16_t i = 0; i < nLength; i++) {
+		memcpy(&uWord, &pData[2 * i], sizeof(uWord));
+		uRet += uWord;
+	}
+	return (uint16_t)~uRet;
+}
+
+static void MakeData(void)
+{
+	for (uint32_t i = 0; i < INTEGRITY_TEST_LENGTH; i++)
+		snData[i] = (uint8_t)rand();
+	snData[INTEGRITY_TEST_LENGTH] = 0;
+}
+
+static void TestCheckValue(void)
+{
+	static const uint8_t snCheck[] = "123456789";
+	CHECK(0x29B1 == integrity_crc16_compute(snCheck, 9));       //CRC-16/CCITT-FALSE
+	CHECK(0x29B1 == SdkCrc16(snCheck, 9, INTEGRITY_CRC16_INIT));
+	CHECK(INTEGRITY_CRC16_INIT == integrity_crc16_compute(snCheck, 0));
+}
+
+static void TestSdk(void)
+{
+	uint32_t nFails = 0;
+	for (uint32_t p = 0; p < INTEGRITY_TEST_PACKETS; p++) {
+		MakeData();
+		uint16_t nLength = (uint16_t)(rand() % (INTEGRITY_TEST_LENGTH + 1));
+		if (integrity_crc16_compute(snData, nLength) != SdkCrc16(snData, nLength, INTEGRITY_CRC16_INIT))
+			nFails++;
+	}
+	CHECK(0 == nFails);
+}
+
+//In pieces, as the TCL does with the header, the payload and the padding, and in the same pass as a copy.
+static void TestPieces(void)
+{
+	static uint8_t snCopy[INTEGRITY_TEST_LENGTH];
+	uint32_t nFails = 0;
+	MakeData();
+	uint16_t uWhole = integrity_crc16_compute(snData, INTEGRITY_TEST_LENGTH);
+	for (uint16_t nSplit = 0; nSplit <= INTEGRITY_TEST_LENGTH; nSplit++) {
+		uint16_t uCrc = integrity_crc16_update(INTEGRITY_CRC16_INIT, snData, nSplit);
+		if (uWhole != integrity_crc16_update(uCrc, snData + nSplit, INTEGRITY_TEST_LENGTH - nSplit))
+			nFails++;
+		memset(snCopy, 0, sizeof(snCopy));
+		uCrc = integrity_crc16_update(INTEGRITY_CRC16_INIT, snData, nSplit);
+		memcpy(snCopy, snData, nSplit);
+		uCrc = integrity_crc16_copy(uCrc, snCopy + nSplit, snData + nSplit, INTEGRITY_TEST_LENGTH - nSplit);
+		if (uWhole != uCrc || 0 != memcmp(snCopy, snData, INTEGRITY_TEST_LENGTH))
+			nFails++;
+	}
+	CHECK(0 == nFails);
+}
+
+//Two 16-bit words swapped, and bursts of up to 16 bits: the sum misses every swap, the CRC none of them.
+static void TestDetection(void)
+{
+	uint32_t nSwaps = 0, nSumMissed = 0, nCrcMissed = 0, nBursts = 0, nBurstMissed = 0;
+	for (uint32_t p = 0; p < INTEGRITY_TEST_PACKETS; p++) {
+		MakeData();
+		uint16_t uSum = OldChecksum(snData, INTEGRITY_TEST_LENGTH);
+		uint16_t uCrc = integrity_crc16_compute(snData, INTEGRITY_TEST_LENGTH);
+		uint32_t nWord = 2 * (rand() % (INTEGRITY_TEST_LENGTH / 2 - 1));
+		if (0 == memcmp(&snData[nWord], &snData[nWord + 2], 2))
+			continue;
+		uint8_t snSaved[4];
+		memcpy(snSaved, &snData[nWord], 4);
+		memcpy(&snData[nWord], &snSaved[2], 2);
+		memcpy(&snData[nWord + 2], &snSaved[0], 2);
+		nSwaps++;
+		if (uSum == OldChecksum(snData, INTEGRITY_TEST_LENGTH))
+			nSumMissed++;
+		if (uCrc == integrity_crc16_compute(snData, INTEGRITY_TEST_LENGTH))
+			nCrcMissed++;
+		memcpy(&snData[nWord], snSaved, 4);
+
+		uint32_t nBit = rand() % (8 * INTEGRITY_TEST_LENGTH - 16);
+		uint32_t uBurst = 1 | (rand() & 0xFFFF);                       //Starts at nBit, ends within 16 bits
+		for (uint32_t b = 0; b < 16; b++)
+			if (uBurst & (1u << b))
+				snData[(nBit + b) / 8] ^= (uint8_t)(0x80 >> ((nBit + b) % 8));
+		nBursts++;
+		if (uCrc == integrity_crc16_compute(snData, INTEGRITY_TEST_LENGTH))
+			nBurstMissed++;
+	}
+	CHECK(nSwaps > 0 && nSwaps == nSumMissed);
+	CHECK(0 == nCrcMissed);
+	CHECK(0 == nBurstMissed);
+	printf("integrity: %u word swaps, the sum missed %u, the CRC %u; %u bursts, the CRC missed %u\n",
+	       nSwaps, nSumMissed, nCrcMissed, nBursts, nBurstMissed);
+}
+
+static uint64_t Ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+#endif
+}
+
+static void Benchmark(void)
+{
+	uint16_t uTable = INTEGRITY_CRC16_INIT, uShifts = INTEGRITY_CRC16_INIT, uSum = 0;
+	double fBytes = (double)INTEGRITY_BENCH_ROUNDS * INTEGRITY_TEST_LENGTH;
+	MakeData();
+	uint64_t uStart = Ticks();                          //Each round goes on from the last, nothing to hoist.
+	for (uint32_t r = 0; r < INTEGRITY_BENCH_ROUNDS; r++)
+		uTable = integrity_crc16_update(uTable, snData, INTEGRITY_TEST_LENGTH);
+	double fTable = (Ticks() - uStart) / fBytes;
+	uStart = Ticks();
+	for (uint32_t r = 0; r < INTEGRITY_BENCH_ROUNDS; r++)
+		uShifts = SdkCrc16(snData, INTEGRITY_TEST_LENGTH, uShifts);
+	double fShifts = (Ticks() - uStart) / fBytes;
+	uStart = Ticks();
+	for (uint32_t r = 0; r < INTEGRITY_BENCH_ROUNDS; r++) {
+		snData[0] = (uint8_t)uSum;
+		uSum = OldChecksum(snData, INTEGRITY_TEST_LENGTH);
+	}
+	double fSum = (Ticks() - uStart) / fBytes;
+	CHECK(uTable == uShifts);
+	suBenchSink = uTable + uShifts + uSum;
+#if defined(__x86_64__) || defined(__i386__)
+	printf("integrity: TSC cycles per byte on the host: integrity (%s) %.2f, crc16_compute %.2f, old sum %.2f\n",
+	       INTEGRITY_TEST_VARIANT, fTable, fShifts, fSum);
+#else
+	printf("integrity: ns per byte on the host: integrity (%s) %.2f, crc16_compute %.2f, old sum %.2f\n",
+	       INTEGRITY_TEST_VARIANT, fTable, fShifts, fSum);
+#endif
+}
+
+int main(void)
+{
+	srand(1);
+	TestCheckValue();
+	TestSdk();
+	TestPieces();
+	TestDetection();
+	Benchmark();
+#if INTEGRITY_CRC16_NIBBLE_TABLE
+	return TestResult("test_integrity_table");
+#else
+	return TestResult("test_integrity");
+#endif
+}
@@ -0,0 +1,201 @@
+/* Host test of the RX buffer queue, Source/Buffer/rx_buffer_queue.c, with the BLE event on its own thread.
+ *
+ * The producer thread plays the BLE event: it adds numbered packets of every length and tries again when the
+ * queue or the pool is full, as the TCL would send again. The main thread plays the main loop and runs the
+ * scheduler. On the nRF51 the BLE event only preempts the main loop, two threads on the host race harder.
+ * The threads yield in the middle of the drain too, so that a single CPU host interleaves them.
+ * TestWait has the TCL keep some packets with TCL_WAIT, as when the AL has no room for the replies.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <app_scheduler.h>
+#include <rx_buffer_queue.h>
+#include <transport.h>
+#include "soc_sim.h"
+#include "test.h"
+
+#define RX_TEST_PACKETS             200000
+#define RX_TEST_LENGTH_MIN          4               //The number of the packet
+#define RX_TEST_RETRIES_MAX         10000           //Per packet, the queue never drains if a wake-up is lost
+
+static volatile bool sbProducerDone = false;
+static uint32_t snRetries = 0, snStalls = 0;
+static uint32_t snExpected = 0, snConsumed = 0, snBad = 0;
+static bool     sbTclWaitMode = false;                                  //The order is recorded, not checked
+static bool     sbTclWait = false;                                      //The even packets wait
+static uint32_t snWaited = 0;
+static uint32_t suOrder[RX_BUFFER_QUEUE_LENGTH];
+
+static uint16_t PacketLength(uint32_t uNumber)
+{
+	return (uint16_t)(RX_TEST_LENGTH_MIN + uNumber % (PACKET_BUF_SIZE - RX_TEST_LENGTH_MIN + 1));
+}
+
+static void MakePacket(uint32_t uNumber, uint8_t *pData)
+{
+	memcpy(pData, &uNumber, sizeof(uNumber));
+	for (uint16_t i = RX_TEST_LENGTH_MIN; i < PacketLength(uNumber); i++)
+		pData[i] = (uint8_t)(uNumber + i);
+}
+
+//The TCL: every packet once, in order and intact.
+uint32_t tcl_recv_packet(uint8_t *p_data, uint16_t length)
+{
+	uint8_t expected[PACKET_BUF_SIZE];
+	if (sbTclWaitMode) {
+		uint32_t uNumber;
+		memcpy(&uNumber, p_data, sizeof(uNumber));
+		if (sbTclWait && 0 == uNumber % 2) {
+			snWaited++;
+			return TCL_WAIT;
+		}
+		suOrder[snConsumed++ % RX_BUFFER_QUEUE_LENGTH] = uNumber;
+		return NRF_SUCCESS;
+	}
+	MakePacket(snExpected, expected);
+	if (length != PacketLength(snExpected) || 0 != memcmp(p_data, expected, length))
+		snBad++;
+	snExpected++;
+	snConsumed++;
+	if (0 == snConsumed % 3)
+		sched_yield();                                                  //New packets come while the queue is drained.
+	return NRF_SUCCESS;
+}
+
+static bool IsPoolFull(void)
+{
+	packet_pool_statistics_t statistics;
+	get_packet_pool_statistics(&statistics);
+	return PACKET_POOL_SIZE == statistics.free;
+}
+
+static void Reset(void)
+{
+	packet_pool_init();
+	init_rx_buffer_queue_evt();
+	app_sched_execute();
+	snExpected = snConsumed = snBad = snWaited = 0;
+	sbTclWaitMode = sbTclWait = false;
+}
+
+static void TestLimits(void)
+{
+	uint8_t data[PACKET_BUF_SIZE + 1];
+	rx_buffer_queue_statistics_t statistics;
+	Reset();
+	for (uint32_t i = 0; i < RX_BUFFER_QUEUE_LENGTH; i++) {
+		MakePacket(i, data);
+		CHECK(NRF_SUCCESS == add_rx_buffer_to_queue(data, PacketLength(i)));
+	}
+	CHECK(NRF_ERROR_NO_MEM == add_rx_buffer_to_queue(data, 1));         //Nothing read yet is overwritten.
+	CHECK(NRF_ERROR_INVALID_LENGTH == add_rx_buffer_to_queue(data, sizeof(data)));
+	CHECK(1 == SimSchedDepth());                                         //One event for all of them
+	app_sched_execute();
+	CHECK(RX_BUFFER_QUEUE_LENGTH == snConsumed && 0 == snBad);
+	CHECK(IsPoolFull());
+	get_rx_buffer_queue_statistics(&statistics);
+	CHECK(RX_BUFFER_QUEUE_LENGTH == statistics.received);
+	CHECK(2 == statistics.dropped);
+	CHECK(0 == statistics.depth && RX_BUFFER_QUEUE_LENGTH == statistics.high_water);
+
+	for (uint32_t i = 0; i < 3; i++)
+		CHECK(NRF_SUCCESS == add_rx_buffer_to_queue(data, 1));
+	flush_rx_buffer_queue();                                            //A disconnection
+	CHECK(IsPoolFull());
+	app_sched_execute();
+	CHECK(RX_BUFFER_QUEUE_LENGTH == snConsumed);                        //The event left finds nothing.
+}
+
+//The packets the TCL keeps stay in the queue, the ones behind still go, and the kept ones follow in order.
+static void TestWait(void)
+{
+	static const uint32_t suExpected[] = {1, 3, 5, 0, 2, 4, 6};
+	uint8_t data[PACKET_BUF_SIZE];
+	rx_buffer_queue_statistics_t statistics;
+	Reset();
+	sbTclWaitMode = sbTclWait = true;
+	for (uint32_t i = 0; i < 6; i++) {
+		MakePacket(i, data);
+		CHECK(NRF_SUCCESS == add_rx_buffer_to_queue(data, PacketLength(i)));
+	}
+	app_sched_execute();
+	CHECK(3 == snConsumed && 3 == snWaited);
+	CHECK(0 == SimSchedDepth());                                         //No busy loop over the kept ones
+	MakePacket(6, data);
+	CHECK(NRF_SUCCESS == add_rx_buffer_to_queue(data, PacketLength(6)));
+	app_sched_execute();
+	CHECK(3 == snConsumed && 7 == snWaited && 0 == SimSchedDepth());
+
+	sbTclWait = false;
+	rx_buffer_queue_resume();                                            //As the TCL tick, once the AL took the packet
+	CHECK(1 == SimSchedDepth());
+	app_sched_execute();
+	CHECK(7 == snConsumed && 0 == memcmp(suOrder, suExpected, sizeof(suExpected)));
+	get_rx_buffer_queue_statistics(&statistics);
+	CHECK(0 == statistics.depth && IsPoolFull());
+	rx_buffer_queue_resume();
+	CHECK(0 == SimSchedDepth());
+
+	sbTclWait = true;
+	for (uint32_t i = 0; i < 2; i++) {
+		MakePacket(i, data);
+		CHECK(NRF_SUCCESS == add_rx_buffer_to_queue(data, PacketLength(i)));
+	}
+	app_sched_execute();
+	flush_rx_buffer_queue();                                            //A disconnection, behind a taken one
+	CHECK(IsPoolFull());
+}
+
+static void *Producer(void *pArg)
+{
+	uint8_t data[PACKET_BUF_SIZE];
+	for (uint32_t n = 0; n < RX_TEST_PACKETS && 0 == snStalls; n++) {
+		MakePacket(n, data);
+		for (uint32_t uTry = 0; NRF_SUCCESS != add_rx_buffer_to_queue(data, PacketLength(n)); uTry++) {
+			snRetries++;
+			if (RX_TEST_RETRIES_MAX == uTry) {
+				snStalls++;
+				break;
+			}
+			sched_yield();
+		}
+	}
+	sbProducerDone = true;
+	return NULL;
+}
+
+static void TestStress(void)
+{
+	pthread_t producer;
+	rx_buffer_queue_statistics_t statistics;
+	Reset();
+	CHECK(0 == pthread_create(&producer, NULL, Producer, NULL));
+	while (!sbProducerDone) {
+		app_sched_execute();                                             //As the main loop
+		sched_yield();                                                   //Let the producer in on a single CPU too.
+	}
+	pthread_join(producer, NULL);
+	app_sched_execute();                                                 //The last packets need no new event.
+
+	get_rx_buffer_queue_statistics(&statistics);
+	CHECK(0 == snStalls);
+	CHECK(RX_TEST_PACKETS == snConsumed);
+	CHECK(0 == snBad);
+	CHECK(RX_TEST_PACKETS == statistics.received);
+	CHECK(snRetries == statistics.dropped);
+	flush_rx_buffer_queue();                                             //Only left by a stall
+	CHECK(0 == statistics.depth && statistics.high_water <= RX_BUFFER_QUEUE_LENGTH);
+	CHECK(IsPoolFull());
+	CHECK(0 == SimSchedDepth());
+	printf("rx queue: %u packets across threads, %u full, high water %u of %u\n",
+	       snConsumed, snRetries, statistics.high_water, RX_BUFFER_QUEUE_LENGTH);
+}
+
+int main(void)
+{
+	TestLimits();
+	TestWait();
+	TestStress();
+	return TestResult("test_rx_buffer_queue");
+}
@@ -0,0 +1,163 @@
+/* Host test of the flash sensor log, Source/sensor/sensor_log.c, on the pstorage simulation.
+ *
+ * sensor_log.c is included so a reset can clear its RAM state and InitSensorLog() find the log again.
+ */
+#include "../Source/sensor/sensor_log.c"
+#include "pstorage_sim.h"
+#include "test.h"
+
+static uint32_t suSimSeconds = 0;
+
+uint32_t GetCalendarSeconds(void)
+{
+	return suSimSeconds;
+}
+
+uint32_t GetCalendarUptime(void)
+{
+	return suSimSeconds;
+}
+
+static void Reboot(void)
+{
+	SimFlashReset();                            //The stores not run yet are lost.
+	snLogHeadPage = snLogHeadSlot = snLogTailPage = 0;
+	snLogCount = 0;
+	suLogNextSequence = 0;
+	suLogLastTime = 0;
+	sbLogStarted = false;
+	snLogPendingWrite = snLogPendingRead = 0;
+	memset((void *)&sLogStatistics, 0, sizeof(sLogStatistics));
+	CHECK(NRF_SUCCESS == InitSensorLog());
+}
+
+static uint32_t Append(uint32_t uValue)
+{
+	SensorData data;
+	memset(&data, 0, sizeof(data));
+	data.pm2_5 = (float)uValue;                 //Found again as uPm25 / 10
+	data.temperature = -5.0f;
+	data.humidity = 60.0f;
+	suSimSeconds += SENSOR_LOG_INTERVAL;
+	return AppendSensorLog(&data);
+}
+
+//Every record from the oldest one is in sequence and carries the value it was appended with.
+static bool LogIsConsistent(uint32_t uFirstValue)
+{
+	SensorLogRecord record;
+	for (uint16_t i = 0; i < GetSensorLogCount(); i++) {
+		if (NRF_SUCCESS != ReadSensorLog(i, &record))
+			return false;
+		if (record.uSequence != GetSensorLogFirstSequence() + i || record.uPm25 != (uFirstValue + i) * 10
+		    || -5 != record.nTemperature || 60 != record.uHumidity)
+			return false;
+	}
+	return NRF_ERROR_INVALID_PARAM == ReadSensorLog(GetSensorLogCount(), &record);
+}
+
+static void TestPending(void)
+{
+	SensorLogStatistics statistics;
+	SimFlashErase();
+	Reboot();
+	CHECK(0 == GetSensorLogCount());
+	for (uint32_t i = 0; i < SENSOR_LOG_PENDING; i++)
+		CHECK(NRF_SUCCESS == Append(i));
+	CHECK(NRF_ERROR_NO_MEM == Append(99));                 //All the pending slots wait for the flash.
+	CHECK(SENSOR_LOG_PENDING == SimFlashQueued());
+	CHECK(LogIsConsistent(0));                              //Read from RAM before the stores run
+
+	SimFlashRun(2);
+	CHECK(LogIsConsistent(0));                              //Half from the flash, half from RAM
+	SimFlashRun(SENSOR_LOG_PENDING);
+	CHECK(LogIsConsistent(0));
+	GetSensorLogStatistics(&statistics);
+	CHECK(0 == statistics.uCrcErrors);
+	CHECK(1 == statistics.uDropped);
+	CHECK(SENSOR_LOG_PENDING == statistics.uStored);
+}
+
+static void TestWrap(void)
+{
+	SensorLogStatistics statistics;
+	uint32_t uAppended = SENSOR_LOG_CAPACITY + SENSOR_LOG_PAGE_RECORDS / 2;
+	SimFlashErase();
+	Reboot();
+	for (uint32_t i = 0; i < uAppended; i++) {
+		CHECK(NRF_SUCCESS == Append(i));
+		SimFlashRun(2);                                     //The store, and the clear of a new page
+	}
+	//The page being filled and the full ones before it, the oldest page went for it.
+	uint16_t nCount = GetSensorLogCount();
+	CHECK(nCount == (SENSOR_LOG_PAGE_COUNT - 1) * SENSOR_LOG_PAGE_RECORDS + SENSOR_LOG_PAGE_RECORDS / 2);
+	CHECK(uAppended - nCount == GetSensorLogFirstSequence());
+	CHECK(LogIsConsistent(uAppended - nCount));
+	GetSensorLogStatistics(&statistics);
+	CHECK(0 == statistics.uCrcErrors);
+	CHECK(SENSOR_LOG_PAGE_COUNT == statistics.uErased);
+
+	Reboot();                                               //InitSensorLog() finds the same log in the flash.
+	CHECK(nCount == GetSensorLogCount());
+	CHECK(uAppended - nCount == GetSensorLogFirstSequence());
+	CHECK(LogIsConsistent(uAppended - nCount));
+	CHECK(NRF_SUCCESS == Append(uAppended));
+	SimFlashRun(1);
+	CHECK(LogIsConsistent(uAppended - nCount));
+}
+
+static void TestLostStore(void)
+{
+	SensorLogRecord record;
+	SensorLogStatistics statistics;
+	SimFlashErase();
+	Reboot();
+	for (uint32_t i = 0; i < 3; i++)
+		CHECK(NRF_SUCCESS == Append(i));
+	SimFlashRun(1);
+	SimFlashFailNext = true;                                //The second store fails, the others go through.
+	SimFlashRun(2);
+	CHECK(NRF_SUCCESS == ReadSensorLog(0, &record) && 0 == record.uSequence);
+	CHECK(NRF_ERROR_INVALID_DATA == ReadSensorLog(1, &record));
+	CHECK(NRF_SUCCESS == ReadSensorLog(2, &record) && 2 == record.uSequence);
+	GetSensorLogStatistics(&statistics);
+	CHECK(1 == statistics.uCrcErrors);                      //Only the record really missing
+	CHECK(1 == statistics.uFlashErrors);
+
+	CHECK(NRF_SUCCESS == Append(3));
+	Reboot();                                               //Its store never ran.
+	CHECK(3 == GetSensorLogCount());
+	CHECK(NRF_SUCCESS == ReadSensorLog(2, &record) && 2 == record.uSequence);
+}
+
+//pstorage has no module left, as when the modules are not registered again after a reset.
+static void TestNotRegistered(void)
+{
+	SensorLogRecord record;
+	SensorLogStatistics statistics;
+	SimFlashErase();
+	Reboot();
+	CHECK(NRF_SUCCESS == Append(0));
+	SimFlashRun(1);
+	CHECK(NRF_ERROR_NO_MEM == InitSensorLog());                 //Registered a second time
+	snLogCount = 0;
+	CHECK(NRF_ERROR_INVALID_STATE == Append(1));
+	CHECK(NRF_ERROR_INVALID_STATE == LogSensorData(&(SensorData){0}));
+	CHECK(0 == SimFlashQueued());                               //Nothing touched the flash.
+	CHECK(NRF_ERROR_INVALID_PARAM == ReadSensorLog(0, &record));
+	GetSensorLogStatistics(&statistics);
+	CHECK(0 == statistics.uFlashErrors && 1 == statistics.uAppended);
+
+	Reboot();
+	CHECK(1 == GetSensorLogCount());
+	CHECK(NRF_SUCCESS == Append(1));
+}
+
+int main(void)
+{
+	TestPending();
+	TestWrap();
+	TestLostStore();
+	TestNotRegistered();
+	return TestResult("test_sensor_log");
+}
@@ -0,0 +1,266 @@
+/* Host simulation of a BLE link between two TCLs, Source/protocol/transport.c, with frames lost at random.
+ *
+ *   build/test_tcl_link [loss%]...      goodput for each loss rate, 0 5 10 20 30 without arguments
+ *
+ * Every frame takes one connection event, SIM_FRAME_MS, in both directions. The TCL timers of both ends run
+ * every TCL_SEND_TIMER_INTERVAL. The device sends AL packets, the peer plays Android and only acknowledges.
+ * A packet of one sub-packet is not acknowledged, its loss is only counted.
+ * transport.c is included so the test can look at the window of the device.
+ */
+#include <stdlib.h>
+#include "../Source/protocol/transport.c"
+#include "tcl_peer.h"
+#include "test.h"
+
+#define SIM_FRAME_MS                8               //A connection interval of 7.5ms, one frame per event
+#define SIM_FRAME_QUEUE_LENGTH      64
+#define SIM_MESSAGES                50
+#define SIM_STEPS_MAX               100000          //Per message, far beyond TCL_RECV_WAIT_TIME
+
+typedef struct {
+	bool     bToPeer;
+	uint16_t nLength;
+	uint8_t  data[PACKET_BUF_SIZE];
+} SimFrame;
+
+static SimFrame sSimFrames[SIM_FRAME_QUEUE_LENGTH];
+static uint32_t suSimFrameRead = 0, suSimFrameWrite = 0;
+static uint32_t suSimNow = 0, suSimNextTick = TCL_SEND_TIMER_INTERVAL;
+static uint32_t snSimLossPercent = 0;
+static uint32_t suSimFramesSent = 0, suSimFramesLost = 0;
+
+static uint32_t snDeviceSuccess = 0, snDeviceFailed = 0;
+static bool     sbDeviceRecvWait = false;          //The AL of the device has no room for the replies
+static uint32_t snDeviceRecv = 0, snDeviceTaken = 0;
+static uint8_t  snDeviceMessage[TCL_PAYLOAD_MTU];
+static uint8_t  snPeerMessage[TCL_PAYLOAD_MTU];
+static int32_t  snPeerMessageLength = -1;
+
+static uint32_t SimTime(void)
+{
+	return suSimNow;
+}
+
+static uint32_t SimChannel(packet_buf_t* p_buf, bool bToPeer)
+{
+	suSimFramesSent++;
+	if ((uint32_t)(rand() % 100) < snSimLossPercent || SIM_FRAME_QUEUE_LENGTH == suSimFrameWrite - suSimFrameRead) {
+		suSimFramesLost++;
+	} else {
+		SimFrame* pFrame = &sSimFrames[suSimFrameWrite++ % SIM_FRAME_QUEUE_LENGTH];
+		pFrame->bToPeer = bToPeer;
+		pFrame->nLength = p_buf->length;
+		memcpy(pFrame->data, packet_buf_data(p_buf), p_buf->length);
+	}
+	packet_buf_release(p_buf);                      //As the BLE Profile Layer once the SoftDevice took it
+	return NRF_SUCCESS;
+}
+
+static uint32_t DeviceSend(packet_buf_t* p_buf)
+{
+	return SimChannel(p_buf, true);
+}
+
+static uint32_t PeerSend(packet_buf_t* p_buf)
+{
+	return SimChannel(p_buf, false);
+}
+
+static uint32_t DeviceRecv(uint8_t* p_data, uint16_t length)
+{
+	snDeviceRecv++;
+	if (sbDeviceRecvWait)
+		return TCL_WAIT;
+	snDeviceTaken++;
+	memcpy(snDeviceMessage, p_data, length);
+	return TCL_SUCCESS;
+}
+
+static uint32_t PeerRecv(uint8_t* p_data, uint16_t length)
+{
+	memcpy(snPeerMessage, p_data, length);
+	snPeerMessageLength = length;
+	return TCL_SUCCESS;
+}
+
+static void DeviceSuccess(void)
+{
+	snDeviceSuccess++;
+}
+
+static void DeviceFailed(void)
+{
+	snDeviceFailed++;
+}
+
+static void PeerDone(void)
+{
+}
+
+//One frame over the air, or the time to the next TCL tick if nothing is on the way.
+static void SimStep(void)
+{
+	if (suSimFrameRead != suSimFrameWrite) {
+		SimFrame frame = sSimFrames[suSimFrameRead++ % SIM_FRAME_QUEUE_LENGTH];
+		suSimNow += SIM_FRAME_MS;
+		if (frame.bToPeer)
+			peer_tcl_recv_packet(frame.data, frame.nLength);
+		else
+			tcl_recv_packet(frame.data, frame.nLength);
+	} else {
+		suSimNow = suSimNextTick;
+	}
+	while ((int32_t)(suSimNow - suSimNextTick) >= 0) {
+		tcl_timer_time_out();
+		peer_tcl_timer_time_out();
+		suSimNextTick += TCL_SEND_TIMER_INTERVAL;
+	}
+}
+
+static void SimInit(uint32_t nLossPercent)
+{
+	tcl_init_t device = {DeviceSend, DeviceRecv, DeviceFailed, DeviceSuccess, SimTime};
+	tcl_init_t peer = {PeerSend, PeerRecv, PeerDone, PeerDone, SimTime};
+	srand(1);
+	packet_pool_init();
+	tcl_init(&device);
+	peer_tcl_init(&peer);
+	tcl_reset();                                    //The RTT of the last run goes too.
+	peer_tcl_reset();
+	suSimFrameRead = suSimFrameWrite = 0;
+	suSimFramesSent = suSimFramesLost = 0;
+	snDeviceSuccess = snDeviceFailed = 0;
+	snSimLossPercent = nLossPercent;
+}
+
+//Send one AL packet, true once the device has its answer. *pbIntact tells whether the peer got the same bytes.
+//The packet is built in a chain of buffers as the AL does, and released once answered.
+static bool SimSend(const uint8_t* pMessage, uint16_t nLength, bool* pbIntact)
+{
+	uint32_t nDone = snDeviceSuccess + snDeviceFailed;
+	packet_buf_t* pPacket = packet_chain_alloc(TCL_CALC_SUB_PACKET_NUMBER(nLength), TCL_HEADER_LENGTH);
+	packet_buf_t* pFill = pPacket;
+	snPeerMessageLength = -1;
+	if (NULL == pPacket || nLength != packet_chain_put(&pFill, pMessage, nLength)
+	    || TCL_SUCCESS != tcl_send_packet(pPacket, nLength)) {
+		packet_chain_release(pPacket);
+		return false;
+	}
+	for (uint32_t i = 0; i < SIM_STEPS_MAX && nDone == snDeviceSuccess + snDeviceFailed; i++)
+		SimStep();
+	packet_chain_release(pPacket);
+	while (suSimFrameRead != suSimFrameWrite)           //A single sub-packet succeeds once sent, let it arrive.
+		SimStep();
+	*pbIntact = (nLength == snPeerMessageLength && 0 == memcmp(snPeerMessage, pMessage, nLength));
+	return nDone != snDeviceSuccess + snDeviceFailed;
+}
+
+static bool IsPoolFull(void)
+{
+	packet_pool_statistics_t statistics;
+	get_packet_pool_statistics(&statistics);
+	return PACKET_POOL_SIZE == statistics.free;
+}
+
+static void RunLink(uint32_t nLossPercent)
+{
+	static uint8_t snMessage[TCL_PAYLOAD_MTU];
+	uint32_t nAnswered = 0, nWrong = 0, nShortLost = 0, nLeaks = 0, uBytes = 0;
+	tcl_rtt_t rtt;
+	SimInit(nLossPercent);
+	for (uint32_t i = 0; i < sizeof(snMessage); i++)
+		snMessage[i] = (uint8_t)rand();
+
+	uint32_t uStart = suSimNow;
+	for (uint32_t m = 0; m < SIM_MESSAGES; m++) {
+		uint16_t nLength = (4 == m % 5) ? 10 : TCL_PAYLOAD_MTU;   //Mostly offline record blocks, some short replies
+		uint32_t nSuccess = snDeviceSuccess;
+		bool bIntact = false;
+		if (SimSend(snMessage, nLength, &bIntact))
+			nAnswered++;
+		if (snDeviceSuccess != nSuccess) {
+			if (bIntact)
+				uBytes += nLength;
+			else if (nLength <= BLE_UART_PAYLOAD_MTU)
+				nShortLost++;
+			else
+				nWrong++;                               //An acknowledged packet the peer did not see
+		}
+		if (!IsPoolFull())
+			nLeaks++;
+	}
+	uint32_t uElapsed = suSimNow - uStart;
+	tcl_get_rtt(&rtt);
+
+	CHECK(SIM_MESSAGES == nAnswered);                  //Every packet ends in success or failure.
+	CHECK(0 == nWrong);
+	CHECK(0 == nLeaks);
+	if (nLossPercent <= 5)
+		CHECK(SIM_MESSAGES == snDeviceSuccess);
+	if (0 == nLossPercent)
+		CHECK(0 == rtt.timeouts);
+	printf("tcl link: loss %2u%%: %2u/%u packets (%u short lost), goodput %4u B/s, %4u frames (%4u lost), srtt %3u ms, %3u time-outs\n",
+	       nLossPercent, snDeviceSuccess, SIM_MESSAGES, nShortLost, (uint32_t)((uint64_t)uBytes * 1000 / uElapsed),
+	       suSimFramesSent, suSimFramesLost, rtt.srtt, rtt.timeouts);
+}
+
+static void TestResetWindow(void)
+{
+	static uint8_t snMessage[TCL_PAYLOAD_MTU];
+	bool bIntact = false;
+	SimInit(0);
+	CHECK(1 == m_send_window);                         //Stop-and-wait until the peer advertises a window.
+	CHECK(SimSend(snMessage, sizeof(snMessage), &bIntact) && bIntact);
+	CHECK(TCL_WINDOW_SIZE == m_send_window);
+	tcl_reset();                                       //The link is gone, the next peer may be a legacy one.
+	CHECK(1 == m_send_window);
+}
+
+//The peer sends a short packet, the frame is given to the device as the RX buffer queue would.
+static uint32_t PeerSendShort(uint8_t nFirst, SimFrame* pFrame)
+{
+	uint8_t message[10] = {nFirst};
+	packet_buf_t* pPacket = packet_chain_alloc(1, TCL_HEADER_LENGTH);
+	packet_buf_t* pFill = pPacket;
+	packet_chain_put(&pFill, message, sizeof(message));
+	uint32_t err_code = peer_tcl_send_packet(pPacket, sizeof(message));
+	packet_chain_release(pPacket);
+	*pFrame = sSimFrames[suSimFrameRead++ % SIM_FRAME_QUEUE_LENGTH];
+	return err_code;
+}
+
+//A packet the AL can not take is kept by the TCL, the next data sub-packets wait until it is taken.
+static void TestRecvWait(void)
+{
+	SimFrame first, second;
+	SimInit(0);
+	sbDeviceRecvWait = true;
+	snDeviceRecv = snDeviceTaken = 0;
+	CHECK(TCL_SUCCESS == PeerSendShort(1, &first) && TCL_SUCCESS == PeerSendShort(2, &second));
+	CHECK(TCL_SUCCESS == tcl_recv_packet(first.data, first.nLength));
+	CHECK(1 == snDeviceRecv && 0 == snDeviceTaken && tcl_recv_busy());
+	CHECK(TCL_WAIT == tcl_recv_packet(second.data, second.nLength));
+	CHECK(1 == snDeviceRecv);                          //Not reassembled over the one kept
+	CHECK(!tcl_recv_resume() && 2 == snDeviceRecv);
+	sbDeviceRecvWait = false;
+	CHECK(tcl_recv_resume() && 1 == snDeviceTaken && 1 == snDeviceMessage[0]);
+	CHECK(!tcl_recv_busy() && tcl_recv_resume());
+	CHECK(TCL_SUCCESS == tcl_recv_packet(second.data, second.nLength));
+	CHECK(2 == snDeviceTaken && 2 == snDeviceMessage[0]);
+	CHECK(IsPoolFull());
+}
+
+int main(int argc, char** argv)
+{
+	static const uint32_t snLoss[] = {0, 5, 10, 20, 30};
+	TestResetWindow();
+	TestRecvWait();
+	if (argc > 1) {
+		for (int i = 1; i < argc; i++)
+			RunLink((uint32_t)atoi(argv[i]));
+	} else {
+		for (uint32_t i = 0; i < sizeof(snLoss) / sizeof(snLoss[0]); i++)
+			RunLink(snLoss[i]);
+	}
+	return TestResult("test_tcl_link");
+}
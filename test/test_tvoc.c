@@ -0,0 +1,159 @@
+/* Host test of the TVOC conversion, Source/sensor/tvoc.c, against the float formula it replaced.
+ *
+ * tvoc.c is included so the static TvocValue() can be called. The golden values are the old
+ * log(ppm) = 1.528v - 0.125v^2 - 2.631 path with pow(), for every ADC code and the whole temperature range.
+ */
+#include <math.h>
+#include <time.h>
+#include "../Source/sensor/tvoc.c"
+#include "test.h"
+
+#define TVOC_MAX_ERROR_UG           3.0             //tvoc_lut.py --check gives 2.3 at 85 degrees
+#define TVOC_BENCH_ROUNDS           200
+
+static Dht11Cache sSimDht11Cache;
+static AdcHandler sSimAdcHandler = NULL;
+static volatile uint32_t suBenchSink;
+static float sfResult;
+static uint32_t snCalls = 0;
+
+void GetDht11Cache(Dht11Cache *pCache)
+{
+	*pCache = sSimDht11Cache;
+}
+
+uint32_t StartAdc(uint32_t uAdcNumber, AdcHandler handler, void *pContext)
+{
+	if (NULL != sSimAdcHandler)
+		return NRF_ERROR_NO_MEM;
+	sSimAdcHandler = handler;
+	return NRF_SUCCESS;
+}
+
+void OpenAdc(uint32_t uAdcNumber)
+{
+}
+
+uint32_t GetAdcValue(void)
+{
+	return 0;
+}
+
+static void SimAdcResult(uint32_t uAdcValue)
+{
+	AdcHandler handler = sSimAdcHandler;
+	sSimAdcHandler = NULL;
+	handler(uAdcValue, NULL);
+}
+
+static void SetTemperature(bool bValid, float temperature)
+{
+	sSimDht11Cache.bValid = bValid;
+	sSimDht11Cache.temperature = temperature;
+}
+
+static float TvocGolden(uint32_t uAdcValue, float temperature)   //The float code of tvoc.c before the table
+{
+	float fTvocVoltage = (float)uAdcValue / ADC_COUNT_MAX * ADC_COUNT_MAX_VOLTAGE * ADC_PRESCALING / TVOC_VOLTAGE_DIVIDER;
+	float log_Formaldehyde_ppm = 1.528*fTvocVoltage - 0.125*fTvocVoltage*fTvocVoltage - 2.631;
+	float Formaldehyde_ppm = pow(10,log_Formaldehyde_ppm);
+	return (Formaldehyde_ppm *(273 + temperature)*TVOC_Formaldehyde_M)/(22.4*273) * TVOC_UG_PER_MG;
+}
+
+static void TestGolden(void)
+{
+	static const int32_t snTemperatures[] = {TVOC_TEMPERATURE_MIN, -10, 0, 25, 50, TVOC_TEMPERATURE_MAX};
+	double fWorst = 0.0;
+	for (uint32_t t = 0; t < sizeof(snTemperatures) / sizeof(snTemperatures[0]); t++) {
+		SetTemperature(true, (float)snTemperatures[t]);
+		uint32_t uLast = 0;
+		uint32_t uFails = 0;
+		for (uint32_t uCode = 0; uCode < (uint32_t)ADC_COUNT_MAX; uCode++) {
+			uint32_t uValue = TvocValue(uCode);
+			double fError = fabs((double)uValue - TvocGolden(uCode, (float)snTemperatures[t]));
+			if (fError > fWorst)
+				fWorst = fError;
+			if (fError > TVOC_MAX_ERROR_UG || uValue < uLast)          //Close to the formula and never going down
+				uFails++;
+			uLast = uValue;
+		}
+		CHECK(0 == uFails);
+	}
+	printf("tvoc: worst error %.2f ug/m3 over %u codes\n", fWorst, (uint32_t)ADC_COUNT_MAX);
+}
+
+static void TestTemperature(void)
+{
+	SetTemperature(false, 0.0f);
+	uint32_t uDefault = TvocValue(512);
+	SetTemperature(true, TVOC_DEFAULT_TEMPERATURE);
+	CHECK(uDefault == TvocValue(512));                                  //No DHT11 reading yet
+	SetTemperature(true, 200.0f);
+	CHECK(fabs(TvocValue(1023) - TvocGolden(1023, TVOC_TEMPERATURE_MAX)) <= TVOC_MAX_ERROR_UG);   //Clamped, no overflow
+	SetTemperature(true, -100.0f);
+	CHECK(fabs(TvocValue(1023) - TvocGolden(1023, TVOC_TEMPERATURE_MIN)) <= TVOC_MAX_ERROR_UG);
+	CHECK(TvocValue(1024) >= TvocValue(1023));                         //The last entry ends the table, no read past it
+}
+
+static void Handler(float fTvocValue)
+{
+	sfResult = fTvocValue;
+	snCalls++;
+}
+
+static void TestHandler(void)
+{
+	SetTemperature(true, 25.0f);
+	InitTvoc();                                                         //The first sample fills the filter.
+	SimAdcResult(400);
+	CHECK(0 == snCalls);
+	CHECK(NRF_SUCCESS == StartTvoc(Handler));
+	CHECK(NRF_ERROR_BUSY == StartTvoc(Handler));
+	SimAdcResult(400);
+	CHECK(1 == snCalls);
+	CHECK(fabs(sfResult - TvocGolden(400, 25.0f) / TVOC_UG_PER_MG) < TVOC_MAX_ERROR_UG / TVOC_UG_PER_MG);
+
+	CHECK(NRF_SUCCESS == StartTvoc(Handler));
+	StopTvoc();
+	SimAdcResult(400);
+	CHECK(1 == snCalls);                                                //Stopped, the result only joins the filter
+	CHECK(NRF_SUCCESS == StartTvoc(Handler));
+	SimAdcResult(400);
+	CHECK(2 == snCalls);
+}
+
+static double Seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void Benchmark(void)
+{
+	uint32_t uSum = 0;
+	float fSum = 0.0f;
+	SetTemperature(true, 25.0f);
+	double fStart = Seconds();
+	for (uint32_t r = 0; r < TVOC_BENCH_ROUNDS; r++)
+		for (uint32_t uCode = 0; uCode < (uint32_t)ADC_COUNT_MAX; uCode++)
+			uSum += TvocValue(uCode);
+	double fTable = Seconds() - fStart;
+	fStart = Seconds();
+	for (uint32_t r = 0; r < TVOC_BENCH_ROUNDS; r++)
+		for (uint32_t uCode = 0; uCode < (uint32_t)ADC_COUNT_MAX; uCode++)
+			fSum += TvocGolden(uCode, 25.0f);
+	double fFloat = Seconds() - fStart;
+	suBenchSink = uSum + (uint32_t)fSum;
+	double fCount = (double)TVOC_BENCH_ROUNDS * ADC_COUNT_MAX;
+	printf("tvoc: table %.1f ns, pow() %.1f ns per conversion on the host\n", fTable * 1e9 / fCount, fFloat * 1e9 / fCount);
+}
+
+int main(void)
+{
+	TestGolden();
+	TestTemperature();
+	TestHandler();
+	Benchmark();
+	return TestResult("test_tvoc");
+}